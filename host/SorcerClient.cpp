@@ -0,0 +1,318 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "SorcerClient.h"
+
+// Room left for a tag of the form #[id]: ahead of a command
+#define SORCER_TAG_SIZE 6
+
+static speed_t baudConstant (int baud) {
+  switch (baud) {
+    case 9600:
+      return B9600;
+    case 57600:
+      return B57600;
+    case 230400:
+      return B230400;
+    case 460800:
+      return B460800;
+    case 921600:
+      return B921600;
+    default:
+      return B115200;
+  }
+}
+
+static long nowMillis () {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+
+SorcerBatch::SorcerBatch () {
+  this->scheduled = 0;
+  this->deviceMicros = 0;
+}
+
+void SorcerBatch::at (uint32_t deviceMicros) {
+  this->scheduled = 1;
+  this->deviceMicros = deviceMicros;
+}
+
+uint8_t SorcerBatch::command (const std::string &text, DoneCallback onDone) {
+  if (text.size() > SORCER_MAX_COMMAND_SIZE) {
+    return 0;
+  }
+  Entry entry = {text, onDone};
+  entries.push_back(entry);
+  return 1;
+}
+
+void SorcerBatch::clear () {
+  entries.clear();
+  scheduled = 0;
+}
+
+size_t SorcerBatch::size () const {
+  return entries.size();
+}
+
+SorcerClient::SorcerClient () {
+  this->fd = -1;
+  this->inFlightBytes = 0;
+  this->nextId = 0;
+  this->mismatched = 0;
+}
+
+SorcerClient::~SorcerClient () {
+  close();
+}
+
+uint8_t SorcerClient::open (const char *path, int baud) {
+  close();
+  int opened = ::open(path, O_RDWR | O_NOCTTY);
+  if (opened < 0) {
+    return 0;
+  }
+  struct termios settings;
+  if (tcgetattr(opened, &settings) == 0) {
+    cfmakeraw(&settings);
+    cfsetspeed(&settings, baudConstant(baud));
+    tcsetattr(opened, TCSANOW, &settings);
+  }
+  attach(opened);
+  return 1;
+}
+
+void SorcerClient::attach (int fd) {
+  this->fd = fd;
+  outbox.clear();
+  inFlight.clear();
+  inFlightBytes = 0;
+  completions.clear();
+  rxLine.clear();
+}
+
+void SorcerClient::close () {
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+uint8_t SorcerClient::command (const std::string &text, DoneCallback onDone) {
+  if (!enqueue("", text, onDone, 0)) {
+    return 0;
+  }
+  flushOutbox();
+  return 1;
+}
+
+uint8_t SorcerClient::send (const SorcerBatch &batch) {
+  char prefix[16] = "";
+  if (batch.scheduled) {
+    snprintf(prefix, sizeof(prefix), "@%u:", (unsigned int)batch.deviceMicros);
+  }
+  for (size_t i = 0; i < batch.entries.size(); i++) {
+    if (!enqueue(prefix, batch.entries[i].text, batch.entries[i].onDone, i + 1 < batch.entries.size())) {
+      return 0;
+    }
+  }
+  flushOutbox();
+  return 1;
+}
+
+void SorcerClient::stop () {
+  // The device acts on this byte as soon as it is read, without a newline
+  writeAll("!");
+  inFlight.push_back("!");
+}
+
+uint8_t SorcerClient::enqueue (const std::string &prefix, const std::string &text, DoneCallback onDone, uint8_t batched) {
+  size_t size = prefix.size() + text.size() + (onDone ? SORCER_TAG_SIZE : 0);
+  if (size > SORCER_MAX_COMMAND_SIZE || text.find('\n') != std::string::npos) {
+    return 0;
+  }
+  Outgoing outgoing = {prefix, text, onDone, batched};
+  outbox.push_back(outgoing);
+  return 1;
+}
+
+void SorcerClient::flushOutbox () {
+  std::string pending;
+  while (!outbox.empty()) {
+    // Batches go out whole once there is room for all of them
+    size_t groupSize = 0;
+    size_t groupBytes = 0;
+    size_t groupTags = 0;
+    do {
+      groupBytes += lineSize(outbox[groupSize]);
+      groupTags += (outbox[groupSize].onDone ? 1 : 0);
+    } while (outbox[groupSize++].batched && groupSize < outbox.size());
+    if (inFlightBytes + groupBytes <= SORCER_RX_WINDOW && completions.size() + groupTags <= SORCER_COMPLETION_SLOTS) {
+      for (size_t i = 0; i < groupSize; i++) {
+        pending += writeLine();
+      }
+    } else if (inFlight.empty()) {
+      // Batch too big for the window at all, so send what fits and leave
+      // the rest to follow as ACKs come back
+      do {
+        pending += writeLine();
+      } while (!outbox.empty() && inFlightBytes + lineSize(outbox.front()) <= SORCER_RX_WINDOW
+        && completions.size() + (outbox.front().onDone ? 1 : 0) <= SORCER_COMPLETION_SLOTS);
+      break;
+    } else {
+      break;
+    }
+  }
+  if (!pending.empty()) {
+    writeAll(pending);
+  }
+}
+
+size_t SorcerClient::lineSize (const Outgoing &outgoing) {
+  return outgoing.prefix.size() + outgoing.text.size() + (outgoing.onDone ? SORCER_TAG_SIZE : 0) + 1;
+}
+
+std::string SorcerClient::writeLine () {
+  Outgoing outgoing = outbox.front();
+  outbox.pop_front();
+  std::string line = outgoing.prefix;
+  if (outgoing.onDone) {
+    uint16_t id = nextId;
+    nextId = (nextId + 1) % (SORCER_MAX_ID + 1);
+    completions[id] = outgoing.onDone;
+    line += "#" + std::to_string(id) + ":";
+  }
+  line += outgoing.text;
+  inFlight.push_back(line);
+  inFlightBytes += line.size() + 1;
+  return line + "\n";
+}
+
+uint8_t SorcerClient::writeAll (const std::string &bytes) {
+  size_t written = 0;
+  while (written < bytes.size()) {
+    ssize_t result = ::write(fd, bytes.data() + written, bytes.size() - written);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return 0;
+    }
+    written += result;
+  }
+  return 1;
+}
+
+int SorcerClient::poll (int timeoutMillis) {
+  if (fd < 0) {
+    return -1;
+  }
+  int handled = 0;
+  struct pollfd readable = {fd, POLLIN, 0};
+  int ready = ::poll(&readable, 1, timeoutMillis);
+  while (ready > 0) {
+    if (readable.revents & (POLLERR | POLLHUP)) {
+      return -1;
+    }
+    char buffer[512];
+    ssize_t count = ::read(fd, buffer, sizeof(buffer));
+    if (count <= 0) {
+      return (count < 0 && errno == EINTR) ? handled : -1;
+    }
+    for (ssize_t i = 0; i < count; i++) {
+      if (buffer[i] == '\n') {
+        handleLine(rxLine);
+        rxLine.clear();
+        handled++;
+      } else if (buffer[i] != '\r') {
+        rxLine += buffer[i];
+      }
+    }
+    // Take anything else already waiting before handing back
+    ready = ::poll(&readable, 1, 0);
+  }
+  flushOutbox();
+  return handled;
+}
+
+void SorcerClient::handleLine (const std::string &line) {
+  if (line.compare(0, 5, "ACK: ") == 0) {
+    std::string acked = line.substr(5);
+    if (acked == "!") {
+      // Jumps the queue, like the byte itself
+      for (std::deque<std::string>::iterator it = inFlight.begin(); it != inFlight.end(); it++) {
+        if (*it == "!") {
+          inFlight.erase(it);
+          break;
+        }
+      }
+      return;
+    }
+    if (inFlight.empty()) {
+      mismatched++;
+      return;
+    }
+    // The device truncates nothing the client sends, so any difference means
+    // bytes were lost on the way. Either way, that command is done with
+    if (inFlight.front() != acked) {
+      mismatched++;
+    }
+    inFlightBytes -= inFlight.front().size() + 1;
+    inFlight.pop_front();
+  } else if (line.compare(0, 6, "DONE: ") == 0 || line.compare(0, 6, "DROP: ") == 0) {
+    uint16_t id = (uint16_t)atoi(line.c_str() + 6);
+    std::map<uint16_t, DoneCallback>::iterator it = completions.find(id);
+    if (it != completions.end()) {
+      DoneCallback onDone = it->second;
+      completions.erase(it);
+      onDone(id, line[1] == 'R');
+    }
+  } else if (line == "B/ON" || line == "B/OFF") {
+    if (buttonCallback) {
+      buttonCallback(line == "B/ON");
+    }
+  } else if (lineCallback) {
+    lineCallback(line);
+  }
+}
+
+uint8_t SorcerClient::drain (int timeoutMillis, uint8_t completions) {
+  long deadline = nowMillis() + timeoutMillis;
+  while (!outbox.empty() || !inFlight.empty() || (completions && !this->completions.empty())) {
+    long remaining = deadline - nowMillis();
+    if (remaining <= 0 || poll((int)remaining) < 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void SorcerClient::onButton (std::function<void (uint8_t pressed)> callback) {
+  buttonCallback = callback;
+}
+
+void SorcerClient::onLine (std::function<void (const std::string &line)> callback) {
+  lineCallback = callback;
+}
+
+size_t SorcerClient::queued () {
+  return outbox.size();
+}
+
+size_t SorcerClient::unacknowledged () {
+  return inFlight.size();
+}
+
+size_t SorcerClient::pendingCompletions () {
+  return completions.size();
+}
+
+uint32_t SorcerClient::mismatchedAcks () {
+  return mismatched;
+}
@@ -0,0 +1,130 @@
+#ifndef SORCER_CLIENT_H
+#define SORCER_CLIENT_H
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "SorcerCommands.h"
+
+// Longest command the device accepts, excluding the newline. Matches
+// MAX_CMD_SIZE in the sketch, less its terminator
+#define SORCER_MAX_COMMAND_SIZE 39
+// Unacknowledged bytes allowed in flight. The device reads ahead into a
+// 256 byte buffer, so staying under it means nothing is ever lost
+#define SORCER_RX_WINDOW 256
+// Tagged commands the device can track at once, per COMPLETION_SLOTS
+#define SORCER_COMPLETION_SLOTS 16
+// Tags count up to this and wrap, keeping them to 4 digits
+#define SORCER_MAX_ID 9999
+
+class SorcerClient;
+
+// Commands collected to be sent together in a single write, optionally
+// scheduled to run at a device time
+class SorcerBatch: public SorcerCommands<SorcerBatch> {
+  public:
+    SorcerBatch ();
+    // Run every command at device time `deviceMicros` instead of on arrival
+    void at (uint32_t deviceMicros);
+    // Add a raw command. Returns 0 if it's too long
+    uint8_t command (const std::string &text, DoneCallback onDone = nullptr);
+    // Drop all commands
+    void clear ();
+    // Number of commands collected
+    size_t size () const;
+  private:
+    friend class SorcerClient;
+
+    typedef struct {
+      std::string text;
+      DoneCallback onDone;
+    } Entry;
+
+    std::vector<Entry> entries;
+    uint8_t scheduled;
+    uint32_t deviceMicros;
+};
+
+// Talks to the head over a serial port, or a pty for the mock device.
+// Commands are pipelined: each is written as soon as the device has room
+// for it, without waiting for the previous ACK, and responses are matched
+// up as they arrive from `poll`. Nothing blocks apart from `drain`
+class SorcerClient: public SorcerCommands<SorcerClient> {
+  public:
+    SorcerClient ();
+    ~SorcerClient ();
+    // Open a serial device, or the pty printed by the mock device, and set it
+    // to raw mode at `baud`. Returns 0 on failure
+    uint8_t open (const char *path, int baud = 115200);
+    // Use a descriptor that is already open and configured
+    void attach (int fd);
+    void close ();
+
+    // Queue a raw command, sent as soon as the device has room. Returns 0 if
+    // it's too long
+    uint8_t command (const std::string &text, DoneCallback onDone = nullptr);
+    // Queue every command of a batch, sent together in one write
+    uint8_t send (const SorcerBatch &batch);
+    // Send the emergency stop straight away, ahead of anything queued
+    void stop ();
+    // Handle everything the device has sent, waiting up to `timeoutMillis`
+    // for the first byte. Returns the number of lines handled, or -1 if the
+    // connection failed
+    int poll (int timeoutMillis = 0);
+    // Poll until every command queued has been acknowledged, and also
+    // completed if `completions` is set. Returns 0 on timeout
+    uint8_t drain (int timeoutMillis, uint8_t completions = 0);
+
+    // Called on every button press or release
+    void onButton (std::function<void (uint8_t pressed)> callback);
+    // Called with every line not otherwise handled, such as R/DONE or T/F>
+    void onLine (std::function<void (const std::string &line)> callback);
+
+    // Commands not yet written, or written and not yet acknowledged
+    size_t queued ();
+    size_t unacknowledged ();
+    // Tagged commands not yet completed
+    size_t pendingCompletions ();
+    // ACKs that didn't match the command expected next
+    uint32_t mismatchedAcks ();
+  private:
+    typedef struct {
+      // Schedule prefix, if any, which goes ahead of the tag
+      std::string prefix;
+      std::string text;
+      // Tagged when written, if set
+      DoneCallback onDone;
+      // Set on all but the last command of a batch, so they are written together
+      uint8_t batched;
+    } Outgoing;
+
+    int fd;
+    // Commands waiting for room in the window
+    std::deque<Outgoing> outbox;
+    // Written commands, oldest first, as they will be acknowledged
+    std::deque<std::string> inFlight;
+    size_t inFlightBytes;
+    std::map<uint16_t, DoneCallback> completions;
+    uint16_t nextId;
+    std::string rxLine;
+    uint32_t mismatched;
+    std::function<void (uint8_t)> buttonCallback;
+    std::function<void (const std::string &)> lineCallback;
+
+    // Queue a command, checking it will fit once prefixed and tagged
+    uint8_t enqueue (const std::string &prefix, const std::string &text, DoneCallback onDone, uint8_t batched);
+    // Write queued commands while the window has room
+    void flushOutbox ();
+    // Bytes a queued command takes on the wire at most, once tagged
+    static size_t lineSize (const Outgoing &outgoing);
+    // Take the next queued command, tag it and mark it in flight. Returns
+    // the line to write
+    std::string writeLine ();
+    void handleLine (const std::string &line);
+    uint8_t writeAll (const std::string &bytes);
+};
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef SORCER_COMMANDS_H
+#define SORCER_COMMANDS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <functional>
+#include <string>
+
+// Bytecode bytes per script load command, leaving room for a tag
+#define SCRIPT_LOAD_CHUNK 12
+
+// Called once a tagged command has finished on the device, or with `dropped`
+// set if the device had no room to track it
+typedef std::function<void (uint16_t id, uint8_t dropped)> DoneCallback;
+
+typedef enum {
+  SIDE_BOTH,
+  SIDE_LEFT,
+  SIDE_RIGHT
+} Side;
+
+typedef enum {
+  EYE_GREEN,
+  EYE_RED,
+  EYE_BLUE,
+  EYE_YELLOW,
+  EYE_PURPLE,
+  EYE_ORANGE
+} EyeColor;
+
+typedef enum {
+  LOOK_UP,
+  LOOK_DOWN,
+  LOOK_LEFT,
+  LOOK_RIGHT
+} LookDirection;
+
+typedef enum {
+  SCRIPT_TRIGGER_NONE,
+  SCRIPT_TRIGGER_PRESS,
+  SCRIPT_TRIGGER_RELEASE,
+  SCRIPT_TRIGGER_ANIMATION,
+  SCRIPT_TRIGGER_TIMER
+} ScriptTrigger;
+
+// Typed calls for every command in the protocol table. Each one formats the
+// command and hands it to `Sink::command`, so the same calls work on a
+// client, which sends straight away, and on a batch, which collects them.
+// Pass `onDone` to be told when the command has finished on the device
+template<class Sink>
+class SorcerCommands {
+  public:
+    // Actuator
+    // ============================
+    uint8_t actuatorReset (DoneCallback onDone = nullptr) {
+      return command("A/RST", onDone);
+    }
+    uint8_t actuatorSpeed (int speed, DoneCallback onDone = nullptr) {
+      return format(onDone, "A/SPD>%d", speed);
+    }
+    uint8_t actuatorUp (uint8_t blocking = 0, DoneCallback onDone = nullptr) {
+      return command(blocking ? "A/UPP>B" : "A/UPP", onDone);
+    }
+    uint8_t actuatorDown (uint8_t blocking = 0, DoneCallback onDone = nullptr) {
+      return command(blocking ? "A/DWN>B" : "A/DWN", onDone);
+    }
+    uint8_t actuatorMiddle (uint8_t blocking = 0, DoneCallback onDone = nullptr) {
+      return command(blocking ? "A/MID>B" : "A/MID", onDone);
+    }
+    uint8_t actuatorUnload (DoneCallback onDone = nullptr) {
+      return command("A/UNL", onDone);
+    }
+    uint8_t actuatorTiltLeft (int amount = 1000, uint8_t blocking = 0, DoneCallback onDone = nullptr) {
+      return format(onDone, blocking ? "A/TLL>%d,B" : "A/TLL>%d", amount);
+    }
+    uint8_t actuatorTiltRight (int amount = 1000, uint8_t blocking = 0, DoneCallback onDone = nullptr) {
+      return format(onDone, blocking ? "A/TLR>%d,B" : "A/TLR>%d", amount);
+    }
+    uint8_t actuatorBounce (DoneCallback onDone = nullptr) {
+      return command("A/BNC", onDone);
+    }
+    uint8_t actuatorShake (int count = 2, DoneCallback onDone = nullptr) {
+      return format(onDone, "A/SHK>%d", count);
+    }
+    uint8_t actuatorWaypoint (int leftPos, int rightPos, int durationMillis, int blendRadius = 0, DoneCallback onDone = nullptr) {
+      return format(onDone, "A/WPT>%d,%d,%d,%d", leftPos, rightPos, durationMillis, blendRadius);
+    }
+    uint8_t actuatorClearPath (DoneCallback onDone = nullptr) {
+      return command("A/WPC", onDone);
+    }
+    uint8_t actuatorDynamics (int slew, int accel, DoneCallback onDone = nullptr) {
+      return format(onDone, "A/DYN>%d,%d", slew, accel);
+    }
+
+    // Jaw
+    // ============================
+    uint8_t jawSpeed (int speed, DoneCallback onDone = nullptr) {
+      return format(onDone, "J/SPD>%d", speed);
+    }
+    uint8_t jawOpen (uint8_t blocking = 0, DoneCallback onDone = nullptr) {
+      return command(blocking ? "J/OPN>B" : "J/OPN", onDone);
+    }
+    uint8_t jawClose (uint8_t blocking = 0, DoneCallback onDone = nullptr) {
+      return command(blocking ? "J/CLS>B" : "J/CLS", onDone);
+    }
+    // Color as 0xRRGGBB
+    uint8_t jawColor (uint32_t color, DoneCallback onDone = nullptr) {
+      return format(onDone, "J/C>#%06x", (unsigned int)(color & 0xffffff));
+    }
+    uint8_t jawDynamics (int slew, int accel, DoneCallback onDone = nullptr) {
+      return format(onDone, "J/DYN>%d,%d", slew, accel);
+    }
+
+    // Eyes
+    // ============================
+    uint8_t eyeColor (EyeColor color, Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      static const char * const names[] = {"GRN", "RED", "BLU", "YLW", "PRP", "ORG"};
+      return format(onDone, "E/C/%s%s", names[color], sideSuffix(side, '>'));
+    }
+    // Color as 0xRRGGBB
+    uint8_t eyeColor (uint32_t color, Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/C>#%06x%s", (unsigned int)(color & 0xffffff), sideSuffix(side, ','));
+    }
+    uint8_t eyeBrightness (int brightness, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/B>%d", brightness);
+    }
+    uint8_t eyeReset (DoneCallback onDone = nullptr) {
+      return command("E/R", onDone);
+    }
+    uint8_t eyeOpen (Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/D/OPN%s", sideSuffix(side, '>'));
+    }
+    uint8_t eyeClose (Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/D/CLS%s", sideSuffix(side, '>'));
+    }
+    uint8_t eyeDilate (Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/D/DIL%s", sideSuffix(side, '>'));
+    }
+    uint8_t eyeContract (Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/D/CTR%s", sideSuffix(side, '>'));
+    }
+    uint8_t eyeSquint (Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/D/SQT%s", sideSuffix(side, '>'));
+    }
+    uint8_t eyeInfill (uint8_t hasInfill, DoneCallback onDone = nullptr) {
+      return command(hasInfill ? "E/D/INF>Y" : "E/D/INF>N", onDone);
+    }
+    uint8_t eyeDead (DoneCallback onDone = nullptr) {
+      return command("E/D/DIE", onDone);
+    }
+    uint8_t eyeLook (LookDirection direction, Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/D/LOK>%c%s", "UDLR"[direction], sideSuffix(side, ','));
+    }
+    // Angles in degrees
+    uint8_t eyeWedge (int fromAngle, int toAngle, Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/D/WDG>%d,%d%s", fromAngle, toAngle, sideSuffix(side, ','));
+    }
+    uint8_t eyeLine (int angle, Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/D/LIN>%d%s", angle, sideSuffix(side, ','));
+    }
+    // Set `handoff` to carry targets past the eye range over to the actuator
+    uint8_t eyeGaze (int x, int y, uint8_t handoff = 0, DoneCallback onDone = nullptr) {
+      return format(onDone, handoff ? "E/G>%d,%d,T" : "E/G>%d,%d", x, y);
+    }
+    uint8_t eyeRainbow (int stepDelayMillis = 100, Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/D/RNB>%d%s", stepDelayMillis, sideSuffix(side, ','));
+    }
+    uint8_t eyeConfused (DoneCallback onDone = nullptr) {
+      return command("E/D/CNF", onDone);
+    }
+    uint8_t eyeBlink (int stepDelayMillis = 75, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/A/BLK>%d", stepDelayMillis);
+    }
+    uint8_t eyeWink (Side side, int stepDelayMillis = 75, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/A/WNK>%c,%d", (side == SIDE_RIGHT) ? 'R' : 'L', stepDelayMillis);
+    }
+    uint8_t eyeSpiralDot (int stepDelayMillis = 50, uint8_t up = 1, Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/A/SPD>%d,%c%s", stepDelayMillis, up ? 'U' : 'D', sideSuffix(side, ','));
+    }
+    uint8_t eyeSpiralLine (int stepDelayMillis = 50, uint8_t up = 1, Side side = SIDE_BOTH, DoneCallback onDone = nullptr) {
+      return format(onDone, "E/A/SPL>%d,%c%s", stepDelayMillis, up ? 'U' : 'D', sideSuffix(side, ','));
+    }
+
+    // Button
+    // ============================
+    uint8_t buttonEnable (DoneCallback onDone = nullptr) {
+      return command("B/ENA", onDone);
+    }
+    uint8_t buttonDisable (DoneCallback onDone = nullptr) {
+      return command("B/DIS", onDone);
+    }
+
+    // Identity
+    // ============================
+    uint8_t setId (int id, DoneCallback onDone = nullptr) {
+      return format(onDone, "N/ID>%d", id);
+    }
+    // Bit n set for membership of group n
+    uint8_t setGroups (int mask, DoneCallback onDone = nullptr) {
+      return format(onDone, "N/GRP>%d", mask);
+    }
+
+    // Cues
+    // ============================
+    // Add a command to a cue, to run when it is fired
+    uint8_t cueArm (int slot, const char *text, DoneCallback onDone = nullptr) {
+      return format(onDone, "^%d:%s", slot, text);
+    }
+    uint8_t cueFire (int slot, DoneCallback onDone = nullptr) {
+      return format(onDone, "F/FIR>%d", slot);
+    }
+    // Fire a cue the next time the trigger line is pulled low
+    uint8_t cueTrigger (int slot, DoneCallback onDone = nullptr) {
+      return format(onDone, "F/TRG>%d", slot);
+    }
+    // Negative for every cue
+    uint8_t cueClear (int slot = -1, DoneCallback onDone = nullptr) {
+      return (slot < 0) ? command("F/CLR", onDone) : format(onDone, "F/CLR>%d", slot);
+    }
+
+    // Scripts
+    // ============================
+    // Append bytecode to a script, in as many commands as it takes. `onDone`
+    // is for the last of them
+    uint8_t scriptLoad (int slot, const uint8_t *code, size_t length, DoneCallback onDone = nullptr) {
+      uint8_t sent = 1;
+      for (size_t start = 0; start < length; start += SCRIPT_LOAD_CHUNK) {
+        std::string text = "V/LOD>" + std::to_string(slot) + ",";
+        for (size_t i = start; i < length && i < start + SCRIPT_LOAD_CHUNK; i++) {
+          char hex[3];
+          snprintf(hex, sizeof(hex), "%02x", code[i]);
+          text += hex;
+        }
+        sent &= command(text, (start + SCRIPT_LOAD_CHUNK >= length) ? onDone : nullptr);
+      }
+      return sent;
+    }
+    // The period is only for timers
+    uint8_t scriptTrigger (int slot, ScriptTrigger trigger, int periodMillis = 0, DoneCallback onDone = nullptr) {
+      if (trigger == SCRIPT_TRIGGER_TIMER) {
+        return format(onDone, "V/TRG>%d,T,%d", slot, periodMillis);
+      }
+      return format(onDone, "V/TRG>%d,%c", slot, "NPRAT"[trigger]);
+    }
+    uint8_t scriptRun (int slot, DoneCallback onDone = nullptr) {
+      return format(onDone, "V/RUN>%d", slot);
+    }
+    // Negative for every script
+    uint8_t scriptStop (int slot = -1, DoneCallback onDone = nullptr) {
+      return (slot < 0) ? command("V/STP", onDone) : format(onDone, "V/STP>%d", slot);
+    }
+    uint8_t scriptClear (int slot, DoneCallback onDone = nullptr) {
+      return format(onDone, "V/CLR>%d", slot);
+    }
+
+    // Everything
+    // ============================
+    uint8_t reset (DoneCallback onDone = nullptr) {
+      return command("R", onDone);
+    }
+    uint8_t presetRecall (const char *name, DoneCallback onDone = nullptr) {
+      return format(onDone, "M>%s", name);
+    }
+  protected:
+    uint8_t command (const std::string &text, DoneCallback onDone) {
+      return static_cast<Sink *>(this)->command(text, onDone);
+    }
+    template<typename... Args>
+    uint8_t format (DoneCallback onDone, const char *pattern, Args... args) {
+      char text[64];
+      snprintf(text, sizeof(text), pattern, args...);
+      return command(text, onDone);
+    }
+    // Optional side argument, after `separator`
+    static const char *sideSuffix (Side side, char separator) {
+      switch (side) {
+        case SIDE_LEFT:
+          return (separator == '>') ? ">L" : ",L";
+        case SIDE_RIGHT:
+          return (separator == '>') ? ">R" : ",R";
+        default:
+          return "";
+      }
+    }
+};
+
+#endif
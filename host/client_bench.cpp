@@ -0,0 +1,112 @@
+// Measures sustained command throughput through `SorcerClient`, waiting for
+// each ACK in turn against pipelining and batching. Runs against the mock
+// device, or a real head:
+//
+//   g++ -std=gnu++11 -Isrc host/mock_device.cpp src/ServoModel.cpp -o mock_device
+//   g++ -std=gnu++11 host/client_bench.cpp host/SorcerClient.cpp -o client_bench
+//   ./mock_device 115200 &
+//   ./client_bench [pty path printed by mock_device] [commands]
+//
+// Throughput against the mock at a given baud rate shows what the link allows;
+// without one, what the client itself can sustain
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "SorcerClient.h"
+
+#define BENCH_DEFAULT_COMMANDS 2000
+#define BENCH_BATCH_SIZE 8
+#define BENCH_TIMEOUT_MS 60000
+
+static double nowSeconds () {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Typical show traffic: colors, drawings and gaze, none of which block
+template<class Sink>
+static void addCommand (SorcerCommands<Sink> *sink, int i) {
+  switch (i % 4) {
+    case 0:
+      sink->eyeColor(EYE_RED, SIDE_LEFT);
+      break;
+    case 1:
+      sink->eyeGaze((i % 200) - 100, 20);
+      break;
+    case 2:
+      sink->jawColor(0x00ff00 + i % 256);
+      break;
+    default:
+      sink->eyeOpen();
+      break;
+  }
+}
+
+static void report (const char *name, SorcerClient *client, int count, double elapsed, uint8_t drained) {
+  if (!drained) {
+    printf("%-10s timed out with %zu unacknowledged\n", name, client->unacknowledged() + client->queued());
+    return;
+  }
+  printf("%-10s %6d commands in %7.3f s = %8.0f commands/s, %u bad ACKs\n",
+    name, count, elapsed, count / elapsed, client->mismatchedAcks());
+}
+
+int main (int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s [device] [commands]\n", argv[0]);
+    return 1;
+  }
+  int count = ((argc > 2) ? atoi(argv[2]) : BENCH_DEFAULT_COMMANDS);
+  SorcerClient client;
+  if (!client.open(argv[1])) {
+    perror(argv[1]);
+    return 1;
+  }
+  client.poll(100);
+
+  // One command at a time, waiting for each ACK
+  double start = nowSeconds();
+  uint8_t drained = 1;
+  for (int i = 0; i < count && drained; i++) {
+    addCommand(&client, i);
+    drained = client.drain(BENCH_TIMEOUT_MS);
+  }
+  report("serial", &client, count, nowSeconds() - start, drained);
+
+  // Everything queued up front, written as the window allows
+  start = nowSeconds();
+  for (int i = 0; i < count; i++) {
+    addCommand(&client, i);
+  }
+  drained = client.drain(BENCH_TIMEOUT_MS);
+  report("pipelined", &client, count, nowSeconds() - start, drained);
+
+  // Fixed-size batches, each sent in one write
+  start = nowSeconds();
+  SorcerBatch batch;
+  for (int i = 0; i < count; i++) {
+    addCommand(&batch, i);
+    if (batch.size() == BENCH_BATCH_SIZE) {
+      client.send(batch);
+      batch.clear();
+      client.poll(0);
+    }
+  }
+  client.send(batch);
+  drained = client.drain(BENCH_TIMEOUT_MS);
+  report("batched", &client, count, nowSeconds() - start, drained);
+
+  // Tagged, so each is only counted once the device reports it done
+  start = nowSeconds();
+  int completed = 0;
+  for (int i = 0; i < count; i++) {
+    client.eyeOpen(SIDE_BOTH, [&completed] (uint16_t, uint8_t dropped) {
+      completed += !dropped;
+    });
+  }
+  drained = client.drain(BENCH_TIMEOUT_MS, 1);
+  report("completed", &client, completed, nowSeconds() - start, drained);
+  return 0;
+}
@@ -0,0 +1,139 @@
+// Fires the same cue on several heads at once, each from its own clock.
+// Estimates each head's clock offset with pings, arms a blink on all of them,
+// then schedules the fire for one moment in host time, converted to each
+// head's time. Runs against mock devices, or real heads:
+//
+//   g++ -std=gnu++11 -Isrc host/mock_device.cpp src/ServoModel.cpp -o mock_device
+//   g++ -std=gnu++11 host/cue_sync.cpp host/SorcerClient.cpp -o cue_sync
+//   ./mock_device 115200 1 &
+//   ./mock_device 115200 2 &
+//   ./cue_sync [delay ms] [pty path printed by each mock_device]...
+//
+// The mocks log when each cue fires against the wall clock, which shows the
+// skew between heads directly. The time each DONE arrives is printed here too,
+// but also includes the trip back over the link
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "SorcerClient.h"
+
+#define SYNC_PINGS 8
+#define SYNC_CUE_SLOT 0
+#define SYNC_TIMEOUT_MS 2000
+
+typedef struct {
+  SorcerClient *client;
+  const char *path;
+  // Device time less host time, from the ping with the shortest round trip
+  int64_t offsetMicros;
+  int64_t roundTripMicros;
+  int64_t doneMicros;
+} Head;
+
+static int64_t nowMicros () {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+// Ping a head until the best offset estimate has been taken, the same way as
+// NTP: the offset is the average of the two one-way differences
+static uint8_t syncClock (Head *head) {
+  head->roundTripMicros = -1;
+  for (int i = 0; i < SYNC_PINGS; i++) {
+    uint8_t replied = 0;
+    uint32_t rxMicros = 0;
+    uint32_t txMicros = 0;
+    head->client->onLine([&] (const std::string &line) {
+      unsigned int tag;
+      if (sscanf(line.c_str(), "S/PNG>%u,%u,%u", &tag, &rxMicros, &txMicros) == 3 && (int)tag == i) {
+        replied = 1;
+      }
+    });
+    int64_t sentMicros = nowMicros();
+    head->client->command("S/PNG>" + std::to_string(i));
+    int64_t deadline = sentMicros + SYNC_TIMEOUT_MS * 1000LL;
+    while (!replied && nowMicros() < deadline) {
+      if (head->client->poll(1) < 0) {
+        return 0;
+      }
+    }
+    int64_t receivedMicros = nowMicros();
+    if (!replied) {
+      return 0;
+    }
+    int64_t roundTrip = (receivedMicros - sentMicros) - (int64_t)(uint32_t)(txMicros - rxMicros);
+    if (head->roundTripMicros < 0 || roundTrip < head->roundTripMicros) {
+      head->roundTripMicros = roundTrip;
+      head->offsetMicros = ((rxMicros - sentMicros) + (txMicros - receivedMicros)) / 2;
+    }
+  }
+  head->client->onLine(nullptr);
+  return head->client->drain(SYNC_TIMEOUT_MS);
+}
+
+int main (int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s [delay ms] [device]...\n", argv[0]);
+    return 1;
+  }
+  int delayMillis = atoi(argv[1]);
+  std::vector<Head> heads;
+  for (int i = 2; i < argc; i++) {
+    Head head = {new SorcerClient(), argv[i], 0, -1, -1};
+    if (!head.client->open(argv[i])) {
+      perror(argv[i]);
+      return 1;
+    }
+    heads.push_back(head);
+  }
+
+  for (size_t i = 0; i < heads.size(); i++) {
+    heads[i].client->poll(100);
+    if (!syncClock(&heads[i])) {
+      fprintf(stderr, "%s: no reply to pings\n", heads[i].path);
+      return 1;
+    }
+    heads[i].client->cueClear();
+    heads[i].client->cueArm(SYNC_CUE_SLOT, "E/A/BLK");
+    heads[i].client->drain(SYNC_TIMEOUT_MS);
+  }
+
+  // One moment in host time, handed to each head in its own time
+  int64_t fireMicros = nowMicros() + delayMillis * 1000LL;
+  for (size_t i = 0; i < heads.size(); i++) {
+    Head *head = &heads[i];
+    SorcerBatch batch;
+    batch.at((uint32_t)(fireMicros + head->offsetMicros));
+    batch.cueFire(SYNC_CUE_SLOT, [head] (uint16_t, uint8_t dropped) {
+      head->doneMicros = dropped ? -1 : nowMicros();
+    });
+    head->client->send(batch);
+  }
+  // Every head is read in turn, so no DONE waits on another head's
+  int64_t deadline = fireMicros + SYNC_TIMEOUT_MS * 1000LL;
+  size_t pending = heads.size();
+  while (pending > 0 && nowMicros() < deadline) {
+    pending = 0;
+    for (size_t i = 0; i < heads.size(); i++) {
+      heads[i].client->poll(0);
+      pending += heads[i].client->pendingCompletions();
+    }
+    usleep(100);
+  }
+
+  for (size_t i = 0; i < heads.size(); i++) {
+    printf("%s: offset %lld us, round trip %lld us, ", heads[i].path,
+      (long long)heads[i].offsetMicros, (long long)heads[i].roundTripMicros);
+    if (heads[i].doneMicros < 0) {
+      printf("no DONE\n");
+    } else {
+      printf("DONE %+lld us from the fire time\n", (long long)(heads[i].doneMicros - fireMicros));
+    }
+    delete heads[i].client;
+  }
+  return 0;
+}
@@ -0,0 +1,618 @@
+// Stands in for the head on the host, speaking the serial protocol over a
+// pseudo-terminal, so client code can be developed and tested without
+// hardware:
+//
+//   g++ -std=gnu++11 -Isrc host/mock_device.cpp src/ServoModel.cpp -o mock_device
+//   ./mock_device [baud] [id] [groups]
+//
+// The path of the pty is printed on startup; open it like a serial port.
+// Given a baud rate, bytes move no faster in either direction than a UART at
+// that rate would move them. A baud rate of 0 leaves the link unthrottled.
+// Typing `b` and enter toggles the button, and `t` pulls the cue trigger.
+//
+// Several can run at once to stand in for a set of heads, each with its own
+// ID and groups. Each logs the cues it fires to stderr against the wall
+// clock, so how closely they fire together can be read off the logs
+//
+// Every command is acknowledged as on the device, and the timing the host can
+// see is modelled: servo moves take as long as the dynamics model says (at
+// full speed, whatever `SPD` is set to), eye animations take their frame
+// count times the step delay, and blocking commands hold up the commands
+// behind them. Tagged and scheduled commands, reset progress, the emergency
+// stop, waypoints, clock pings, addressing and cues behave as on the device. Commands with no
+// visible timing, such as drawings and presets, are acknowledged and ignored
+
+#define _XOPEN_SOURCE 600
+#include <ctype.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "ServoModel.h"
+
+// Per MAX_CMD_SIZE and RX_LINE_SIZE in the sketch, less the terminator
+#define MOCK_MAX_COMMAND_SIZE 39
+#define MOCK_MAX_LINE_SIZE 55
+#define MOCK_COMPLETION_SLOTS 16
+#define MOCK_SCHEDULE_SIZE 16
+#define MOCK_WAYPOINT_QUEUE_SIZE 16
+// Per CueTable.h
+#define MOCK_CUE_SLOTS 8
+#define MOCK_CUE_SIZE 128
+// Most time a budget carries over, covering a slow pass
+#define MOCK_BANKED_MICROS 2000
+
+// Dynamics defaults, per ServoDS3218.h and MicroServoSG90.h
+#define MOCK_ARM_SLEW 600
+#define MOCK_ARM_ACCEL 4000
+#define MOCK_JAW_SLEW 6000
+#define MOCK_JAW_ACCEL 150000
+
+// Frames in each eye animation, for working out when it ends
+#define MOCK_BLINK_FRAMES 4
+#define MOCK_SPIRAL_FRAMES 24
+
+#define BUSY_ACTUATOR 0x01
+#define BUSY_JAW 0x02
+#define BUSY_EYES 0x04
+#define BUSY_QUEUED 0x80
+
+typedef struct {
+  int leftPos;
+  int rightPos;
+  uint32_t durationMillis;
+} MockWaypoint;
+
+// One servo, following its target per the dynamics model
+class MockServo {
+  public:
+    ServoModel model;
+    float target;
+
+    MockServo (float slew, float accel, float pos): model(slew, accel) {
+      model.reset(pos);
+      target = pos;
+    }
+    uint8_t isMoving () {
+      return !model.settled(target);
+    }
+    void stop () {
+      target = model.getPos();
+      model.reset(target);
+    }
+};
+
+static int master;
+static uint32_t startMicros;
+
+MockServo leftArm(MOCK_ARM_SLEW, MOCK_ARM_ACCEL, 500);
+MockServo rightArm(MOCK_ARM_SLEW, MOCK_ARM_ACCEL, 500);
+MockServo jawServo(MOCK_JAW_SLEW, MOCK_JAW_ACCEL, 0);
+
+std::deque<MockWaypoint> waypoints;
+// Timed moves don't arrive before their duration is up
+uint32_t segmentEndMicros;
+
+// End of the current eye animation. Set for as long as one is running
+uint8_t eyesAnimating;
+uint8_t eyesEndless;
+uint32_t eyesEndMicros;
+
+// Tag and busy subsystems of each tracked command, 0 if unused
+uint16_t completionIds[MOCK_COMPLETION_SLOTS];
+uint8_t completionMasks[MOCK_COMPLETION_SLOTS];
+uint8_t resetMask;
+
+// Scheduled commands by device time
+std::multimap<uint32_t, std::string> schedule;
+
+// Output not yet sent
+std::string txPending;
+
+// Set while a blocking command waits on the servos
+uint8_t blocked;
+
+uint8_t buttonPressed;
+
+uint8_t deviceId;
+uint16_t deviceGroups;
+// Commands armed in each cue, and the cue waiting on the trigger, if any
+std::vector<std::string> cues[MOCK_CUE_SLOTS];
+int cueTriggerSlot = -1;
+uint8_t cueFiring;
+
+static uint32_t micros () {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)(now.tv_sec * 1000000ULL + now.tv_nsec / 1000) - startMicros;
+}
+
+static void print (const std::string &text) {
+  txPending += text;
+}
+
+// Bytes a UART could have moved in `dtMicros` at `baud`, 10 bits per byte,
+// added to what is left from before. Budgets are zeroed while idle, as a UART
+// can't catch up by going faster
+static double refill (double budget, uint32_t dtMicros, long baud) {
+  double cap = baud * MOCK_BANKED_MICROS / 10e6;
+  budget += dtMicros * baud / 10e6;
+  return (budget < cap) ? budget : cap;
+}
+
+static uint8_t actuatorMoving () {
+  return leftArm.isMoving() || rightArm.isMoving() || !waypoints.empty() || (int32_t)(micros() - segmentEndMicros) < 0;
+}
+
+static void moveBoth (int leftPos, int rightPos) {
+  waypoints.clear();
+  leftArm.target = leftPos;
+  rightArm.target = rightPos;
+}
+
+static void startEyes (uint32_t durationMicros, uint8_t endless) {
+  eyesAnimating = 1;
+  eyesEndless = endless;
+  eyesEndMicros = micros() + durationMicros;
+}
+
+static void emergencyStop () {
+  leftArm.stop();
+  rightArm.stop();
+  jawServo.stop();
+  waypoints.clear();
+  segmentEndMicros = micros();
+  eyesAnimating = 0;
+  schedule.clear();
+  blocked = 0;
+  print("ACK: !\n");
+}
+
+static void reset () {
+  moveBoth(500, 500);
+  jawServo.target = 0;
+  eyesAnimating = 0;
+  resetMask = BUSY_ACTUATOR | BUSY_JAW;
+  print("R/EYE\n");
+}
+
+static void handleActuatorCmd (const char *command) {
+  int arg0 = 1000, arg1, arg2, arg3 = 0;
+  const char *args = strchr(command, '>');
+  uint8_t blocking = (args != NULL && strchr(args, 'B') != NULL);
+  if (strncmp(command, "RST", 3) == 0 || strncmp(command, "MID", 3) == 0) {
+    moveBoth(500, 500);
+    blocking |= (command[0] == 'R');
+  } else if (strncmp(command, "UPP", 3) == 0) {
+    moveBoth(950, 950);
+  } else if (strncmp(command, "DWN", 3) == 0) {
+    moveBoth(0, 0);
+  } else if (strncmp(command, "UNL", 3) == 0) {
+    moveBoth(1000, 1000);
+  } else if (strncmp(command, "TLL", 3) == 0 || strncmp(command, "TLR", 3) == 0) {
+    sscanf(command + 3, ">%d", &arg0);
+    int half = arg0 / 2;
+    half = (half < 0) ? 0 : ((half > 950) ? 950 : half);
+    int sign = (command[2] == 'R') ? 1 : -1;
+    moveBoth(500 + sign * half, 500 - sign * half);
+  } else if (strncmp(command, "BNC", 3) == 0 || strncmp(command, "SHK", 3) == 0) {
+    // Both end where they started, after blocking through the middle moves
+    moveBoth(500, 500);
+    blocking = 1;
+  } else if (sscanf(command, "WPT>%d,%d,%d,%d", &arg1, &arg2, &arg0, &arg3) >= 3) {
+    if (waypoints.size() >= MOCK_WAYPOINT_QUEUE_SIZE) {
+      print("A/FULL\n");
+    } else {
+      MockWaypoint waypoint = {arg1, arg2, (uint32_t)arg0};
+      waypoints.push_back(waypoint);
+    }
+  } else if (strncmp(command, "WPC", 3) == 0) {
+    waypoints.clear();
+  }
+  blocked |= blocking;
+}
+
+static void handleJawCmd (const char *command) {
+  if (strncmp(command, "OPN", 3) == 0) {
+    jawServo.target = 400;
+  } else if (strncmp(command, "CLS", 3) == 0) {
+    jawServo.target = 0;
+  } else {
+    return;
+  }
+  blocked |= (strncmp(command + 3, ">B", 2) == 0);
+}
+
+static void handleEyeCmd (const char *command) {
+  int stepDelay;
+  if (strncmp(command, "A/BLK", 5) == 0 || strncmp(command, "A/WNK", 5) == 0) {
+    stepDelay = 75;
+    if (command[2] == 'B') {
+      sscanf(command + 5, ">%d", &stepDelay);
+    } else {
+      char side;
+      sscanf(command + 5, ">%c,%d", &side, &stepDelay);
+    }
+    startEyes(MOCK_BLINK_FRAMES * stepDelay * 1000, 0);
+  } else if (strncmp(command, "A/SP", 4) == 0) {
+    stepDelay = 50;
+    sscanf(command + 5, ">%d", &stepDelay);
+    startEyes(MOCK_SPIRAL_FRAMES * stepDelay * 1000, 0);
+  } else if (strncmp(command, "D/RNB", 5) == 0) {
+    startEyes(0, 1);
+  } else if (command[0] != 'B') {
+    // Every other eye command replaces any animation
+    eyesAnimating = 0;
+  }
+}
+
+static uint8_t busyMaskFor (char cmd) {
+  switch (cmd) {
+    case 'A':
+      return BUSY_ACTUATOR;
+    case 'J':
+      return BUSY_JAW;
+    case 'E':
+      return BUSY_EYES;
+    case 'R':
+    case 'M':
+    case 'F':
+      return BUSY_ACTUATOR | BUSY_JAW | BUSY_EYES;
+    default:
+      return 0;
+  }
+}
+
+static void handleMessage (const char *line);
+
+static void handleTaggedCommand (const char *line) {
+  char *separator;
+  unsigned long id = strtoul(line, &separator, 10);
+  if (separator == line || *separator != ':') {
+    return;
+  }
+  handleMessage(separator + 1);
+  for (int i = 0; i < MOCK_COMPLETION_SLOTS; i++) {
+    if (completionMasks[i] == 0) {
+      completionIds[i] = (uint16_t)id;
+      completionMasks[i] = busyMaskFor(separator[1]) | BUSY_QUEUED;
+      return;
+    }
+  }
+  print("DROP: " + std::to_string(id) + "\n");
+}
+
+// Strip an address from a line, per matchAddress in the sketch
+static const char *matchAddress (const char *line) {
+  const char *separator = strchr(line, ':');
+  if (separator == NULL) {
+    return NULL;
+  }
+  uint8_t matched;
+  char *end;
+  if (line[0] == '*') {
+    matched = (separator == line + 1);
+  } else if (line[0] == 'G') {
+    long group = strtol(line + 1, &end, 10);
+    matched = (isdigit((uint8_t)line[1]) && end == separator && group < 16 && (deviceGroups & (1 << group)));
+  } else {
+    long id = strtol(line, &end, 10);
+    matched = (isdigit((uint8_t)line[0]) && end == separator && id == deviceId);
+  }
+  return matched ? separator + 1 : NULL;
+}
+
+static void armCue (const char *line) {
+  char *separator;
+  unsigned long slot = strtoul(line, &separator, 10);
+  if (separator == line || *separator != ':' || slot >= MOCK_CUE_SLOTS) {
+    return;
+  }
+  size_t used = 0;
+  for (size_t i = 0; i < cues[slot].size(); i++) {
+    used += cues[slot][i].size() + 1;
+  }
+  if (used + strlen(separator + 1) + 1 > MOCK_CUE_SIZE) {
+    print("F/FULL\n");
+    return;
+  }
+  cues[slot].push_back(separator + 1);
+}
+
+static void fireCue (int slot) {
+  if (cueFiring) {
+    return;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  fprintf(stderr, "%d: cue %d fired at %ld.%06ld\n", deviceId, slot, (long)now.tv_sec, now.tv_nsec / 1000);
+  cueFiring = 1;
+  for (size_t i = 0; i < cues[slot].size(); i++) {
+    handleMessage(cues[slot][i].c_str());
+  }
+  cueFiring = 0;
+}
+
+static void handleCueCmd (const char *command) {
+  int slot;
+  uint8_t hasSlot = (sscanf(command + 3, ">%d", &slot) == 1) && slot >= 0 && slot < MOCK_CUE_SLOTS;
+  if (strncmp(command, "FIR", 3) == 0 && hasSlot) {
+    fireCue(slot);
+  } else if (strncmp(command, "TRG", 3) == 0 && hasSlot) {
+    cueTriggerSlot = slot;
+  } else if (strncmp(command, "CLR", 3) == 0) {
+    if (hasSlot) {
+      cues[slot].clear();
+    } else {
+      for (int i = 0; i < MOCK_CUE_SLOTS; i++) {
+        cues[i].clear();
+      }
+      cueTriggerSlot = -1;
+    }
+  }
+}
+
+static void handleIdentityCmd (const char *command) {
+  int arg0;
+  if (sscanf(command, "ID>%d", &arg0) == 1) {
+    deviceId = (arg0 < 0) ? 0 : ((arg0 > 254) ? 254 : arg0);
+  } else if (sscanf(command, "GRP>%d", &arg0) == 1) {
+    deviceGroups = (arg0 < 0) ? 0 : ((arg0 > 0xffff) ? 0xffff : arg0);
+  } else if (strncmp(command, "ID", 2) == 0) {
+    print("N/ID>" + std::to_string(deviceId) + "," + std::to_string(deviceGroups) + "\n");
+  }
+}
+
+static void handleMessage (const char *line) {
+  if (line[0] == '@') {
+    char *separator;
+    uint32_t time = strtoul(line + 1, &separator, 10);
+    if (*separator != ':') {
+      return;
+    }
+    if (schedule.size() >= MOCK_SCHEDULE_SIZE) {
+      print("S/FULL\n");
+      return;
+    }
+    schedule.insert(std::make_pair(time, std::string(separator + 1)));
+    return;
+  }
+  if (line[0] == '#') {
+    handleTaggedCommand(line + 1);
+    return;
+  }
+  if (line[0] == '^') {
+    armCue(line + 1);
+    return;
+  }
+  if (line[0] == 'R') {
+    reset();
+    return;
+  }
+  if (line[0] == '\0' || line[1] != '/') {
+    return;
+  }
+  const char *subcmd = line + 2;
+  switch (line[0]) {
+    case 'A':
+      handleActuatorCmd(subcmd);
+      break;
+    case 'J':
+      handleJawCmd(subcmd);
+      break;
+    case 'E':
+      handleEyeCmd(subcmd);
+      break;
+    case 'N':
+      handleIdentityCmd(subcmd);
+      break;
+    case 'F':
+      handleCueCmd(subcmd);
+      break;
+    case 'S':
+      if (strncmp(subcmd, "PNG", 3) == 0) {
+        uint32_t now = micros();
+        const char *tag = ((subcmd[3] == '>') ? subcmd + 4 : "");
+        print("S/PNG>" + std::string(tag) + "," + std::to_string(now) + "," + std::to_string(micros()) + "\n");
+      } else if (strncmp(subcmd, "CLR", 3) == 0) {
+        schedule.clear();
+      }
+      break;
+  }
+}
+
+// Advance the servos, start waypoints and report anything that finished
+static void update (uint32_t dtMicros) {
+  leftArm.model.step(leftArm.target, dtMicros);
+  rightArm.model.step(rightArm.target, dtMicros);
+  jawServo.model.step(jawServo.target, dtMicros);
+  if (!waypoints.empty() && !leftArm.isMoving() && !rightArm.isMoving() && (int32_t)(micros() - segmentEndMicros) >= 0) {
+    MockWaypoint waypoint = waypoints.front();
+    waypoints.pop_front();
+    leftArm.target = waypoint.leftPos;
+    rightArm.target = waypoint.rightPos;
+    segmentEndMicros = micros() + waypoint.durationMillis * 1000;
+  }
+  if (eyesAnimating && !eyesEndless && (int32_t)(micros() - eyesEndMicros) >= 0) {
+    eyesAnimating = 0;
+  }
+
+  uint8_t idleMask = BUSY_QUEUED;
+  if (!actuatorMoving()) {
+    idleMask |= BUSY_ACTUATOR;
+  }
+  if (!jawServo.isMoving()) {
+    idleMask |= BUSY_JAW;
+  }
+  if (!eyesAnimating) {
+    idleMask |= BUSY_EYES;
+  }
+  if (blocked && (idleMask & BUSY_ACTUATOR) && (idleMask & BUSY_JAW)) {
+    blocked = 0;
+  }
+  for (int i = 0; i < MOCK_COMPLETION_SLOTS; i++) {
+    if (completionMasks[i] != 0) {
+      completionMasks[i] &= ~idleMask;
+      if (completionMasks[i] == 0) {
+        print("DONE: " + std::to_string(completionIds[i]) + "\n");
+      }
+    }
+  }
+  if (resetMask != 0) {
+    uint8_t done = resetMask & idleMask;
+    if (done & BUSY_JAW) {
+      print("R/JAW\n");
+    }
+    if (done & BUSY_ACTUATOR) {
+      print("R/ACT\n");
+    }
+    resetMask &= ~idleMask;
+    if (resetMask == 0) {
+      print("R/DONE\n");
+    }
+  }
+}
+
+int main (int argc, char **argv) {
+  long baud = ((argc > 1) ? atol(argv[1]) : 0);
+  deviceId = ((argc > 2) ? atoi(argv[2]) : 0);
+  deviceGroups = ((argc > 3) ? atoi(argv[3]) : 0);
+
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("pty");
+    return 1;
+  }
+  // Hold the other end open, so the pty survives clients coming and going,
+  // and make it raw, as a serial port would be
+  int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  struct termios settings;
+  tcgetattr(slave, &settings);
+  cfmakeraw(&settings);
+  tcsetattr(slave, TCSANOW, &settings);
+
+  startMicros = 0;
+  startMicros = micros();
+  printf("%s\n", ptsname(master));
+  fflush(stdout);
+
+  std::string rxPending;
+  // Lines still to come that arrived before a stop, which are not run
+  size_t discardLines = 0;
+  // Bytes each direction may move this pass, at the line rate
+  double rxBudget = 0;
+  double txBudget = 0;
+  uint8_t stdinOpen = 1;
+  uint32_t lastMicros = micros();
+  while (1) {
+    struct pollfd fds[2] = {{master, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+    ::poll(fds, stdinOpen ? 2 : 1, 1);
+    uint32_t now = micros();
+    uint32_t dtMicros = now - lastMicros;
+    lastMicros = now;
+
+    if (stdinOpen && (fds[1].revents & (POLLIN | POLLHUP))) {
+      char typed[64];
+      ssize_t count = read(STDIN_FILENO, typed, sizeof(typed));
+      if (count <= 0) {
+        // Running in the background, with nothing to type
+        stdinOpen = 0;
+      } else if (typed[0] == 'b') {
+        buttonPressed = !buttonPressed;
+        print(buttonPressed ? "B/ON\n" : "B/OFF\n");
+      } else if (typed[0] == 't' && cueTriggerSlot >= 0) {
+        int slot = cueTriggerSlot;
+        cueTriggerSlot = -1;
+        fireCue(slot);
+      }
+    }
+
+    size_t room = 256;
+    if (baud > 0) {
+      rxBudget = refill(rxBudget, dtMicros, baud);
+      room = (rxBudget < room) ? (size_t)rxBudget : room;
+    }
+    if ((fds[0].revents & POLLIN) && room > 0) {
+      char received[256];
+      ssize_t count = read(master, received, room);
+      for (ssize_t i = 0; i < count; i++) {
+        // The stop is acted on as soon as it's read, even mid-command
+        if (received[i] == '!') {
+          emergencyStop();
+          // Lines sent before the stop, including one partly read, are cancelled
+          for (size_t j = 0; j < rxPending.size(); j++) {
+            discardLines += (rxPending[j] == '\n');
+          }
+          discardLines += (!rxPending.empty() && rxPending[rxPending.size() - 1] != '\n');
+        } else {
+          rxPending += received[i];
+        }
+      }
+      rxBudget -= (count > 0) ? count : 0;
+    } else if (!(fds[0].revents & POLLIN)) {
+      // Nothing on the way, so the next byte starts from now
+      rxBudget = 0;
+    }
+
+    update(dtMicros);
+    while (!schedule.empty() && (int32_t)(micros() - schedule.begin()->first) >= 0) {
+      std::string line = schedule.begin()->second;
+      schedule.erase(schedule.begin());
+      handleMessage(line.c_str());
+    }
+    // Lines wait while a blocking command runs
+    while (!blocked) {
+      size_t end = rxPending.find('\n');
+      if (end == std::string::npos) {
+        break;
+      }
+      std::string line = rxPending.substr(0, (end < MOCK_MAX_LINE_SIZE) ? end : MOCK_MAX_LINE_SIZE);
+      rxPending.erase(0, end + 1);
+      const char *message = line.c_str();
+      print("ACK: " + line + "\n");
+      if (line[0] == '~') {
+        message = matchAddress(message + 1);
+      }
+      if (discardLines > 0) {
+        discardLines--;
+        if (message != NULL && message[0] == '#') {
+          print("DROP: " + std::to_string(strtoul(message + 1, NULL, 10) & 0xffff) + "\n");
+        }
+        continue;
+      }
+      // Lines too long to be a command are dropped whole, except trace loads
+      if (message != NULL && (end > MOCK_MAX_LINE_SIZE ||
+          (strlen(message) > MOCK_MAX_COMMAND_SIZE && strncmp(message, "T/LD>", 5) != 0))) {
+        message = NULL;
+      }
+      if (message == NULL) {
+        continue;
+      }
+      handleMessage(message);
+    }
+
+    size_t sendable = txPending.size();
+    if (baud > 0) {
+      txBudget = refill(txBudget, dtMicros, baud);
+      sendable = (txBudget < sendable) ? (size_t)txBudget : sendable;
+    }
+    if (sendable > 0) {
+      ssize_t written = write(master, txPending.data(), sendable);
+      if (written > 0) {
+        txPending.erase(0, written);
+        txBudget -= written;
+      }
+    }
+    if (txPending.empty()) {
+      txBudget = 0;
+    }
+  }
+}
@@ -0,0 +1,190 @@
+// Runs the PCA9685 driver against a register-level mock of the chip, checks
+// the registers it ends up with, and measures the bus traffic and time per
+// update tick with and without batching:
+//
+//   g++ -std=gnu++11 -O2 -Isrc host/pwm_bench.cpp src/Pca9685Pwm.cpp src/PwmOutput.cpp -o pwm_bench
+//   ./pwm_bench [ticks]
+//
+// Bus time is worked out for 400 kHz I2C, 9 clocks per byte plus a start and
+// stop per transaction, as the wire would carry it
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Pca9685Pwm.h"
+
+#define BENCH_DEFAULT_TICKS 20000
+#define BENCH_I2C_HZ 400000
+// Clocks per transaction besides its bytes, for the start and stop
+#define BENCH_I2C_FRAMING_CLOCKS 2
+
+// Registers of one expander, as the chip would hold them
+class MockPca9685: public I2cBus {
+  public:
+    uint8_t registers[256];
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t nacks;
+
+    MockPca9685 (uint8_t address) {
+      this->address = address;
+      reset();
+    }
+    void reset () {
+      // Power-on state: asleep, auto-increment off, every output full off
+      memset(registers, 0, sizeof(registers));
+      registers[PCA9685_MODE1] = PCA9685_MODE1_SLEEP;
+      registers[PCA9685_MODE2] = PCA9685_MODE2_OUTDRV;
+      registers[PCA9685_PRE_SCALE] = 0x1e;
+      for (int channel = 0; channel < PCA9685_CHANNELS; channel++) {
+        registers[PCA9685_LED0_ON_L + 4 * channel + 3] = PCA9685_FULL_OFF;
+      }
+      clearCounts();
+    }
+    void clearCounts () {
+      transactions = 0;
+      bytes = 0;
+      nacks = 0;
+    }
+    uint8_t writeRegisters (uint8_t address, uint8_t reg, const uint8_t *data, uint8_t length) {
+      transactions++;
+      // The address byte and register pointer go out either way
+      bytes += 2;
+      if (address != this->address) {
+        nacks++;
+        return 0;
+      }
+      bytes += length;
+      uint8_t pointer = reg;
+      for (uint8_t i = 0; i < length; i++) {
+        // The prescale only takes while asleep
+        if (pointer != PCA9685_PRE_SCALE || (registers[PCA9685_MODE1] & PCA9685_MODE1_SLEEP)) {
+          registers[pointer] = data[i];
+        }
+        if (registers[PCA9685_MODE1] & PCA9685_MODE1_AI) {
+          pointer++;
+        }
+      }
+      return 1;
+    }
+    // Duty a channel outputs, in driver counts, or -1 if held off
+    int duty (uint8_t channel) {
+      const uint8_t *led = registers + PCA9685_LED0_ON_L + 4 * channel;
+      if (led[3] & PCA9685_FULL_OFF) {
+        return -1;
+      }
+      int on = led[0] | ((led[1] & 0x0f) << 8);
+      int off = led[2] | ((led[3] & 0x0f) << 8);
+      return (off - on) & 0xfff;
+    }
+    float periodHz () {
+      return PCA9685_OSC_HZ / (4096.0f * (registers[PCA9685_PRE_SCALE] + 1));
+    }
+    // Time these transactions would hold the bus
+    double busMicros () {
+      return (bytes * 9.0 + transactions * BENCH_I2C_FRAMING_CLOCKS) * 1e6 / BENCH_I2C_HZ;
+    }
+  protected:
+    uint8_t address;
+};
+
+static double nowMicros () {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+// Servo duties in driver counts, sweeping each channel out of phase, as a
+// set of servos on slow async moves would
+static uint16_t sweepDuty (int tick, int channel) {
+  return 400 + ((tick * 3 + channel * 97) % 1800);
+}
+
+static int verify (MockPca9685 *chip, int tick, uint16_t mask) {
+  int errors = 0;
+  for (int channel = 0; channel < PCA9685_CHANNELS; channel++) {
+    if (mask & (1 << channel)) {
+      int expected = sweepDuty(tick, channel) >> (PWM_DUTY_BITS - PCA9685_DUTY_BITS);
+      errors += (chip->duty(channel) != expected);
+    }
+  }
+  return errors;
+}
+
+// Write the channels in `mask` every tick, flushing after every write or
+// once per tick, and report the traffic per tick
+static void run (const char *name, MockPca9685 *chip, Pca9685Pwm *pwm, int ticks, uint16_t mask, uint8_t batched) {
+  chip->clearCounts();
+  uint32_t burstsBefore = pwm->burstCount();
+  double start = nowMicros();
+  for (int tick = 0; tick < ticks; tick++) {
+    for (int channel = 0; channel < PCA9685_CHANNELS; channel++) {
+      if (mask & (1 << channel)) {
+        pwm->write(channel, sweepDuty(tick, channel));
+        if (!batched) {
+          pwm->flush();
+        }
+      }
+    }
+    pwm->flush();
+  }
+  double elapsed = nowMicros() - start;
+  int errors = verify(chip, ticks - 1, mask);
+  printf("%-18s %5.2f transactions, %6.1f bytes, %7.1f us of bus per tick (%5.0f ticks/s max), driver %5.2f us per tick, %d bad channels\n",
+    name, (double)chip->transactions / ticks, (double)chip->bytes / ticks, chip->busMicros() / ticks,
+    ticks * 1e6 / chip->busMicros(), elapsed / ticks, errors);
+  if (pwm->burstCount() - burstsBefore != chip->transactions) {
+    printf("  burst count %u does not match %u transactions\n", pwm->burstCount() - burstsBefore, chip->transactions);
+  }
+}
+
+int main (int argc, char **argv) {
+  int ticks = ((argc > 1) ? atoi(argv[1]) : BENCH_DEFAULT_TICKS);
+  MockPca9685 chip(PCA9685_DEFAULT_ADDRESS);
+  Pca9685Pwm pwm(&chip);
+
+  // Nothing goes out before `begin`, which then sends every channel at once
+  for (int channel = 0; channel < PCA9685_CHANNELS; channel++) {
+    pwm.attach(channel, 0);
+    pwm.write(channel, sweepDuty(0, channel));
+  }
+  if (chip.transactions != 0) {
+    printf("wrote %u transactions before begin\n", chip.transactions);
+    return 1;
+  }
+  if (!pwm.begin()) {
+    printf("begin failed\n");
+    return 1;
+  }
+  printf("begin: %u transactions, %u bytes, %.1f Hz, %d bad channels\n",
+    chip.transactions, chip.bytes, chip.periodHz(), verify(&chip, 0, 0xffff));
+
+  pwm.release(3);
+  pwm.flush();
+  int released = chip.duty(3);
+  pwm.hold(3);
+  pwm.flush();
+  printf("release: channel 3 %s, then %s on hold\n", (released < 0) ? "held off" : "still pulsing",
+    (chip.duty(3) == (sweepDuty(0, 3) >> 2)) ? "restored" : "not restored");
+
+  // Channels past the chip's last leave every real channel alone
+  unsigned int transactionsBefore = chip.transactions;
+  pwm.write(PCA9685_CHANNELS, 0);
+  pwm.release(PCA9685_CHANNELS + 8);
+  pwm.hold(255);
+  pwm.flush();
+  printf("out of range channels: %u transactions, %d bad channels\n",
+    chip.transactions - transactionsBefore, verify(&chip, 0, 0xffff));
+
+  run("16 per write", &chip, &pwm, ticks, 0xffff, 0);
+  run("16 batched", &chip, &pwm, ticks, 0xffff, 1);
+  run("4 adjacent write", &chip, &pwm, ticks, 0x000f, 0);
+  run("4 adjacent batch", &chip, &pwm, ticks, 0x000f, 1);
+  run("4 spread write", &chip, &pwm, ticks, 0x8421, 0);
+  run("4 spread batch", &chip, &pwm, ticks, 0x8421, 1);
+
+  Pca9685Pwm missing(&chip, PCA9685_DEFAULT_ADDRESS + 1);
+  printf("absent expander: begin %s\n", missing.begin() ? "succeeded" : "failed");
+  return 0;
+}
@@ -0,0 +1,275 @@
+// Assembles an on-device script and prints the commands that load it into a
+// slot and bind its trigger, ready to send to a head:
+//
+//   g++ -std=gnu++11 -Isrc host/script_asm.cpp -o script_asm
+//   ./script_asm [slot] [trigger] < laugh.txt > /dev/ttyACM0
+//
+// The trigger is as `V/TRG`: P, R, A, T,[period ms] or N. Without one the
+// script is only loaded. Input has one instruction per line, with operands
+// separated by spaces, and `[label]:` lines to jump to. Text after `#` is a
+// comment, except where it starts a color:
+//
+//   end                        waitev press|release|anim|timer
+//   wait [ms]                  waitdone eyes|jaw|act|all[+...]
+//   waitrnd [max ms]           jump [label]
+//   chance [percent] [label]   set r[n] [value]
+//   loop r[n] [label]          emit [value]
+//   shape [shape] [side]       color #rrggbb [side]
+//   gaze [x] [y] [side]        anim [animation] [step ms] [side]
+//   jawopen                    jawclose
+//   jawcolor #rrggbb           jawspeed [speed]
+//   pose [lift] [tilt]         move [left] [right]
+//   actspeed [speed]
+//
+// Shapes are open, close, dilate, contract, squint, dead, up, down, left and
+// right. Animations are blink, rainbow, dotup, dotdown, lineup and linedown,
+// with a step of 0 for the default. Sides are both, left or right, and may be
+// left off for both
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "ScriptCode.h"
+
+// Bytes per load command, leaving room in a message for an address or tag
+#define ASM_CHUNK_BYTES 12
+
+typedef struct {
+  int line;
+  std::vector<std::string> tokens;
+} Statement;
+
+static const char * const events[] = {"", "press", "release", "anim", "timer"};
+static const char * const shapes[] = {"open", "close", "dilate", "contract", "squint", "dead", "up", "down", "left", "right"};
+static const char * const animations[] = {"blink", "rainbow", "dotup", "dotdown", "lineup", "linedown"};
+static const char * const sides[] = {"both", "left", "right"};
+
+static int errorLine;
+
+static void fail (const char *message, const std::string &token) {
+  fprintf(stderr, "line %d: %s: %s\n", errorLine, message, token.c_str());
+  exit(1);
+}
+
+// Index of a name in a table
+static int lookup (const std::string &token, const char * const *names, int count, const char *what) {
+  for (int i = 0; i < count; i++) {
+    if (token == names[i]) {
+      return i;
+    }
+  }
+  fail(what, token);
+  return -1;
+}
+
+static long number (const std::string &token, long low, long high) {
+  char *end;
+  long value = strtol(token.c_str(), &end, 0);
+  if (token.empty() || *end != '\0' || value < low || value > high) {
+    fail("bad number", token);
+  }
+  return value;
+}
+
+static int reg (const std::string &token) {
+  if (token.size() != 2 || token[0] != 'r' || token[1] < '0' || token[1] >= '0' + SCRIPT_REGISTERS) {
+    fail("bad register", token);
+  }
+  return token[1] - '0';
+}
+
+static void color (const std::string &token, std::vector<uint8_t> *code) {
+  if (token.size() != 7 || token[0] != '#') {
+    fail("bad color", token);
+  }
+  unsigned long rgb = strtoul(token.c_str() + 1, NULL, 16);
+  code->push_back(rgb >> 16);
+  code->push_back(rgb >> 8);
+  code->push_back(rgb);
+}
+
+static void push16 (long value, std::vector<uint8_t> *code) {
+  code->push_back(value & 0xff);
+  code->push_back((value >> 8) & 0xff);
+}
+
+// Assemble one statement, resolving labels from `labels`
+static void assemble (const Statement &statement, const std::vector<std::pair<std::string, int> > &labels,
+    std::vector<uint8_t> *code) {
+  const std::vector<std::string> &t = statement.tokens;
+  const std::string &name = t[0];
+  // Operand tokens past the mnemonic, with optional trailing side
+  size_t count = t.size() - 1;
+  auto arg = [&] (size_t i) -> const std::string & {
+    if (i > count) {
+      fail("missing operand for", name);
+    }
+    return t[i];
+  };
+  auto side = [&] (size_t i) -> uint8_t {
+    return (i > count) ? SCRIPT_SIDE_BOTH : lookup(t[i], sides, SCRIPT_SIDE_COUNT, "bad side");
+  };
+  auto label = [&] (size_t i) -> uint8_t {
+    for (size_t j = 0; j < labels.size(); j++) {
+      if (labels[j].first == arg(i)) {
+        return labels[j].second;
+      }
+    }
+    fail("no such label", arg(i));
+    return 0;
+  };
+
+  if (name == "end") {
+    code->push_back(SCRIPT_OP_END);
+  } else if (name == "wait" || name == "waitrnd") {
+    code->push_back((name == "wait") ? SCRIPT_OP_WAIT : SCRIPT_OP_WAIT_RANDOM);
+    push16(number(arg(1), 0, 65535), code);
+  } else if (name == "waitev") {
+    code->push_back(SCRIPT_OP_WAIT_EVENT);
+    code->push_back(lookup(arg(1), events + 1, SCRIPT_EVENT_COUNT - 1, "bad event") + 1);
+  } else if (name == "waitdone") {
+    uint8_t mask = 0;
+    std::string parts = arg(1) + "+";
+    for (size_t start = 0, end; (end = parts.find('+', start)) != std::string::npos; start = end + 1) {
+      std::string part = parts.substr(start, end - start);
+      if (part == "eyes") {
+        mask |= SCRIPT_DONE_EYES;
+      } else if (part == "jaw") {
+        mask |= SCRIPT_DONE_JAW;
+      } else if (part == "act") {
+        mask |= SCRIPT_DONE_ACTUATOR;
+      } else if (part == "all") {
+        mask |= SCRIPT_DONE_EYES | SCRIPT_DONE_JAW | SCRIPT_DONE_ACTUATOR;
+      } else {
+        fail("bad output", part);
+      }
+    }
+    code->push_back(SCRIPT_OP_WAIT_DONE);
+    code->push_back(mask);
+  } else if (name == "jump") {
+    code->push_back(SCRIPT_OP_JUMP);
+    code->push_back(label(1));
+  } else if (name == "chance") {
+    code->push_back(SCRIPT_OP_CHANCE);
+    code->push_back(number(arg(1), 0, 100));
+    code->push_back(label(2));
+  } else if (name == "set") {
+    code->push_back(SCRIPT_OP_SET);
+    code->push_back(reg(arg(1)));
+    push16(number(arg(2), 0, 65535), code);
+  } else if (name == "loop") {
+    code->push_back(SCRIPT_OP_LOOP);
+    code->push_back(reg(arg(1)));
+    code->push_back(label(2));
+  } else if (name == "emit") {
+    code->push_back(SCRIPT_OP_EMIT);
+    code->push_back(number(arg(1), 0, 255));
+  } else if (name == "shape") {
+    code->push_back(SCRIPT_OP_EYE_SHAPE);
+    code->push_back(lookup(arg(1), shapes, SCRIPT_SHAPE_COUNT, "bad shape"));
+    code->push_back(side(2));
+  } else if (name == "color") {
+    code->push_back(SCRIPT_OP_EYE_COLOR);
+    color(arg(1), code);
+    code->push_back(side(2));
+  } else if (name == "gaze") {
+    code->push_back(SCRIPT_OP_EYE_GAZE);
+    code->push_back((uint8_t)number(arg(1), -128, 127));
+    code->push_back((uint8_t)number(arg(2), -128, 127));
+    code->push_back(side(3));
+  } else if (name == "anim") {
+    code->push_back(SCRIPT_OP_EYE_ANIM);
+    code->push_back(lookup(arg(1), animations, SCRIPT_ANIM_COUNT, "bad animation"));
+    code->push_back(number(arg(2), 0, 255));
+    code->push_back(side(3));
+  } else if (name == "jawopen") {
+    code->push_back(SCRIPT_OP_JAW_OPEN);
+  } else if (name == "jawclose") {
+    code->push_back(SCRIPT_OP_JAW_CLOSE);
+  } else if (name == "jawcolor") {
+    code->push_back(SCRIPT_OP_JAW_COLOR);
+    color(arg(1), code);
+  } else if (name == "jawspeed" || name == "actspeed") {
+    code->push_back((name == "jawspeed") ? SCRIPT_OP_JAW_SPEED : SCRIPT_OP_ACT_SPEED);
+    code->push_back(number(arg(1), 0, 255));
+  } else if (name == "pose") {
+    code->push_back(SCRIPT_OP_POSE);
+    push16(number(arg(1), -1000, 1000), code);
+    push16(number(arg(2), -1000, 1000), code);
+  } else if (name == "move") {
+    code->push_back(SCRIPT_OP_MOVE);
+    push16(number(arg(1), 0, 1000), code);
+    push16(number(arg(2), 0, 1000), code);
+  } else {
+    fail("unknown instruction", name);
+  }
+}
+
+int main (int argc, char **argv) {
+  int slot = ((argc > 1) ? atoi(argv[1]) : 0);
+  const char *trigger = ((argc > 2) ? argv[2] : NULL);
+
+  // Split into statements and note where each label is. Every statement is
+  // assembled once with placeholder labels to find its size
+  std::vector<Statement> statements;
+  std::vector<std::pair<std::string, int> > labels;
+  std::vector<std::pair<std::string, int> > pending;
+  std::vector<uint8_t> sizing;
+  char text[256];
+  for (int line = 1; fgets(text, sizeof(text), stdin) != NULL; line++) {
+    errorLine = line;
+    Statement statement = {line, {}};
+    for (char *token = strtok(text, " \t\r\n,"); token != NULL; token = strtok(NULL, " \t\r\n,")) {
+      if (token[0] == '#' && strlen(token) != 7) {
+        break;
+      }
+      statement.tokens.push_back(token);
+    }
+    if (statement.tokens.empty()) {
+      continue;
+    }
+    std::string &first = statement.tokens[0];
+    if (first[first.size() - 1] == ':') {
+      labels.push_back(std::make_pair(first.substr(0, first.size() - 1), (int)sizing.size()));
+      continue;
+    }
+    // Labels after this point resolve to 0 for now, which is only a size
+    pending = labels;
+    for (size_t i = 1; i < statement.tokens.size(); i++) {
+      pending.push_back(std::make_pair(statement.tokens[i], 0));
+    }
+    assemble(statement, pending, &sizing);
+    statements.push_back(statement);
+  }
+
+  std::vector<uint8_t> code;
+  for (size_t i = 0; i < statements.size(); i++) {
+    errorLine = statements[i].line;
+    assemble(statements[i], labels, &code);
+  }
+  if (code.size() > SCRIPT_SIZE) {
+    fprintf(stderr, "%u bytes, over the %d byte limit\n", (unsigned int)code.size(), SCRIPT_SIZE);
+    return 1;
+  }
+  int error = scriptVerify(code.data(), code.size());
+  if (error >= 0) {
+    fprintf(stderr, "fails verification at byte %d\n", error);
+    return 1;
+  }
+  fprintf(stderr, "%u bytes\n", (unsigned int)code.size());
+
+  printf("V/CLR>%d\n", slot);
+  for (size_t start = 0; start < code.size(); start += ASM_CHUNK_BYTES) {
+    printf("V/LOD>%d,", slot);
+    for (size_t i = start; i < code.size() && i < start + ASM_CHUNK_BYTES; i++) {
+      printf("%02x", code[i]);
+    }
+    printf("\n");
+  }
+  if (trigger != NULL) {
+    printf("V/TRG>%d,%s\n", slot, trigger);
+  }
+  return 0;
+}
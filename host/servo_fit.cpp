@@ -0,0 +1,46 @@
+// Fits the servo dynamics model to measured move timings and prints the
+// matching `A/DYN` or `J/DYN` command. Runs on the host:
+//
+//   g++ -Isrc host/servo_fit.cpp src/ServoModel.cpp -o servo_fit
+//   ./servo_fit A < timings.csv
+//
+// Input has one move per line, as `[distance],[millis]`: position units
+// travelled and the time from the write to the horn coming to rest, e.g. from
+// slow-motion video or an encoder. Lines starting with `#` are skipped. Use
+// moves of several different lengths, including some short ones, so both
+// slew and acceleration show up in the data
+
+#include <stdio.h>
+#include "ServoModel.h"
+
+#define SERVO_FIT_MAX_SAMPLES 256
+
+int main (int argc, char **argv) {
+  char area = ((argc > 1) ? argv[1][0] : 'A');
+  static ServoTiming samples[SERVO_FIT_MAX_SAMPLES];
+  int count = 0;
+  char line[64];
+  while (fgets(line, sizeof(line), stdin) != NULL && count < SERVO_FIT_MAX_SAMPLES) {
+    unsigned int distance, millis;
+    if (line[0] == '#' || sscanf(line, "%u,%u", &distance, &millis) != 2) {
+      continue;
+    }
+    samples[count].distance = (uint16_t)distance;
+    samples[count].millis = (uint16_t)millis;
+    count++;
+  }
+
+  float slew, accel;
+  if (!ServoModel::fit(samples, count, &slew, &accel)) {
+    fprintf(stderr, "Need moves of at least two different distances\n");
+    return 1;
+  }
+
+  ServoModel model(slew, accel);
+  printf("# distance, measured ms, model ms\n");
+  for (int i = 0; i < count; i++) {
+    printf("# %u, %u, %u\n", samples[i].distance, samples[i].millis, (unsigned int)model.travelMillis(samples[i].distance));
+  }
+  printf("%c/DYN>%ld,%ld\n", area, (long)(slew + 0.5f), (long)(accel + 0.5f));
+  return 0;
+}
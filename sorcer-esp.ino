@@ -1,7 +1,14 @@
 #include <FastLED.h>
+#include <Preferences.h>
 
+#include "src/LedcPwm.h"
 #include "src/ServoDS3218.h"
 #include "src/MicroServoSG90.h"
+#ifdef PWM_EXPANDER
+#include <Wire.h>
+#include "src/WireBus.h"
+#include "src/Pca9685Pwm.h"
+#endif
 
 #include "src/Actuator.h"
 #include "src/Jaw.h"
@@ -9,6 +16,20 @@
 #include "src/Eye.h"
 #include "src/Eyes.h"
 
+#include "src/Profiler.h"
+#include "src/Trace.h"
+#include "src/Clock.h"
+#include "src/CommandQueue.h"
+#include "src/PowerManager.h"
+#include "src/PresetStore.h"
+#include "src/Transport.h"
+#include "src/Snapshot.h"
+#include "src/IdleBehavior.h"
+#include "src/CueTable.h"
+#include "src/ColorPipeline.h"
+#include "src/ScriptVM.h"
+#include "src/CommandFuzzer.h"
+
 #define LEFT_SERVO_CHANNEL 0
 #define LEFT_SERVO_PIN GPIO_NUM_44
 #define RIGHT_SERVO_CHANNEL 1
@@ -18,6 +39,12 @@
 #define JAW_SERVO_CHANNEL 2
 #define JAW_SERVO_INVERTED 0
 
+// Build with PWM_EXPANDER defined to drive servos from a PCA9685 as well, for
+// heads with more servos than LEDC channels
+#define PWM_EXPANDER_SDA_PIN GPIO_NUM_1
+#define PWM_EXPANDER_SCL_PIN GPIO_NUM_2
+#define PWM_EXPANDER_I2C_HZ 400000
+
 // Pin used for reading button state
 #define BUTTON_READ_PIN GPIO_NUM_7
 // Pin used for enabling button LED & switch
@@ -25,21 +52,102 @@
 // Time offset used for button debouncing
 #define BUTTON_DEBOUNCE_MS 100
 
+// Shared cue trigger input. Wire every head's pin to one show controller
+// output, which pulls it low to fire
+#define CUE_TRIGGER_PIN GPIO_NUM_4
+
 #define LED_DATA_PIN GPIO_NUM_3
+// Build with LED_SPLIT defined for heads with a data pin per segment, which
+// are sent in parallel. Otherwise the segments are chained, in strip order,
+// from LED_DATA_PIN
+#define LED_RIGHT_EYE_PIN LED_DATA_PIN
+#define LED_LEFT_EYE_PIN GPIO_NUM_8
+#define LED_JAW_PIN GPIO_NUM_9
 #define LED_TYPE WS2812B
 #define LED_COLOR_ORDER GRB
 
 // Jaw LEDs start at the end of the eyes
-#define JAW_LED_COUNT 12
+#define JAW_LED_COUNT ((int)HeadTopology::jawLedCount)
 #define JAW_LED_START EYES_LED_COUNT
 
 // Number of LEDs is defined by the total of both eyes and the mouth (TBA)
 #define LED_NUM (EYES_LED_COUNT + JAW_LED_COUNT)
 #define LED_BRIGHTNESS 10
+// Default white balance of each strip, as a FastLED color correction
+#define EYE_LED_CALIBRATION TypicalLEDStrip
+#define JAW_LED_CALIBRATION TypicalLEDStrip
+// Color pipeline segments, in strip order
+#define COLOR_SEGMENT_RIGHT_EYE 0
+#define COLOR_SEGMENT_LEFT_EYE 1
+#define COLOR_SEGMENT_JAW 2
+#define COLOR_SEGMENT_COUNT 3
+// Time between frames sent only to advance the dither, when it's turned on.
+// Sending each blocks the loop for about 1.6 ms, and the 8 phases repeat at
+// 25 Hz, so it's meant for dim, slow scenes
+#define COLOR_REFRESH_MS 5
 
-#define MAX_CMD_SIZE 20
+// Longest command, plus its terminator
+#define MAX_CMD_SIZE 40
+// Longest line received, plus its terminator. A trace load entry carries a
+// full command after "T/LD>", a 10 digit time and a comma
+#define RX_LINE_SIZE (MAX_CMD_SIZE + 16)
 #define CMD_TIMEOUT_US 500
 
+// Single byte that stops all motion as soon as it is read, even mid-command
+#define STOP_BYTE '!'
+// Bytes read ahead of the current command while checking for a stop
+#define RX_PENDING_SIZE 256
+
+// Max number of tagged commands awaiting completion
+#define COMPLETION_SLOTS 16
+// Subsystems a tagged command waits on
+#define COMPLETION_ACTUATOR 0x01
+#define COMPLETION_JAW 0x02
+#define COMPLETION_EYES 0x04
+#define COMPLETION_PRESET 0x08
+// Set on every new entry so completion is only reported from the loop
+#define COMPLETION_QUEUED 0x80
+
+// Scheduled commands due within this window are waited on exactly rather than
+// left to the next loop pass, which can take a few ms with LED updates
+#define SCHEDULE_SPIN_US 2000
+
+// Default time between checks for state snapshot deltas
+#define SNAPSHOT_DEFAULT_PERIOD_MS 20
+// Periods between full snapshots while subscribed, so a host that missed a
+// delta gets back in sync
+#define SNAPSHOT_FULL_PERIODS 50
+
+// Gaze targets accepted beyond the eye range, for hand-off to the actuator
+#define GAZE_MAX 300
+// Actuator tilt and lift per gaze unit past the eye range
+#define GAZE_HANDOFF_TILT_GAIN 5
+#define GAZE_HANDOFF_LIFT_GAIN 2
+
+// Default number of runs per benchmark entry
+#define BENCH_DEFAULT_ITERATIONS 10
+#define BENCH_MAX_ITERATIONS 100
+// Number of frames timed for endless animations
+#define BENCH_RAINBOW_FRAMES 64
+
+// Script PRNG seed for replays on the virtual clock
+#define TRACE_REPLAY_SEED 1
+
+// Inputs run by P/FUZ when not given
+#define FUZZ_DEFAULT_INPUTS 10000
+#define FUZZ_MAX_INPUTS 100000
+// Bytes after each fuzz input checked for writes past the end of it
+#define FUZZ_GUARD_SIZE 16
+#define FUZZ_GUARD_BYTE 0xa5
+// Set in RTC memory while a fuzz input runs, so an input that crashes the
+// device is reported after the reset
+#define FUZZ_RUNNING_MARK 0x46555a5a
+
+// Command families timed separately by P/FUZ. Anything else is "other"
+#define FUZZ_FAMILIES "AJEBRSMQINFLV@#^~"
+// One per family, plus one for the rest, where the terminator would be
+#define FUZZ_FAMILY_COUNT sizeof(FUZZ_FAMILIES)
+
 typedef enum {
   BUTTON_RELEASED,
   BUTTON_CHANGING,
@@ -47,22 +155,52 @@ typedef enum {
 } ButtonState;
 
 typedef struct {
-  uint8_t valid;
-  char cmd;
-  char subcmds[2][5];
-  uint8_t subcmdsSize;
-  char args[3][10];
-  uint8_t argsSize;
-} CommandDesc;
+  uint16_t id;
+  // Subsystems still busy, 0 if slot is unused
+  uint8_t busyMask;
+} PendingCompletion;
+
+// Expression preset, as stored in flash. Eye LEDs are in strip order, so
+// the right eye comes first
+typedef struct {
+  uint8_t eyeLeds[2 * EYE_LED_COUNT][3];
+  uint8_t eyeColors[2][3];
+  uint8_t pupilSizes[2];
+  uint8_t pupilInfills[2];
+  uint8_t jawColor[3];
+  uint16_t jawPos;
+  uint16_t leftArmPos;
+  uint16_t rightArmPos;
+} PresetExpression;
 
-ServoDS3218 leftArmServo(LEFT_SERVO_PIN, LEFT_SERVO_CHANNEL); // move clockwise to extend arm up
-ServoDS3218 rightArmServo(RIGHT_SERVO_PIN, RIGHT_SERVO_CHANNEL); // move counter-clockwise to extend arm up
+// Fuzz input, with guard bytes after it to catch handlers writing past the end
+typedef struct {
+  char input[MAX_CMD_SIZE];
+  uint8_t guard[FUZZ_GUARD_SIZE];
+} FuzzBuffer;
+
+LedcPwm ledcPwm;
+#ifdef PWM_EXPANDER
+WireBus expanderBus(&Wire);
+Pca9685Pwm expanderPwm(&expanderBus);
+#endif
+
+ServoDS3218 leftArmServo(LEFT_SERVO_PIN, LEFT_SERVO_CHANNEL, &ledcPwm); // move clockwise to extend arm up
+ServoDS3218 rightArmServo(RIGHT_SERVO_PIN, RIGHT_SERVO_CHANNEL, &ledcPwm); // move counter-clockwise to extend arm up
 
 Actuator actuator(&leftArmServo, &rightArmServo);
 
-MicroServoSG90 jawServo(JAW_SERVO_PIN, JAW_SERVO_CHANNEL);
+MicroServoSG90 jawServo(JAW_SERVO_PIN, JAW_SERVO_CHANNEL, &ledcPwm);
 
+// Colors as drawn, and as sent to the strip after the color pipeline
 CRGB leds[LED_NUM];
+CRGB ledsOut[LED_NUM];
+ColorPipeline colors(leds, ledsOut, LED_NUM);
+unsigned long lastShowMillis;
+#ifdef LED_SPLIT
+// Output of each segment, indexed like the color pipeline segments
+CLEDController *ledControllers[COLOR_SEGMENT_COUNT];
+#endif
 
 Eye rightEye(leds, 0, CRGB::Green);
 Eye leftEye(leds, EYE_LED_COUNT, CRGB::Green);
@@ -71,119 +209,316 @@ Eyes eyes(&leftEye, &rightEye);
 
 Jaw jaw(&jawServo, leds + JAW_LED_START, JAW_LED_COUNT, CRGB::Green);
 
-char receivedChars[MAX_CMD_SIZE];
-CommandDesc commandDesc;
+char receivedChars[RX_LINE_SIZE];
 
 ButtonState buttonState;
 unsigned long lastButtonTimeMillis;
+// Button enable output, as last written
+uint8_t buttonEnabled;
+
+// Commands come in and responses go out through `transport`, which is the
+// serial port unless pointed elsewhere
+SerialTransport<decltype(Serial)> serialTransport(&Serial);
+Transport *transport = &serialTransport;
+
+// Command throughput through `handleMessage`, per command
+Profiler parserBench("parser");
+// Frame cost of eye drawings and animation steps
+Profiler renderBench("render");
+// Time from first command byte seen to outputs updated, per command type
+Profiler latencyBench("latency");
+
+// One concrete instance of each arm, jaw, eye and button command. Dynamics,
+// frame cache and color pipeline settings, queries, and commands on stored
+// state (cues, scripts, presets, traces) are left out
+const char * const benchCommands[] = {
+  "A/RST", "A/SPD>100", "A/UPP", "A/DWN", "A/MID", "A/UPP>B", "A/DWN>B", "A/MID>B",
+  "A/UNL", "A/TLL", "A/TLL>500,B", "A/TLR", "A/TLR>500,B", "A/BNC", "A/SHK", "A/SHK>1",
+  "A/WPT>500,500,100,20", "A/WPC",
+  "J/SPD>100", "J/OPN", "J/CLS", "J/OPN>B", "J/CLS>B", "J/C>#00ff00",
+  "E/C/GRN", "E/C/RED>L", "E/C/BLU>R", "E/C/YLW", "E/C/PRP", "E/C/ORG", "E/C>#00ff00", "E/C>#00ff00,L",
+  "E/B>10", "E/R", "E/D/OPN", "E/D/CLS>L", "E/D/DIL", "E/D/CTR", "E/D/SQT", "E/D/INF>N", "E/D/INF>Y",
+  "E/D/DIE", "E/D/WDG>90,270", "E/D/LIN>45,L", "E/G>40,-20", "E/G>250,0,T", "E/D/LOK>U", "E/D/LOK>D,L", "E/D/LOK>L", "E/D/LOK>R,R", "E/D/RNB", "E/D/CNF",
+  "E/A/BLK", "E/A/BLK>50", "E/A/WNK>L", "E/A/SPD", "E/A/SPL>20,D,R", "E/A/RNB>10",
+  "B/ENA", "B/DIS", "R"
+};
+#define BENCH_COMMAND_COUNT (int)(sizeof(benchCommands) / sizeof(benchCommands[0]))
+static_assert(BENCH_COMMAND_COUNT <= PROFILER_MAX_PROBES, "parser benchmark has more commands than probes");
+
+// Starting points for P/FUZ inputs, covering every handler it runs
+const char * const fuzzCommands[] = {
+  "A/RST", "A/SPD>100", "A/UPP>B", "A/DWN", "A/MID", "A/UNL", "A/TLL>500,B", "A/TLR", "A/BNC",
+  "A/SHK", "A/SHK>1", "A/WPT>500,500,100,20", "A/WPC", "A/DYN>300,2000", "A/DYN",
+  "J/SPD>100", "J/OPN>B", "J/CLS", "J/C>#00ff00", "J/DYN>300,2000",
+  "E/C/GRN", "E/C/RED>L", "E/C>#00ff00,R", "E/B>10", "E/R", "E/D/OPN>L", "E/D/CLS", "E/D/DIL>R",
+  "E/D/CTR", "E/D/SQT", "E/D/INF>Y", "E/D/DIE", "E/D/LOK>U,R", "E/D/WDG>90,270,L", "E/D/LIN>45",
+  "E/D/RNB>50,L", "E/D/CNF", "E/G>40,-20", "E/G>250,0,T", "E/F>Y", "E/A/BLK>50", "E/A/WNK>L,40",
+  "E/A/SPD>20,D,R", "E/A/SPL", "E/A/RNB>10,L",
+  "L/GAM>220", "L/CAL>E,ffb0f0", "L/DTH>Y", "L/CFG", "B/ENA", "B/DIS", "R",
+  "S/PNG>7", "S/CLR", "M>wave", "Q/GET", "Q/SUB>20", "Q/UNS",
+  "I/ON>5", "I/OFF", "I/BLK>2000,4500", "I/SAC>300,1500,30", "I/SWY>4000,30,20", "I/RES>5000",
+  "N/ID", "N/ID>3", "N/GRP>5", "F/FIR>0", "F/TRG>1", "F/CLR>2", "F/CLR",
+  "V/LOD>0,0100e803", "V/TRG>0,T,100", "V/TRG>1,P", "V/RUN>0", "V/STP>0", "V/CLR>0", "V/STA",
+  "@1000:E/R", "#1:J/OPN", "^0:E/A/BLK", "~*:E/R", "~G1:J/OPN", "~3:E/B>5"
+};
+#define FUZZ_COMMAND_COUNT (sizeof(fuzzCommands) / sizeof(fuzzCommands[0]))
+// Inputs containing these are skipped: benchmarks and fuzzing would recurse,
+// trace commands dump the log, and preset commands write to flash
+const char * const fuzzExcluded[] = {"P/", "T/", "M/"};
+// Probe name for each of `FUZZ_FAMILIES`, then the rest
+const char * const fuzzFamilyNames[FUZZ_FAMILY_COUNT] = {
+  "A", "J", "E", "B", "R", "S", "M", "Q", "I", "N", "F", "L", "V", "@", "#", "^", "~", "other"
+};
+
+// Worst handling time seen per command family, in CPU cycles
+Profiler fuzzBench("fuzz", "cycles");
+CommandFuzzer fuzzer(fuzzCommands, FUZZ_COMMAND_COUNT);
+// Input that took the worst time in each family
+char fuzzWorstInputs[FUZZ_FAMILY_COUNT][MAX_CMD_SIZE];
+// Takes responses to fuzz inputs, so they don't reach the host
+NullTransport fuzzTransport;
+// Input being run, kept through a crash reset
+RTC_NOINIT_ATTR uint32_t fuzzRunningMark;
+RTC_NOINIT_ATTR char fuzzLastInput[MAX_CMD_SIZE];
+
+// Log of received commands for offline reproduction
+Trace trace;
+// Replay state
+uint8_t traceReplaying;
+uint16_t traceReplayCursor;
+uint16_t traceReplayRemaining;
+uint32_t traceReplayFirstMicros;
+unsigned long traceReplayStartMicros;
+// Output capture state. Frames are timestamped relative to the capture start
+uint8_t traceCapturing;
+unsigned long traceCaptureStartMicros;
+uint8_t traceLedsCaptured;
+CRGB traceLastLeds[LED_NUM];
+int traceLastPulseWidths[3];
+
+// Commands waiting for their device time
+CommandQueue scheduledCommands;
+// Time the first byte of the latest message was seen
+unsigned long lastRxMicros;
+
+// Tagged commands waiting on their subsystems to finish
+PendingCompletion pendingCompletions[COMPLETION_SLOTS];
+// Subsystems still homing after a reset
+uint8_t resetBusyMask;
+
+// Named expressions and command sequences kept in flash
+PresetStore presets;
+// Eyes in strip order, matching `PresetExpression`
+Eye * const presetEyes[2] = {&rightEye, &leftEye};
+// Sequence being recorded, if any
+uint8_t presetRecording;
+unsigned long presetRecordStartMillis;
+// Sequence being played, or -1
+int presetPlaySlot = -1;
+uint16_t presetPlayCursor;
+unsigned long presetPlayStartMillis;
+
+// Idle detection and low power waits, woken by the button
+PowerManager power(BUTTON_READ_PIN);
+
+// Blinks, glances and sway generated on the device between cues
+IdleBehavior idle(&eyes, &actuator);
 
+// Identity for addressed commands, kept in NVS across power cycles
+Preferences settings;
+uint8_t deviceId;
+uint16_t deviceGroups;
+
+// Commands armed to run together when fired
+CueTable cues;
+// Set while a cue runs, so a cue can't fire itself
+uint8_t cueFiring;
+// Cue fired by the trigger pin, or -1
+int cueTriggerSlot = -1;
+volatile uint8_t cueTriggered;
+volatile unsigned long cueTriggerMicros;
+
+// Bytecode scripts run on the device, started by the button, animations and
+// timers
+ScriptVM scripts(&eyes, &jaw, &actuator);
+// Set from a button edge that started or woke a script until that script
+// acts, to time the reflex
+uint8_t reflexPending;
+unsigned long reflexStartMicros;
+
+// State snapshot subscription, checked for changes every period. A period
+// of 0 means no subscription
+uint16_t snapshotPeriodMillis;
+unsigned long snapshotLastMillis;
+// Snapshot last sent, which deltas are taken against
+StateSnapshot snapshotLast;
+// Number of the last delta sent, from 0 at the last full snapshot
+uint8_t snapshotSequence;
+uint8_t snapshotPeriodsSinceFull;
+// Set when a delta was dropped on the way out, to send a full snapshot next
+uint8_t snapshotResync;
+
+// Received bytes read ahead by `pollInput`
+char rxPending[RX_PENDING_SIZE];
+uint16_t rxPendingHead;
+uint16_t rxPendingTail;
+// Set while `receiveMessage` is partway through a line
+uint8_t rxReceiving;
+// Lines still to come that arrived before a stop, which are not run
+uint16_t rxDiscardLines;
+
+// Send the LEDs through the color pipeline to the strip
+// Segments that are unchanged aren't sent
+void showLeds () {
+  uint8_t changed = colors.apply();
+  lastShowMillis = millis();
+  if (changed == 0) {
+    return;
+  }
+#ifdef LED_SPLIT
+  // FastLED sends every controller at once, so unchanged segments are given
+  // no LEDs for this frame rather than left out
+  static const uint16_t starts[COLOR_SEGMENT_COUNT] = {0, EYE_LED_COUNT, JAW_LED_START};
+  static const uint16_t counts[COLOR_SEGMENT_COUNT] = {EYE_LED_COUNT, EYE_LED_COUNT, JAW_LED_COUNT};
+  for (uint8_t segment = 0; segment < COLOR_SEGMENT_COUNT; segment++) {
+    ledControllers[segment]->setLeds(ledsOut + starts[segment], (changed & (1 << segment)) ? counts[segment] : 0);
+  }
+#endif
+  FastLED.show();
+}
+
+// Start homing every subsystem at once without waiting on the servos
 void reset () {
+  scripts.stopAll();
   eyes.reset();
-  jaw.reset();
-  FastLED.show();
-  actuator.reset();
+  // The jaw homes at full speed like the actuator, then keeps its set speed
+  uint8_t jawSpeed = jawServo.getSpeed();
+  jawServo.setSpeed(100);
+  jaw.reset(0);
+  jawServo.setSpeed(jawSpeed);
+  showLeds();
+  actuator.reset(0);
 }
 
-uint8_t waitSerial () {
+// Freeze all servos and cancel queued and running motion and animations
+void emergencyStop () {
   unsigned long start = micros();
-  while (!Serial.available()) {
+  Servo::halted = 1;
+  actuator.stop();
+  jawServo.stop();
+  latencyBench.record("stop", micros() - start);
+  eyes.clearAnimation();
+  scheduledCommands.clear();
+  traceReplaying = 0;
+  Clock::setVirtual(0);
+  presetPlaySlot = -1;
+  idle.stop();
+  scripts.stopAll();
+  // Lines sent before the stop, including one partly read, are cancelled too.
+  // They are still acknowledged as they are read, so a host counting lines in
+  // flight stays in step
+  uint8_t partial = rxReceiving;
+  for (uint16_t i = rxPendingTail; i != rxPendingHead; i = (i + 1) % RX_PENDING_SIZE) {
+    if (rxPending[i] == '\n') {
+      rxDiscardLines++;
+      partial = 0;
+    } else {
+      partial = 1;
+    }
+  }
+  rxDiscardLines += partial;
+  transport->print("ACK: !\n");
+}
+
+// Move available received bytes into the pending buffer, acting on stop
+// bytes immediately, and send queued output. Also used as the servo poll
+// hook during blocking moves
+void pollInput () {
+  transport->poll();
+  while (transport->available()) {
+    uint16_t next = (rxPendingHead + 1) % RX_PENDING_SIZE;
+    // Leave the rest in the transport if there is no room
+    if (next == rxPendingTail) {
+      return;
+    }
+    char received = transport->read();
+    if (received == STOP_BYTE) {
+      emergencyStop();
+      continue;
+    }
+    rxPending[rxPendingHead] = received;
+    rxPendingHead = next;
+  }
+}
+
+uint8_t rxAvailable () {
+  pollInput();
+  return rxPendingHead != rxPendingTail;
+}
+
+char rxRead () {
+  char received = rxPending[rxPendingTail];
+  rxPendingTail = (rxPendingTail + 1) % RX_PENDING_SIZE;
+  return received;
+}
+
+uint8_t waitInput () {
+  unsigned long start = micros();
+  while (!rxAvailable()) {
     delayMicroseconds(50);
     if ((micros() - start) > CMD_TIMEOUT_US) return false;
   }
   return true;
 }
 
-uint8_t receiveMessage (char * buffer) {
+// Read a line into a buffer of RX_LINE_SIZE. Past that, the rest of the line
+// is read and discarded, and `overlong` is set, so none of it is run
+uint8_t receiveMessage (char * buffer, uint8_t * overlong) {
   uint8_t index = 0;
   uint8_t status = true;
-  char received = Serial.read();
-  while (received != '\n' && index < (MAX_CMD_SIZE - 1)) {
-    buffer[index++] = received;
-    if (!waitSerial()) {
+  *overlong = 0;
+  rxReceiving = 1;
+  char received = rxRead();
+  while (received != '\n') {
+    if (index < (RX_LINE_SIZE - 1)) {
+      buffer[index++] = received;
+    } else {
+      *overlong = 1;
+    }
+    if (!waitInput()) {
       status = false;
       break;
     }
-    received = Serial.read();
+    received = rxRead();
   }
   buffer[index] = '\0';
+  rxReceiving = 0;
   return status;
 }
 
-void parseCommand (char * command) {
-  // Invalidate previous data
-  commandDesc.valid = 0;
-  commandDesc.subcmdsSize = 0;
-  commandDesc.argsSize = 0;
-  if (command[0] == '\0') {
-    return;
-  }
-  commandDesc.cmd = command[0];
-  commandDesc.valid = 1;
-  if (command[1] != '/') {
-    return;
-  }
-  int index;
-
-  int subcmdIdx = 0;
-  int subcmdCharIdx = 0;
-  // Move index past first '/'
-  for (index = 2; index < MAX_CMD_SIZE && subcmdIdx < 2; index++) {
-    switch (command[index]) {
-      case '\0':
-        break;
-      case '/':
-        // Null terminate last subcmd stored
-        commandDesc.subcmds[subcmdIdx][subcmdCharIdx] = '\0';
-        subcmdIdx++;
-        subcmdCharIdx = 0;
-        continue;
-      case '>':
-        // Arguments starting
-        break;
-      default:
-        commandDesc.subcmds[subcmdIdx][subcmdCharIdx] = command[index];
-        subcmdCharIdx++;
-        // No subcmds are > 3 chars - invalid
-        if (subcmdCharIdx >= 4) {
-          commandDesc.valid = 0;
-          commandDesc.subcmds[subcmdIdx][subcmdCharIdx] = '\0';
-          return;
-        }
-        continue;
+void handleDynamicsCmd (char area, char * args, Servo *first, Servo *second) {
+  // Dynamics model:  [area]/DYN>[slew],[accel]
+  //                  [area]/DYN
+  //                        ^
+  //                args start here
+  int slew, accel;
+  if (sscanf(args, ">%d,%d", &slew, &accel) == 2) {
+    slew = constrain(slew, 1, 100000);
+    accel = constrain(accel, 1, 10000000);
+    first->model.slew = slew;
+    first->model.accel = accel;
+    if (second != NULL) {
+      second->model.slew = slew;
+      second->model.accel = accel;
     }
-    break;
-  }
-  commandDesc.subcmds[subcmdIdx][subcmdCharIdx] = '\0';
-  commandDesc.subcmdsSize = subcmdIdx + 1;
-  if (index >= MAX_CMD_SIZE || command[index] != '>') {
-    return;
-  }
-  // Increment index to move past '>'
-  index++;
-  int argIdx = 0;
-  int argCharIdx = 0;
-  for (; index < MAX_CMD_SIZE && argIdx < 3; index++) {
-    switch (command[index]) {
-      case '\0':
-        break;
-      case ',':
-        commandDesc.args[argIdx][argCharIdx] = '\0';
-        argIdx++;
-        argCharIdx = 0;
-        continue;
-      default:
-        commandDesc.args[argIdx][argCharIdx] = command[index];
-        argCharIdx++;
-        if (argCharIdx >= 9) {
-          commandDesc.valid = 0;
-          commandDesc.args[argIdx][argCharIdx] = '\0';
-        }
-        continue;
-    }
-    break;
+  } else {
+    transport->print(area);
+    transport->print("/DYN>");
+    transport->print((long)first->model.slew);
+    transport->print(",");
+    transport->print((long)first->model.accel);
+    transport->print("\n");
   }
-  commandDesc.args[argIdx][argCharIdx] = '\0';
-  commandDesc.argsSize = argIdx + 1;
 }
 
 void handleActuatorCmd (char * command) {
@@ -229,14 +564,28 @@ void handleActuatorCmd (char * command) {
       actuator.unload(1);
     } else if (strncmp(command, "BNC", 3) == 0) {
       actuator.bounce(1);
-    } else if (strncmp(command, "SHK", 6) == 0) {  // shake can have args, so expand scan size
-      actuator.shake(2);
     } else if (sscanf(command, "SHK>%d", &arg0) == 1) {
       arg0 = constrain(arg0, 0, 20);
       actuator.shake(arg0);
+    } else if (strcmp(command, "SHK") == 0) {
+      actuator.shake(2);
     } else if (sscanf(command, "SPD>%d", &arg0) == 1) {
       uint8_t speed = (uint8_t)constrain(arg0, 0, 100);
       actuator.setSpeed(speed);
+    } else if (strncmp(command, "WPT>", 4) == 0) {
+      int leftPos, rightPos, duration;
+      int blend = 0;
+      if (sscanf(command + 4, "%d,%d,%d,%d", &leftPos, &rightPos, &duration, &blend) >= 3) {
+        duration = constrain(duration, 0, 60000);
+        blend = constrain(blend, 0, 1000);
+        if (!actuator.queueWaypoint(leftPos, rightPos, duration, blend)) {
+          transport->print("A/FULL\n");
+        }
+      }
+    } else if (strncmp(command, "WPC", 3) == 0) {
+      actuator.clearWaypoints();
+    } else if (strncmp(command, "DYN", 3) == 0) {
+      handleDynamicsCmd('A', command + 3, &leftArmServo, &rightArmServo);
     }
   }
 }
@@ -259,6 +608,8 @@ void handleJawCmd (char * command) {
   } else if (sscanf(command, "C>#%6x", &arg0) == 1) {
     arg0 = constrain(arg0, 0, 0xffffff);
     jaw.setColor(arg0);
+  } else if (strncmp(command, "DYN", 3) == 0) {
+    handleDynamicsCmd('J', command + 3, &jawServo, NULL);
   }
 }
 
@@ -320,11 +671,28 @@ void handleEyeColorCmd (char * command) {
   }
 }
 
+// Convert degrees counter-clockwise from the bottom of the eye to the
+// 1/256 turn angles used by `Eye`
+uint8_t degreesToAngle (int degrees) {
+  degrees = ((degrees % 360) + 360) % 360;
+  return (uint8_t)((degrees * 256L) / 360);
+}
+
+void drawEyeWedge (Eye *eye, uint8_t fromAngle, uint8_t toAngle) {
+  eye->clear(1);
+  eye->drawWedge(fromAngle, toAngle, EYE_DOT_RADIUS, EYE_OUTER_RING_RADIUS, eye->currentColor);
+}
+
+void drawEyeLine (Eye *eye, uint8_t angle) {
+  eye->clear(1);
+  eye->drawLine(angle, eye->currentColor);
+}
+
 void handleEyeDrawingCmd (char * command) {
   // Drawing:        E/D/CMD[>[arg]]
   //                    ^
   //           command starts here
-  if (strncmp(command, "/LOK", 3) == 0) {
+  if (strncmp(command, "/LOK", 4) == 0) {
     char direction, side;
     int numScanned = sscanf(command + 4, ">%c,%c", &direction, &side);
     // Must have first arg
@@ -376,6 +744,32 @@ void handleEyeDrawingCmd (char * command) {
         }
       }
     }
+  } else if (strncmp(command, "/WDG", 4) == 0) {
+    int fromDegrees, toDegrees;
+    char side = 'B';
+    // Must have both angles
+    if (sscanf(command + 4, ">%d,%d,%c", &fromDegrees, &toDegrees, &side) >= 2) {
+      uint8_t fromAngle = degreesToAngle(fromDegrees);
+      uint8_t toAngle = degreesToAngle(toDegrees);
+      if (side != 'R') {
+        drawEyeWedge(&leftEye, fromAngle, toAngle);
+      }
+      if (side != 'L') {
+        drawEyeWedge(&rightEye, fromAngle, toAngle);
+      }
+    }
+  } else if (strncmp(command, "/LIN", 4) == 0) {
+    int degrees;
+    char side = 'B';
+    if (sscanf(command + 4, ">%d,%c", &degrees, &side) >= 1) {
+      uint8_t angle = degreesToAngle(degrees);
+      if (side != 'R') {
+        drawEyeLine(&leftEye, angle);
+      }
+      if (side != 'L') {
+        drawEyeLine(&rightEye, angle);
+      }
+    }
   } else {
     char subcmd[3];
     char arg0;
@@ -449,6 +843,28 @@ void handleEyeDrawingCmd (char * command) {
   
 }
 
+void handleEyeGazeCmd (char * command) {
+  // Gaze:           E/G>[x],[y][,T]
+  //                    ^
+  //           command starts here
+  int x, y;
+  char handoff;
+  int numScanned = sscanf(command, ">%d,%d,%c", &x, &y, &handoff);
+  if (numScanned < 2) {
+    return;
+  }
+  x = constrain(x, -GAZE_MAX, GAZE_MAX);
+  y = constrain(y, -GAZE_MAX, GAZE_MAX);
+  eyes.gaze(x, y, 1);
+  if (numScanned == 3 && handoff == 'T') {
+    // Whatever the eyes can't reach is made up by turning the head. Inside the
+    // eye range the head returns to center
+    int excessX = x - constrain(x, -EYE_GAZE_RANGE, EYE_GAZE_RANGE);
+    int excessY = y - constrain(y, -EYE_GAZE_RANGE, EYE_GAZE_RANGE);
+    actuator.pose(excessY * GAZE_HANDOFF_LIFT_GAIN, excessX * GAZE_HANDOFF_TILT_GAIN);
+  }
+}
+
 void handleEyeCmd (char * command) {
   // Eye commands take the forms:
   // Color setting:  E/C/CMD[>[L or R]]
@@ -456,6 +872,8 @@ void handleEyeCmd (char * command) {
   // Brightness:     E/B>[num]
   // Reset:          E/R
   // Drawing:        E/D/CMD[>[arg]]
+  // Gaze:           E/G>[x],[y][,T]
+  // Frame cache:    E/F>[Y or N]
   // Animation:      E/A/CMD[>[L/R]]
   //                   ^
   //          command starts here
@@ -468,7 +886,7 @@ void handleEyeCmd (char * command) {
     case 'B':
       if (sscanf(command + 1, ">%d", &arg0) == 1) {
         arg0 = constrain(arg0, 0, 255);
-        FastLED.setBrightness(arg0);
+        colors.setBrightness(arg0);
       }
       break;
     case 'R':
@@ -477,12 +895,22 @@ void handleEyeCmd (char * command) {
     case 'D':
       handleEyeDrawingCmd(command + 1);
       break;
+    case 'G':
+      handleEyeGazeCmd(command + 1);
+      break;
+    case 'F':
+      if (command[1] == '>') {
+        Eye::frameCacheEnabled = (command[2] == 'Y');
+      }
+      break;
     case 'A':
       // Check delimiter
       if (command[1] != '/') {
         return;
       }
-      char side, direction;
+      // Both eyes and upward unless given
+      char side = 'B';
+      char direction = 'U';
       if (strncmp(command + 2, "BLK", 3) == 0) {
         int numScanned = sscanf(command + 5, ">%d", &arg0);
         if (numScanned > 0) {
@@ -562,18 +990,1278 @@ void handleButtonCmd (char * command) {
   //                         command starts here
   if (strncmp(command, "ENA", 3) == 0) {
     digitalWrite(BUTTON_EN_PIN, HIGH);
+    buttonEnabled = 1;
   } else if (strncmp(command, "DIS", 3) == 0) {
     digitalWrite(BUTTON_EN_PIN, LOW);
+    buttonEnabled = 0;
+  }
+}
+
+void handleMessage (char * buffer);
+void wakeFromIdle ();
+char * matchAddress (char * buffer);
+
+void benchParser (int iterations) {
+  char buffer[MAX_CMD_SIZE];
+  parserBench.clear();
+  for (int i = 0; i < BENCH_COMMAND_COUNT; i++) {
+    int probeIdx = parserBench.probe(benchCommands[i]);
+    for (int j = 0; j < iterations; j++) {
+      // Handlers receive a mutable buffer, so copy each run
+      strncpy(buffer, benchCommands[i], MAX_CMD_SIZE - 1);
+      buffer[MAX_CMD_SIZE - 1] = '\0';
+      unsigned long start = micros();
+      handleMessage(buffer);
+      parserBench.record(probeIdx, micros() - start);
+    }
+  }
+  reset();
+  // Resets run by the benchmark aren't reported
+  resetBusyMask = 0;
+}
+
+void benchRender (int iterations) {
+  // Drawings are timed on a single eye, which is identical in cost to the other
+  Eye *eye = &rightEye;
+  renderBench.clear();
+  for (int j = 0; j < iterations; j++) {
+    unsigned long start = micros();
+    eye->open();
+    renderBench.record("open", micros() - start);
+    start = micros();
+    eye->close();
+    renderBench.record("close", micros() - start);
+    start = micros();
+    eye->squint();
+    renderBench.record("squint", micros() - start);
+    start = micros();
+    eye->dilate();
+    renderBench.record("dilate", micros() - start);
+    start = micros();
+    eye->lookLeft();
+    renderBench.record("lookLeft", micros() - start);
+    start = micros();
+    eye->lookRight();
+    renderBench.record("lookRight", micros() - start);
+    start = micros();
+    eye->lookUp();
+    renderBench.record("lookUp", micros() - start);
+    start = micros();
+    eye->lookDown();
+    renderBench.record("lookDown", micros() - start);
+    start = micros();
+    eye->contract();
+    renderBench.record("contract", micros() - start);
+    start = micros();
+    eye->dead();
+    renderBench.record("dead", micros() - start);
+
+    // Animations are stepped directly rather than waiting on their frame
+    // delays. These render live; baked playback is timed below
+    uint8_t cacheEnabled = Eye::frameCacheEnabled;
+    Eye::frameCacheEnabled = 0;
+    eye->blink();
+    for (int k = 0; k < 5; k++) {
+      start = micros();
+      eye->handleBlinkUpdate();
+      renderBench.record("blinkFrame", micros() - start);
+    }
+    eye->spiral(EYE_SPIRAL_STEP_DELAY_MS, 1, 1);
+    for (int k = 0; k <= EYE_LED_COUNT; k++) {
+      start = micros();
+      eye->handleSpiralUpdate(1);
+      renderBench.record("spiralDotFrame", micros() - start);
+    }
+    eye->spiral(EYE_SPIRAL_STEP_DELAY_MS, 1, 0);
+    for (int k = 0; k <= EYE_LED_COUNT; k++) {
+      start = micros();
+      eye->handleSpiralUpdate(0);
+      renderBench.record("spiralLineFrame", micros() - start);
+    }
+    eye->rainbow();
+    for (int k = 0; k < BENCH_RAINBOW_FRAMES; k++) {
+      start = micros();
+      eye->handleRainbowUpdate();
+      renderBench.record("rainbowFrame", micros() - start);
+    }
+
+    // Baking happens as each animation starts. The rainbow table is only
+    // filled the first time, so later runs time just the lookup setup
+    Eye::frameCacheEnabled = 1;
+    start = micros();
+    eye->blink();
+    renderBench.record("blinkBake", micros() - start);
+    for (int k = 0; k < 5; k++) {
+      start = micros();
+      eye->stepAnimation();
+      renderBench.record("blinkBakedFrame", micros() - start);
+    }
+    start = micros();
+    eye->spiral(EYE_SPIRAL_STEP_DELAY_MS, 1, 1);
+    renderBench.record("spiralBake", micros() - start);
+    for (int k = 0; k <= EYE_LED_COUNT; k++) {
+      start = micros();
+      eye->stepAnimation();
+      renderBench.record("spiralBakedFrame", micros() - start);
+    }
+    start = micros();
+    eye->rainbow();
+    renderBench.record("rainbowBake", micros() - start);
+    for (int k = 0; k < BENCH_RAINBOW_FRAMES; k++) {
+      start = micros();
+      eye->stepAnimation();
+      renderBench.record("rainbowBakedFrame", micros() - start);
+    }
+    Eye::frameCacheEnabled = cacheEnabled;
+    eye->clearAnimation();
+
+    start = micros();
+    colors.apply();
+    renderBench.record("colorApply", micros() - start);
+    // Every segment, as after a full redraw
+    colors.invalidate();
+    start = micros();
+    showLeds();
+    renderBench.record("show", micros() - start);
+    // Frames sent only to advance the dither, as the loop does while nothing
+    // is redrawn. These cost nothing when no LED is between levels
+    uint8_t ditherEnabled = colors.getDither();
+    colors.setDither(1);
+    for (int k = 0; k < COLOR_DITHER_PHASES; k++) {
+      start = micros();
+      showLeds();
+      renderBench.record("ditherRefresh", micros() - start);
+    }
+    colors.setDither(ditherEnabled);
+  }
+  eye->reset();
+  showLeds();
+}
+
+void handlePowerCmd (char * args) {
+  // Power config:  P/PWR>[ms][,[flags]]
+  //                P/PWR
+  //                     ^
+  //             args start here
+  long idleMillis;
+  char flagChars[4] = "";
+  int numScanned = sscanf(args, ">%ld,%3[AJS]", &idleMillis, flagChars);
+  if (numScanned >= 1) {
+    power.idleMillis = constrain(idleMillis, 0, 3600000L);
+    if (numScanned == 2) {
+      power.flags = ((strchr(flagChars, 'A') ? POWER_RELEASE_ACTUATOR : 0)
+        | (strchr(flagChars, 'J') ? POWER_RELEASE_JAW : 0)
+        | (strchr(flagChars, 'S') ? POWER_LIGHT_SLEEP : 0));
+    }
+  } else {
+    transport->print("P/PWR>");
+    transport->print(power.idleMillis);
+    transport->print(",");
+    if (power.flags & POWER_RELEASE_ACTUATOR) {
+      transport->print("A");
+    }
+    if (power.flags & POWER_RELEASE_JAW) {
+      transport->print("J");
+    }
+    if (power.flags & POWER_LIGHT_SLEEP) {
+      transport->print("S");
+    }
+    transport->print("\n");
+  }
+}
+
+void handleIdleCmd (char * command) {
+  // Idle commands take the form:  I/ON[>[seed]]
+  //                               I/OFF
+  //                               I/BLK>[min ms],[mean ms]
+  //                               I/SAC>[min ms],[mean ms][,[range]]
+  //                               I/SWY>[period ms],[lift],[tilt]
+  //                               I/RES>[ms]
+  //                                 ^
+  //                        command starts here
+  unsigned long arg0;
+  int arg1, arg2;
+  int numScanned = sscanf(command + 3, ">%lu,%d,%d", &arg0, &arg1, &arg2);
+  if (strncmp(command, "ON", 2) == 0) {
+    // Seed given after the shorter name
+    idle.start((sscanf(command + 2, ">%lu", &arg0) == 1) ? arg0 : 0);
+  } else if (strncmp(command, "OFF", 3) == 0) {
+    idle.stop();
+  } else if (strncmp(command, "BLK", 3) == 0 && numScanned >= 2) {
+    idle.blinkInterval.minMillis = constrain(arg0, 0, 60000);
+    idle.blinkInterval.meanMillis = constrain(arg1, 0, 60000);
+  } else if (strncmp(command, "SAC", 3) == 0 && numScanned >= 2) {
+    idle.saccadeInterval.minMillis = constrain(arg0, 0, 60000);
+    idle.saccadeInterval.meanMillis = constrain(arg1, 0, 60000);
+    if (numScanned == 3) {
+      idle.saccadeRange = constrain(arg2, 0, EYE_GAZE_RANGE);
+    }
+  } else if (strncmp(command, "SWY", 3) == 0 && numScanned == 3) {
+    idle.swayPeriodMillis = constrain(arg0, 0, 60000);
+    idle.swayLift = constrain(arg1, 0, 500);
+    idle.swayTilt = constrain(arg2, 0, 500);
+  } else if (strncmp(command, "RES", 3) == 0 && numScanned >= 1) {
+    idle.resumeMillis = constrain(arg0, 0, 3600000UL);
   }
 }
 
+// Print an input with anything unprintable escaped, so it stays on one line
+void printEscaped (const char *text) {
+  for (; *text != '\0'; text++) {
+    if (isprint((uint8_t)*text) && *text != '\\') {
+      transport->print(*text);
+    } else {
+      transport->printf("\\x%02x", (uint8_t)*text);
+    }
+  }
+}
+
+// Run one fuzz input the way the main loop runs a message, returning the
+// cycles it took
+uint32_t runFuzzInput (char * input) {
+  uint32_t start = ESP.getCycleCount();
+  char *message = ((input[0] == '~') ? matchAddress(input + 1) : input);
+  if (message != NULL) {
+    handleMessage(message);
+  }
+  return ESP.getCycleCount() - start;
+}
+
+// Run generated inputs through the command handlers, timing the worst case
+// of each command family and checking for writes past the input. Commands
+// run for real, but with the servos halted, flash settings read-only and
+// responses discarded. Settings they change are put back, cues, scripts,
+// scheduled commands and idle behaviour are cleared after, and the head is
+// reset
+void runFuzz (uint32_t inputs, uint32_t seed) {
+  static FuzzBuffer buffer;
+  char guardInput[MAX_CMD_SIZE] = "";
+  uint32_t guardHits = 0;
+  uint32_t skipped = 0;
+  // Settings kept in flash are put back as they were in RAM
+  uint8_t savedId = deviceId;
+  uint16_t savedGroups = deviceGroups;
+  uint16_t savedGamma = colors.getGamma();
+  CRGB savedEyeCalibration = colors.getCalibration(COLOR_SEGMENT_RIGHT_EYE);
+  CRGB savedJawCalibration = colors.getCalibration(COLOR_SEGMENT_JAW);
+  uint8_t savedBrightness = colors.getBrightness();
+  uint8_t savedDither = colors.getDither();
+  uint8_t savedButtonEnabled = buttonEnabled;
+  Transport *savedTransport = transport;
+  // Runtime settings that reset doesn't touch are put back too
+  uint8_t savedJawSpeed = jawServo.getSpeed();
+  CRGB savedJawColor = jaw.currentColor;
+  float savedArmSlew = leftArmServo.model.slew;
+  float savedArmAccel = leftArmServo.model.accel;
+  float savedJawSlew = jawServo.model.slew;
+  float savedJawAccel = jawServo.model.accel;
+  uint8_t savedFrameCache = Eye::frameCacheEnabled;
+  IdleInterval savedBlinkInterval = idle.blinkInterval;
+  IdleInterval savedSaccadeInterval = idle.saccadeInterval;
+  uint8_t savedSaccadeRange = idle.saccadeRange;
+  uint16_t savedSwayPeriod = idle.swayPeriodMillis;
+  uint16_t savedSwayLift = idle.swayLift;
+  uint16_t savedSwayTilt = idle.swayTilt;
+  uint32_t savedResumeMillis = idle.resumeMillis;
+
+  Servo::halted = 1;
+  settings.end();
+  settings.begin("sorcer", true);
+  transport = &fuzzTransport;
+  // Cues armed before the run can't be fired by it
+  cues.clearAll();
+  fuzzBench.clear();
+  fuzzer.seed(seed);
+  for (uint32_t i = 0; i < inputs; i++) {
+    fuzzer.next(buffer.input, MAX_CMD_SIZE);
+    uint8_t excluded = 0;
+    for (uint8_t j = 0; j < sizeof(fuzzExcluded) / sizeof(fuzzExcluded[0]); j++) {
+      excluded |= (strstr(buffer.input, fuzzExcluded[j]) != NULL);
+    }
+    if (excluded) {
+      skipped++;
+      continue;
+    }
+    memset(buffer.guard, FUZZ_GUARD_BYTE, FUZZ_GUARD_SIZE);
+    memcpy(fuzzLastInput, buffer.input, MAX_CMD_SIZE);
+    fuzzRunningMark = FUZZ_RUNNING_MARK;
+    uint32_t cycles = runFuzzInput(buffer.input);
+    fuzzRunningMark = 0;
+
+    const char *family = strchr(FUZZ_FAMILIES, fuzzLastInput[0]);
+    int familyIdx = ((family != NULL && fuzzLastInput[0] != '\0') ? family - FUZZ_FAMILIES : FUZZ_FAMILY_COUNT - 1);
+    int probeIdx = fuzzBench.probe(fuzzFamilyNames[familyIdx]);
+    if (fuzzBench.get(probeIdx)->count == 0 || cycles > fuzzBench.get(probeIdx)->max) {
+      memcpy(fuzzWorstInputs[familyIdx], fuzzLastInput, MAX_CMD_SIZE);
+    }
+    fuzzBench.record(probeIdx, cycles);
+    for (uint8_t j = 0; j < FUZZ_GUARD_SIZE; j++) {
+      if (buffer.guard[j] != FUZZ_GUARD_BYTE) {
+        if (guardHits++ == 0) {
+          memcpy(guardInput, fuzzLastInput, MAX_CMD_SIZE);
+        }
+        break;
+      }
+    }
+    // Let other tasks run now and then through a long run
+    if (i % 256 == 255) {
+      yield();
+    }
+  }
+
+  transport = savedTransport;
+  settings.end();
+  settings.begin("sorcer");
+  Servo::halted = 0;
+  deviceId = savedId;
+  deviceGroups = savedGroups;
+  colors.setGamma(savedGamma);
+  colors.setCalibration(COLOR_SEGMENT_RIGHT_EYE, savedEyeCalibration);
+  colors.setCalibration(COLOR_SEGMENT_LEFT_EYE, savedEyeCalibration);
+  colors.setCalibration(COLOR_SEGMENT_JAW, savedJawCalibration);
+  colors.setBrightness(savedBrightness);
+  colors.setDither(savedDither);
+  buttonEnabled = savedButtonEnabled;
+  digitalWrite(BUTTON_EN_PIN, buttonEnabled ? HIGH : LOW);
+  jawServo.setSpeed(savedJawSpeed);
+  jaw.setColor(savedJawColor);
+  leftArmServo.model.slew = savedArmSlew;
+  leftArmServo.model.accel = savedArmAccel;
+  rightArmServo.model.slew = savedArmSlew;
+  rightArmServo.model.accel = savedArmAccel;
+  jawServo.model.slew = savedJawSlew;
+  jawServo.model.accel = savedJawAccel;
+  Eye::frameCacheEnabled = savedFrameCache;
+  idle.blinkInterval = savedBlinkInterval;
+  idle.saccadeInterval = savedSaccadeInterval;
+  idle.saccadeRange = savedSaccadeRange;
+  idle.swayPeriodMillis = savedSwayPeriod;
+  idle.swayLift = savedSwayLift;
+  idle.swayTilt = savedSwayTilt;
+  idle.resumeMillis = savedResumeMillis;
+  cues.clearAll();
+  cueTriggerSlot = -1;
+  for (uint8_t slot = 0; slot < SCRIPT_SLOTS; slot++) {
+    scripts.clear(slot);
+  }
+  scheduledCommands.clear();
+  memset(pendingCompletions, 0, sizeof(pendingCompletions));
+  presetPlaySlot = -1;
+  snapshotPeriodMillis = 0;
+  idle.stop();
+  actuator.clearWaypoints();
+  eyes.clearAnimation();
+  reset();
+  // Resets run by fuzzed inputs aren't reported
+  resetBusyMask = 0;
+
+  // Summary: P/FUZ>[inputs run],[skipped],[guard hits],[CPU MHz], then the
+  // cycles per family and the worst input of each
+  transport->print("P/FUZ>");
+  transport->print(inputs - skipped);
+  transport->print(",");
+  transport->print(skipped);
+  transport->print(",");
+  transport->print(guardHits);
+  transport->print(",");
+  transport->print(ESP.getCpuFreqMHz());
+  transport->print("\n");
+  fuzzBench.printJson(transport);
+  for (uint8_t i = 0; i < fuzzBench.size(); i++) {
+    const ProfilerProbe *probe = fuzzBench.get(i);
+    int familyIdx = 0;
+    while (fuzzFamilyNames[familyIdx] != probe->name) {
+      familyIdx++;
+    }
+    transport->print("P/FUZ>WORST,");
+    transport->print(probe->name);
+    transport->print(",");
+    transport->print(probe->max);
+    transport->print(",");
+    printEscaped(fuzzWorstInputs[familyIdx]);
+    transport->print("\n");
+  }
+  if (guardHits > 0) {
+    transport->print("P/FUZ>GUARD,");
+    printEscaped(guardInput);
+    transport->print("\n");
+  }
+}
+
+void handlePerfCmd (char * command) {
+  // Performance commands take the form:  P/BEN[>[num]]
+  //                                      P/LAT
+  //                                      P/CLR
+  //                                      P/PWR[>[ms][,[flags]]]
+  //                                      P/FUZ[>[inputs][,[seed]]]
+  //                                        ^
+  //                               command starts here
+  if (strncmp(command, "BEN", 3) == 0) {
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    if (sscanf(command + 3, ">%d", &iterations) == 1) {
+      iterations = constrain(iterations, 1, BENCH_MAX_ITERATIONS);
+    }
+    benchParser(iterations);
+    parserBench.printJson(transport);
+    benchRender(iterations);
+    renderBench.printJson(transport);
+    latencyBench.printJson(transport);
+  } else if (strncmp(command, "LAT", 3) == 0) {
+    latencyBench.printJson(transport);
+  } else if (strncmp(command, "CLR", 3) == 0) {
+    latencyBench.clear();
+  } else if (strncmp(command, "PWR", 3) == 0) {
+    handlePowerCmd(command + 3);
+  } else if (strncmp(command, "FUZ", 3) == 0) {
+    unsigned long inputs = FUZZ_DEFAULT_INPUTS;
+    unsigned long seed = 0;
+    sscanf(command + 3, ">%lu,%lu", &inputs, &seed);
+    runFuzz(constrain(inputs, 1, FUZZ_MAX_INPUTS), seed);
+  }
+}
+
+void startTraceCapture () {
+  traceCapturing = 1;
+  traceCaptureStartMicros = Clock::nowMicros();
+  // Force the first frame and pulse widths out
+  traceLedsCaptured = 0;
+  traceLastPulseWidths[0] = -1;
+}
+
+// Replay the log from the start. On the virtual clock, every pass of the loop
+// moves time on by `CLOCK_STEP_MICROS`, so a trace always replays the same way.
+// Otherwise commands keep their recorded spacing in real time
+void startTraceReplay (uint8_t virtualClock) {
+  if (trace.count() == 0) {
+    transport->print("T/DONE\n");
+    return;
+  }
+  char command[MAX_CMD_SIZE];
+  if (virtualClock) {
+    Clock::setVirtual(1);
+    // Random waits and branches in scripts come out the same each time
+    scripts.seed(TRACE_REPLAY_SEED);
+  }
+  traceReplayCursor = trace.first();
+  trace.read(traceReplayCursor, &traceReplayFirstMicros, command, MAX_CMD_SIZE);
+  traceReplayRemaining = trace.count();
+  traceReplayStartMicros = Clock::nowMicros();
+  traceReplaying = 1;
+  startTraceCapture();
+}
+
+void stopTraceReplay () {
+  traceReplaying = 0;
+  Clock::setVirtual(0);
+}
+
+// Dispatch any replayed commands that are due, keeping their recorded spacing
+void handleTraceReplay () {
+  char command[MAX_CMD_SIZE];
+  uint32_t timeMicros;
+  Clock::step();
+  while (traceReplaying) {
+    if (traceReplayRemaining == 0) {
+      stopTraceReplay();
+      transport->print("T/DONE\n");
+      return;
+    }
+    uint16_t nextCursor = trace.read(traceReplayCursor, &timeMicros, command, MAX_CMD_SIZE);
+    if ((Clock::nowMicros() - traceReplayStartMicros) < (timeMicros - traceReplayFirstMicros)) {
+      return;
+    }
+    traceReplayCursor = nextCursor;
+    traceReplayRemaining--;
+    wakeFromIdle();
+    handleMessage(command);
+  }
+}
+
+// Print LED frame and servo pulse widths whenever either changes
+void handleTraceCapture () {
+  if (!traceCapturing) {
+    return;
+  }
+  unsigned long elapsed = Clock::nowMicros() - traceCaptureStartMicros;
+  if (!traceLedsCaptured || memcmp(traceLastLeds, leds, sizeof(leds)) != 0) {
+    memcpy(traceLastLeds, leds, sizeof(leds));
+    traceLedsCaptured = 1;
+    char hex[7];
+    transport->print("T/F>");
+    transport->print(elapsed);
+    transport->print(",");
+    for (int i = 0; i < LED_NUM; i++) {
+      sprintf(hex, "%02x%02x%02x", leds[i].r, leds[i].g, leds[i].b);
+      transport->print(hex);
+    }
+    transport->print("\n");
+  }
+  int pulseWidths[3] = {
+    leftArmServo.getPulseWidth(),
+    rightArmServo.getPulseWidth(),
+    jawServo.getPulseWidth()
+  };
+  if (memcmp(traceLastPulseWidths, pulseWidths, sizeof(pulseWidths)) != 0) {
+    memcpy(traceLastPulseWidths, pulseWidths, sizeof(pulseWidths));
+    transport->print("T/S>");
+    transport->print(elapsed);
+    for (int i = 0; i < 3; i++) {
+      transport->print(",");
+      transport->print(pulseWidths[i]);
+    }
+    transport->print("\n");
+  }
+  // Virtual time waits for the link, so no frame is lost to a full buffer
+  if (Clock::isVirtual()) {
+    transport->flush();
+  }
+}
+
+void handleTraceCmd (char * command) {
+  // Trace commands take the form:  T/REC>[Y or N]
+  //                                T/CAP>[Y or N]
+  //                                T/CLR
+  //                                T/DMP
+  //                                T/LD>[time],[command]
+  //                                T/PLY[>R]
+  //                                  ^
+  //                         command starts here
+  if (strncmp(command, "REC>", 4) == 0) {
+    trace.enabled = (command[4] == 'Y');
+  } else if (strncmp(command, "CAP>", 4) == 0) {
+    if (command[4] == 'Y') {
+      startTraceCapture();
+    } else {
+      traceCapturing = 0;
+    }
+  } else if (strncmp(command, "CLR", 3) == 0) {
+    // The log can't change under a replay
+    if (!traceReplaying) {
+      trace.clear();
+    }
+  } else if (strncmp(command, "DMP", 3) == 0) {
+    char entry[MAX_CMD_SIZE];
+    uint32_t timeMicros;
+    uint16_t cursor = trace.first();
+    uint16_t count = trace.count();
+    transport->print("T/N>");
+    transport->print(count);
+    transport->print("\n");
+    for (uint16_t i = 0; i < count; i++) {
+      cursor = trace.read(cursor, &timeMicros, entry, MAX_CMD_SIZE);
+      transport->print("T/E>");
+      transport->print(timeMicros);
+      transport->print(",");
+      transport->print(entry);
+      transport->print("\n");
+    }
+    transport->print("T/END\n");
+  } else if (strncmp(command, "LD>", 3) == 0) {
+    char *separator = strchr(command + 3, ',');
+    if (separator != NULL && !traceReplaying && strlen(separator + 1) < MAX_CMD_SIZE) {
+      uint32_t timeMicros = strtoul(command + 3, NULL, 10);
+      trace.record(timeMicros, separator + 1);
+    }
+  } else if (strncmp(command, "PLY", 3) == 0) {
+    startTraceReplay(command[3] != '>' || command[4] != 'R');
+  }
+}
+
+// Strip an address of the form [target]: from a command, where the target is
+// a device ID, G[group] or * for every head. Returns the command if it is
+// addressed to this head, otherwise NULL. IDs and groups must be all digits
+char * matchAddress (char * buffer) {
+  char *separator = strchr(buffer, ':');
+  if (separator == NULL) {
+    return NULL;
+  }
+  uint8_t matched;
+  char *end;
+  if (buffer[0] == '*') {
+    matched = (separator == buffer + 1);
+  } else if (buffer[0] == 'G') {
+    long group = strtol(buffer + 1, &end, 10);
+    matched = (isdigit((uint8_t)buffer[1]) && end == separator && group < 16 && (deviceGroups & (1 << group)));
+  } else {
+    long id = strtol(buffer, &end, 10);
+    matched = (isdigit((uint8_t)buffer[0]) && end == separator && id == deviceId);
+  }
+  return matched ? separator + 1 : NULL;
+}
+
+void handleIdentityCmd (char * command) {
+  // Identity commands take the form:  N/ID>[id]
+  //                                   N/GRP>[mask]
+  //                                   N/ID
+  //                                     ^
+  //                            command starts here
+  int arg0;
+  if (sscanf(command, "ID>%d", &arg0) == 1) {
+    deviceId = constrain(arg0, 0, 254);
+    settings.putUChar("id", deviceId);
+  } else if (sscanf(command, "GRP>%d", &arg0) == 1) {
+    deviceGroups = constrain(arg0, 0, 0xffff);
+    settings.putUShort("groups", deviceGroups);
+  } else if (strncmp(command, "ID", 2) == 0) {
+    transport->print("N/ID>");
+    transport->print(deviceId);
+    transport->print(",");
+    transport->print(deviceGroups);
+    transport->print("\n");
+  }
+}
+
+// Arm a command of the form [slot]:[command], adding it to that cue
+void armCue (char * buffer) {
+  char *separator;
+  unsigned long slot = strtoul(buffer, &separator, 10);
+  if (separator == buffer || *separator != ':' || slot >= CUE_SLOTS) {
+    return;
+  }
+  if (!cues.arm(slot, separator + 1)) {
+    transport->print("F/FULL\n");
+  }
+}
+
+void fireCue (int slot) {
+  if (cueFiring) {
+    return;
+  }
+  char command[MAX_CMD_SIZE];
+  uint16_t cursor = 0;
+  const char *armed;
+  cueFiring = 1;
+  wakeFromIdle();
+  while ((armed = cues.next(slot, &cursor)) != NULL) {
+    strncpy(command, armed, MAX_CMD_SIZE - 1);
+    command[MAX_CMD_SIZE - 1] = '\0';
+    handleMessage(command);
+  }
+  cueFiring = 0;
+}
+
+void IRAM_ATTR onCueTrigger () {
+  if (!cueTriggered) {
+    cueTriggerMicros = micros();
+    cueTriggered = 1;
+  }
+}
+
+// Fire the cue waiting on the trigger pin, once it has been pulled low
+void handleCueTrigger () {
+  if (!cueTriggered) {
+    return;
+  }
+  cueTriggered = 0;
+  if (cueTriggerSlot < 0) {
+    return;
+  }
+  // One shot, so noise on the line can't fire it twice
+  int slot = cueTriggerSlot;
+  cueTriggerSlot = -1;
+  fireCue(slot);
+  showLeds();
+  latencyBench.record("cue", micros() - cueTriggerMicros);
+}
+
+void handleCueCmd (char * command) {
+  // Cue commands take the form:  F/FIR>[slot]
+  //                              F/TRG>[slot]
+  //                              F/CLR[>[slot]]
+  //                                ^
+  //                       command starts here
+  int slot;
+  uint8_t hasSlot = (sscanf(command + 3, ">%d", &slot) == 1) && slot >= 0 && slot < CUE_SLOTS;
+  if (strncmp(command, "FIR", 3) == 0 && hasSlot) {
+    fireCue(slot);
+  } else if (strncmp(command, "TRG", 3) == 0 && hasSlot) {
+    cueTriggered = 0;
+    cueTriggerSlot = slot;
+  } else if (strncmp(command, "CLR", 3) == 0) {
+    if (hasSlot) {
+      cues.clear(slot);
+    } else {
+      cues.clearAll();
+      cueTriggerSlot = -1;
+    }
+  }
+}
+
+// Send a script's EMIT value to the host
+void emitScriptValue (uint8_t slot, uint8_t value) {
+  transport->print("V/EMT>");
+  transport->print(slot);
+  transport->print(",");
+  transport->print(value);
+  transport->print("\n");
+}
+
+void printScriptError (int slot, int offset) {
+  transport->print("V/ERR>");
+  transport->print(slot);
+  transport->print(",");
+  transport->print(offset);
+  transport->print("\n");
+}
+
+void handleScriptCmd (char * command) {
+  // Script commands take the form:  V/LOD>[slot],[hex bytecode]
+  //                                 V/TRG>[slot],[P|R|A|T|N][,[period ms]]
+  //                                 V/RUN>[slot]
+  //                                 V/STP[>[slot]]
+  //                                 V/CLR>[slot]
+  //                                 V/STA
+  //                                   ^
+  //                          command starts here
+  int slot;
+  int consumed = 0;
+  uint8_t hasSlot = (sscanf(command + 3, ">%d%n", &slot, &consumed) == 1) && slot >= 0 && slot < SCRIPT_SLOTS;
+  char *args = command + 3 + consumed;
+  if (strncmp(command, "LOD", 3) == 0 && hasSlot && args[0] == ',') {
+    uint8_t code[MAX_CMD_SIZE / 2];
+    uint8_t length = 0;
+    // Whole hex bytes only, so a chunk is either loaded or rejected
+    for (char *hex = args + 1; hex[0] != '\0'; hex += 2) {
+      if (!isxdigit(hex[0]) || !isxdigit(hex[1])) {
+        return;
+      }
+      char pair[3] = {hex[0], hex[1], '\0'};
+      code[length++] = strtoul(pair, NULL, 16);
+    }
+    if (!scripts.load(slot, code, length)) {
+      transport->print("V/FULL\n");
+    }
+  } else if (strncmp(command, "TRG", 3) == 0 && hasSlot && args[0] == ',') {
+    unsigned long periodMillis = 0;
+    ScriptEvent trigger;
+    switch (args[1]) {
+      case 'P':
+        trigger = SCRIPT_EVENT_PRESS;
+        break;
+      case 'R':
+        trigger = SCRIPT_EVENT_RELEASE;
+        break;
+      case 'A':
+        trigger = SCRIPT_EVENT_ANIMATION;
+        break;
+      case 'T':
+        // Timers need a period
+        if (sscanf(args + 2, ",%lu", &periodMillis) != 1 || periodMillis == 0) {
+          return;
+        }
+        trigger = SCRIPT_EVENT_TIMER;
+        break;
+      case 'N':
+        trigger = SCRIPT_EVENT_NONE;
+        break;
+      default:
+        return;
+    }
+    int error = scripts.bind(slot, trigger, constrain(periodMillis, 0, 60000));
+    if (error >= 0) {
+      printScriptError(slot, error);
+    }
+  } else if (strncmp(command, "RUN", 3) == 0 && hasSlot) {
+    int error = scripts.start(slot);
+    if (error >= 0) {
+      printScriptError(slot, error);
+    }
+  } else if (strncmp(command, "STP", 3) == 0) {
+    if (hasSlot) {
+      scripts.stop(slot);
+    } else {
+      scripts.stopAll();
+    }
+  } else if (strncmp(command, "CLR", 3) == 0 && hasSlot) {
+    scripts.clear(slot);
+  } else if (strncmp(command, "STA", 3) == 0) {
+    // One line per script: V/STA>[slot],[length],[trigger],[state],[pc]
+    for (slot = 0; slot < SCRIPT_SLOTS; slot++) {
+      const Script *script = scripts.getScript(slot);
+      transport->print("V/STA>");
+      transport->print(slot);
+      transport->print(",");
+      transport->print(script->length);
+      transport->print(",");
+      transport->print(script->trigger);
+      transport->print(",");
+      transport->print(script->state);
+      transport->print(",");
+      transport->print(script->pc);
+      transport->print("\n");
+    }
+  }
+}
+
+void printColor (CRGB color) {
+  char hex[7];
+  sprintf(hex, "%02x%02x%02x", color.r, color.g, color.b);
+  transport->print(hex);
+}
+
+void handleColorCmd (char * command) {
+  // Color pipeline commands take the form:  L/GAM>[num]
+  //                                         L/CAL>[E or J],[hex]
+  //                                         L/DTH>[Y or N]
+  //                                         L/CFG
+  //                                           ^
+  //                                  command starts here
+  int arg0;
+  char strip;
+  char hex[7];
+  if (sscanf(command, "GAM>%d", &arg0) == 1) {
+    colors.setGamma(arg0);
+    settings.putUShort("gamma", colors.getGamma());
+  } else if (sscanf(command, "CAL>%c,%6[0-9a-fA-F]", &strip, hex) == 2 && (strip == 'E' || strip == 'J')) {
+    uint32_t calibration = strtoul(hex, NULL, 16);
+    if (strip == 'E') {
+      colors.setCalibration(COLOR_SEGMENT_RIGHT_EYE, calibration);
+      colors.setCalibration(COLOR_SEGMENT_LEFT_EYE, calibration);
+    } else {
+      colors.setCalibration(COLOR_SEGMENT_JAW, calibration);
+    }
+    settings.putUInt((strip == 'E') ? "caleye" : "caljaw", calibration);
+  } else if (strncmp(command, "DTH>", 4) == 0) {
+    colors.setDither(command[4] == 'Y');
+  } else if (strncmp(command, "CFG", 3) == 0) {
+    transport->print("L/CFG>");
+    transport->print(colors.getBrightness());
+    transport->print(",");
+    transport->print(colors.getGamma());
+    transport->print(",");
+    printColor(colors.getCalibration(COLOR_SEGMENT_RIGHT_EYE));
+    transport->print(",");
+    printColor(colors.getCalibration(COLOR_SEGMENT_JAW));
+    transport->print(",");
+    transport->print(colors.getDither() ? "Y" : "N");
+    transport->print("\n");
+  }
+}
+
+void handleSyncCmd (char * command) {
+  // Sync commands take the form:  S/PNG[>[tag]]
+  //                               S/CLR
+  //                                 ^
+  //                        command starts here
+  if (strncmp(command, "PNG", 3) == 0) {
+    // Reply with receive and transmit times so the host can estimate offset
+    // and drift the same way as NTP
+    const char *tag = ((command[3] == '>') ? command + 4 : "");
+    transport->print("S/PNG>");
+    transport->print(tag);
+    transport->print(",");
+    transport->print(lastRxMicros);
+    transport->print(",");
+    transport->print(micros());
+    transport->print("\n");
+  } else if (strncmp(command, "CLR", 3) == 0) {
+    scheduledCommands.clear();
+  }
+}
+
+// Queue a command of the form [time]:[command] for execution at a device time
+void scheduleCommand (char * buffer) {
+  char *separator;
+  uint32_t timeMicros = strtoul(buffer, &separator, 10);
+  if (separator == buffer || *separator != ':') {
+    return;
+  }
+  if (!scheduledCommands.push(timeMicros, separator + 1)) {
+    transport->print("S/FULL\n");
+  }
+}
+
+// Run scheduled commands that are due
+void handleScheduledCommands () {
+  char command[MAX_CMD_SIZE];
+  int32_t remaining = scheduledCommands.timeUntilNext(micros());
+  if (remaining > SCHEDULE_SPIN_US) {
+    return;
+  }
+  // Close enough that waiting beats coming back late on the next pass. Input
+  // is still read meanwhile, so a stop cuts the wait short
+  while (!scheduledCommands.isDue(micros())) {
+    pollInput();
+    if (Servo::halted || scheduledCommands.size() == 0) {
+      return;
+    }
+  }
+  while (scheduledCommands.isDue(micros())) {
+    scheduledCommands.pop(command, MAX_CMD_SIZE);
+    wakeFromIdle();
+    handleMessage(command);
+  }
+}
+
+void savePresetExpression (const char *name) {
+  PresetExpression expression;
+  for (int i = 0; i < 2 * EYE_LED_COUNT; i++) {
+    expression.eyeLeds[i][0] = leds[i].r;
+    expression.eyeLeds[i][1] = leds[i].g;
+    expression.eyeLeds[i][2] = leds[i].b;
+  }
+  for (int i = 0; i < 2; i++) {
+    expression.eyeColors[i][0] = presetEyes[i]->currentColor.r;
+    expression.eyeColors[i][1] = presetEyes[i]->currentColor.g;
+    expression.eyeColors[i][2] = presetEyes[i]->currentColor.b;
+    expression.pupilSizes[i] = presetEyes[i]->pupilSize;
+    expression.pupilInfills[i] = presetEyes[i]->pupilInfill;
+  }
+  expression.jawColor[0] = jaw.currentColor.r;
+  expression.jawColor[1] = jaw.currentColor.g;
+  expression.jawColor[2] = jaw.currentColor.b;
+  expression.jawPos = jawServo.getTarget();
+  expression.leftArmPos = leftArmServo.getTarget();
+  expression.rightArmPos = rightArmServo.getTarget();
+  if (presets.create(name, PRESET_EXPRESSION) < 0
+      || !presets.append(&expression, sizeof(expression)) || !presets.commit()) {
+    presets.discardPending();
+    transport->print("M/FULL\n");
+  }
+}
+
+// Apply an expression straight from flash
+void applyPresetExpression (const PresetExpression *expression) {
+  for (int i = 0; i < 2; i++) {
+    presetEyes[i]->clearAnimation();
+    presetEyes[i]->currentColor = CRGB(expression->eyeColors[i][0], expression->eyeColors[i][1], expression->eyeColors[i][2]);
+    presetEyes[i]->pupilSize = (PupilSize)expression->pupilSizes[i];
+    presetEyes[i]->pupilInfill = (PupilInfill)expression->pupilInfills[i];
+  }
+  for (int i = 0; i < 2 * EYE_LED_COUNT; i++) {
+    leds[i] = CRGB(expression->eyeLeds[i][0], expression->eyeLeds[i][1], expression->eyeLeds[i][2]);
+  }
+  jaw.setColor(CRGB(expression->jawColor[0], expression->jawColor[1], expression->jawColor[2]));
+  jawServo.setPos(expression->jawPos);
+  actuator.moveBoth(expression->leftArmPos, expression->rightArmPos);
+}
+
+void startPresetRecording (const char *name) {
+  if (presets.create(name, PRESET_SEQUENCE) < 0) {
+    transport->print("M/FULL\n");
+    return;
+  }
+  presetRecording = 1;
+  presetRecordStartMillis = Clock::nowMillis();
+}
+
+void finishPresetRecording () {
+  if (presetRecording) {
+    presetRecording = 0;
+    presets.commit();
+  }
+}
+
+// Append a command to the sequence being recorded, as a 4 byte offset from
+// the start of recording followed by the null-terminated command
+void recordPresetCommand (const char *command) {
+  uint32_t offsetMillis = Clock::nowMillis() - presetRecordStartMillis;
+  uint16_t commandSize = strlen(command) + 1;
+  if (presets.pending() + sizeof(offsetMillis) + commandSize > PRESET_DATA_SIZE) {
+    // Keep what fit
+    finishPresetRecording();
+    transport->print("M/FULL\n");
+    return;
+  }
+  presets.append(&offsetMillis, sizeof(offsetMillis));
+  presets.append(command, commandSize);
+}
+
+void recallPreset (const char *name) {
+  int slot = presets.find(name);
+  const PresetHeader *header = presets.header(slot);
+  if (header == NULL) {
+    return;
+  }
+  if (header->type == PRESET_EXPRESSION && header->length >= sizeof(PresetExpression)) {
+    applyPresetExpression((const PresetExpression *)presets.data(slot));
+  } else if (header->type == PRESET_SEQUENCE) {
+    presetPlaySlot = slot;
+    presetPlayCursor = 0;
+    presetPlayStartMillis = Clock::nowMillis();
+  }
+}
+
+// Run sequence commands as they come due
+void handlePresetPlayback () {
+  while (presetPlaySlot >= 0) {
+    const PresetHeader *header = presets.header(presetPlaySlot);
+    if (header == NULL || presetPlayCursor >= header->length) {
+      presetPlaySlot = -1;
+      transport->print("M/DONE\n");
+      return;
+    }
+    const uint8_t *entry = presets.data(presetPlaySlot) + presetPlayCursor;
+    uint32_t offsetMillis;
+    memcpy(&offsetMillis, entry, sizeof(offsetMillis));
+    if ((Clock::nowMillis() - presetPlayStartMillis) < offsetMillis) {
+      return;
+    }
+    const char *command = (const char *)(entry + sizeof(offsetMillis));
+    presetPlayCursor += sizeof(offsetMillis) + strlen(command) + 1;
+    // Handlers only read their command, so it runs in place from flash
+    wakeFromIdle();
+    handleMessage((char *)command);
+  }
+}
+
+void printPresets () {
+  for (int slot = 0; slot < PRESET_SLOT_COUNT; slot++) {
+    const PresetHeader *header = presets.header(slot);
+    if (header != NULL) {
+      transport->print("M/LST>");
+      transport->print(header->name);
+      transport->print((header->type == PRESET_EXPRESSION) ? ",E," : ",S,");
+      transport->print(header->length);
+      transport->print("\n");
+    }
+  }
+}
+
+void handlePresetCmd (char * command) {
+  // Preset commands take the form:  M/CMD>[name]
+  //                                 M/CMD
+  //                                   ^
+  //                          command starts here
+  // Room for one character more than a name can hold, so longer names are
+  // rejected rather than cut, the same as `M>`
+  char name[PRESET_NAME_SIZE + 1];
+  uint8_t hasName = (sscanf(command + 3, ">%12s", name) == 1 && strlen(name) < PRESET_NAME_SIZE);
+  if (strncmp(command, "SAV", 3) == 0 && hasName) {
+    // Only one preset can be written at a time
+    finishPresetRecording();
+    savePresetExpression(name);
+  } else if (strncmp(command, "REC", 3) == 0 && hasName) {
+    finishPresetRecording();
+    startPresetRecording(name);
+  } else if (strncmp(command, "END", 3) == 0) {
+    finishPresetRecording();
+  } else if (strncmp(command, "DEL", 3) == 0 && hasName) {
+    presets.remove(presets.find(name));
+  } else if (strncmp(command, "LST", 3) == 0) {
+    printPresets();
+  } else if (strncmp(command, "STP", 3) == 0) {
+    presetPlaySlot = -1;
+  }
+}
+
+void takeSnapshot (StateSnapshot *snapshot) {
+  snapshot->version = SNAPSHOT_VERSION;
+  snapshot->size = sizeof(StateSnapshot);
+  snapshotEye(&leftEye, &snapshot->eyes[0]);
+  snapshotEye(&rightEye, &snapshot->eyes[1]);
+  snapshotJaw(&jaw, &snapshot->jaw);
+  snapshotServo(&leftArmServo, &snapshot->servos[0]);
+  snapshotServo(&rightArmServo, &snapshot->servos[1]);
+  snapshotServo(&jawServo, &snapshot->servos[2]);
+  snapshot->waypointCount = actuator.waypointCount();
+  snapshot->buttonState = buttonState;
+  snapshot->buttonEnabled = buttonEnabled;
+}
+
+// Print a line of the form [prefix][time],[hex bytes], or
+// [prefix][time],[sequence],[hex bytes] given a sequence number
+void printSnapshotLine (const char *prefix, const uint8_t *bytes, uint16_t size, int sequence = -1) {
+  char hex[3];
+  transport->print(prefix);
+  transport->print(micros());
+  transport->print(",");
+  if (sequence >= 0) {
+    transport->print(sequence);
+    transport->print(",");
+  }
+  for (uint16_t i = 0; i < size; i++) {
+    sprintf(hex, "%02x", bytes[i]);
+    transport->print(hex);
+  }
+  transport->print("\n");
+}
+
+// Send a full snapshot, which deltas then number from
+void sendSnapshot () {
+  takeSnapshot(&snapshotLast);
+  printSnapshotLine("Q/S>", (const uint8_t *)&snapshotLast, sizeof(snapshotLast));
+  snapshotSequence = 0;
+  snapshotPeriodsSinceFull = 0;
+  snapshotResync = 0;
+}
+
+// Push the fields changed since the last snapshot sent, if subscribed. Every
+// `SNAPSHOT_FULL_PERIODS`, or after a delta failed to go out, a full snapshot
+// is sent instead
+void handleSnapshotUpdate () {
+  if (snapshotPeriodMillis == 0 || (millis() - snapshotLastMillis) < snapshotPeriodMillis) {
+    return;
+  }
+  snapshotLastMillis = millis();
+  if (snapshotResync || ++snapshotPeriodsSinceFull >= SNAPSHOT_FULL_PERIODS) {
+    sendSnapshot();
+    return;
+  }
+  StateSnapshot snapshot;
+  uint8_t delta[SNAPSHOT_DELTA_MAX_SIZE];
+  takeSnapshot(&snapshot);
+  uint16_t size = snapshotDelta(&snapshotLast, &snapshot, delta);
+  if (size > 0) {
+    uint32_t droppedLines = transport->droppedLines();
+    snapshotLast = snapshot;
+    printSnapshotLine("Q/D>", delta, size, ++snapshotSequence);
+    snapshotResync = (transport->droppedLines() != droppedLines);
+  }
+}
+
+void handleQueryCmd (char * command) {
+  // Query commands take the form:  Q/GET
+  //                                Q/SUB[>[ms]]
+  //                                Q/UNS
+  //                                  ^
+  //                         command starts here
+  if (strncmp(command, "GET", 3) == 0) {
+    sendSnapshot();
+  } else if (strncmp(command, "SUB", 3) == 0) {
+    int periodMillis = SNAPSHOT_DEFAULT_PERIOD_MS;
+    if (command[3] == '>') {
+      periodMillis = constrain(atoi(command + 4), 0, UINT16_MAX);
+    }
+    // Deltas follow on from a full snapshot
+    snapshotPeriodMillis = periodMillis;
+    snapshotLastMillis = millis();
+    sendSnapshot();
+  } else if (strncmp(command, "UNS", 3) == 0) {
+    snapshotPeriodMillis = 0;
+  }
+}
+
+// Subsystems a command may leave moving or animating
+uint8_t completionMaskFor (char cmd) {
+  switch (cmd) {
+    case 'A':
+      return COMPLETION_ACTUATOR;
+    case 'J':
+      return COMPLETION_JAW;
+    case 'E':
+      return COMPLETION_EYES;
+    case 'R':
+      return COMPLETION_ACTUATOR | COMPLETION_JAW | COMPLETION_EYES;
+    case 'M':
+    case 'F':
+      return COMPLETION_ACTUATOR | COMPLETION_JAW | COMPLETION_EYES | COMPLETION_PRESET;
+  }
+  return 0;
+}
+
+// Wait for the subsystems a command touched to settle, then report its ID
+void trackCompletion (uint16_t id, char cmd) {
+  for (int i = 0; i < COMPLETION_SLOTS; i++) {
+    if (pendingCompletions[i].busyMask == 0) {
+      pendingCompletions[i].id = id;
+      // Commands with nothing to wait on still complete via the next check,
+      // so all completions are reported in the same place
+      pendingCompletions[i].busyMask = completionMaskFor(cmd) | COMPLETION_QUEUED;
+      return;
+    }
+  }
+  transport->print("DROP: ");
+  transport->print(id);
+  transport->print("\n");
+}
+
+void handleCompletions () {
+  uint8_t idleMask = COMPLETION_QUEUED;
+  if (!actuator.isMoving()) {
+    idleMask |= COMPLETION_ACTUATOR;
+  }
+  if (!jaw.isMoving()) {
+    idleMask |= COMPLETION_JAW;
+  }
+  if (!eyes.isAnimating()) {
+    idleMask |= COMPLETION_EYES;
+  }
+  if (presetPlaySlot < 0) {
+    idleMask |= COMPLETION_PRESET;
+  }
+  for (int i = 0; i < COMPLETION_SLOTS; i++) {
+    PendingCompletion *pending = &pendingCompletions[i];
+    if (pending->busyMask == 0) {
+      continue;
+    }
+    pending->busyMask &= ~idleMask;
+    if (pending->busyMask == 0) {
+      transport->print("DONE: ");
+      transport->print(pending->id);
+      transport->print("\n");
+    }
+  }
+}
+
+// Report each subsystem as it finishes homing, then the reset as a whole
+void handleResetProgress () {
+  if (resetBusyMask == 0) {
+    return;
+  }
+  if ((resetBusyMask & COMPLETION_EYES) && !eyes.isAnimating()) {
+    resetBusyMask &= ~COMPLETION_EYES;
+    transport->print("R/EYE\n");
+  }
+  if ((resetBusyMask & COMPLETION_JAW) && !jaw.isMoving()) {
+    resetBusyMask &= ~COMPLETION_JAW;
+    transport->print("R/JAW\n");
+  }
+  if ((resetBusyMask & COMPLETION_ACTUATOR) && !actuator.isMoving()) {
+    resetBusyMask &= ~COMPLETION_ACTUATOR;
+    transport->print("R/ACT\n");
+  }
+  if (resetBusyMask == 0) {
+    transport->print("R/DONE\n");
+  }
+}
+
+// Tagged command, of the form [id]:[command]
+void handleTaggedCommand (char * buffer) {
+  char *separator;
+  unsigned long id = strtoul(buffer, &separator, 10);
+  if (separator == buffer || *separator != ':') {
+    return;
+  }
+  handleMessage(separator + 1);
+  trackCompletion((uint16_t)id, separator[1]);
+}
+
 void handleMessage (char * buffer) {
+  // Scheduled command, of the form @[time]:[command]
+  if (buffer[0] == '@') {
+    scheduleCommand(buffer + 1);
+    return;
+  }
+  // Tagged command, of the form #[id]:[command]
+  if (buffer[0] == '#') {
+    handleTaggedCommand(buffer + 1);
+    return;
+  }
+  // Armed command, of the form ^[slot]:[command]
+  if (buffer[0] == '^') {
+    armCue(buffer + 1);
+    return;
+  }
+  // Commands that move or draw, however they arrive, take the head back
+  // from idle behaviour. Queries and config leave it running
+  if (completionMaskFor(buffer[0]) != 0) {
+    idle.interrupt();
+  }
+  // Progress of a requested reset is reported from `handleResetProgress`
   if (buffer[0] == 'R') {
     reset();
+    resetBusyMask = COMPLETION_ACTUATOR | COMPLETION_JAW | COMPLETION_EYES;
+    return;
+  }
+  // Preset recall, of the form M>[name]
+  if (buffer[0] == 'M' && buffer[1] == '>') {
+    recallPreset(buffer + 2);
+    showLeds();
     return;
   }
-  // Check first delimiter
-  if (buffer[1] != '/') {
+  // Check first delimiter, which is past the end of an empty message
+  if (buffer[0] == '\0' || buffer[1] != '/') {
     return;
   }
   char * subcmd = buffer + 2; // Subcommand starts 2 chars in
@@ -590,9 +2278,86 @@ void handleMessage (char * buffer) {
     case 'B':
       handleButtonCmd(subcmd);
       break;
+    case 'P':
+      handlePerfCmd(subcmd);
+      break;
+    case 'T':
+      handleTraceCmd(subcmd);
+      break;
+    case 'S':
+      handleSyncCmd(subcmd);
+      break;
+    case 'M':
+      handlePresetCmd(subcmd);
+      break;
+    case 'Q':
+      handleQueryCmd(subcmd);
+      break;
+    case 'I':
+      handleIdleCmd(subcmd);
+      break;
+    case 'N':
+      handleIdentityCmd(subcmd);
+      break;
+    case 'F':
+      handleCueCmd(subcmd);
+      break;
+    case 'L':
+      handleColorCmd(subcmd);
+      break;
+    case 'V':
+      handleScriptCmd(subcmd);
+      break;
   }
   // Update LEDs if not done already
-  FastLED.show();
+  showLeds();
+}
+
+// Anything still moving or animating, or input waiting. Commands scheduled
+// ahead don't count: the idle wait ends in time for them, and they wake the
+// head as they run
+uint8_t isBusy () {
+  return actuator.isMoving() || jaw.isMoving() || eyes.isAnimating() || traceReplaying || (presetPlaySlot >= 0)
+    || resetBusyMask || rxAvailable() || (buttonState == BUTTON_CHANGING) || (cueTriggerSlot >= 0) || scripts.isBusy();
+}
+
+// Re-energise released servos at the positions they were left at
+void wakeFromIdle () {
+  if (power.activity()) {
+    leftArmServo.hold();
+    rightArmServo.hold();
+    jawServo.hold();
+  }
+}
+
+// Go idle after a quiet period, then wait for input at low power. Waits end
+// in time for scheduled commands and scripts
+void handlePower () {
+  if (power.update(isBusy())) {
+    if (power.flags & POWER_RELEASE_ACTUATOR) {
+      leftArmServo.release();
+      rightArmServo.release();
+    }
+    if (power.flags & POWER_RELEASE_JAW) {
+      jawServo.release();
+    }
+  }
+  if (power.isIdle()) {
+    int32_t untilScheduled = scheduledCommands.timeUntilNext(micros()) - SCHEDULE_SPIN_US;
+    uint32_t maxMillis = ((untilScheduled > 0) ? (uint32_t)untilScheduled / 1000 : 0);
+    // Script waits and timers also end the wait
+    int32_t untilScript = scripts.millisUntilNext();
+    if (untilScript >= 0) {
+      maxMillis = min(maxMillis, (uint32_t)untilScript);
+    }
+    if (power.sleeps()) {
+      // Output still queued would otherwise wait out the sleep
+      transport->flush();
+    }
+    if (power.wait(maxMillis)) {
+      wakeFromIdle();
+    }
+  }
 }
 
 // Handles reading, debouncing, and notifications of button
@@ -604,10 +2369,18 @@ void handleButton () {
   if (buttonState == BUTTON_CHANGING) {
     if ((millis() - lastButtonTimeMillis) > BUTTON_DEBOUNCE_MS) {
       buttonState = newState;
+      wakeFromIdle();
+      uint8_t started;
       if (buttonState == BUTTON_PRESSED) {
-        Serial.print("B/ON\n");
+        transport->print("B/ON\n");
+        started = scripts.signal(SCRIPT_EVENT_PRESS);
       } else {
-        Serial.print("B/OFF\n");
+        transport->print("B/OFF\n");
+        started = scripts.signal(SCRIPT_EVENT_RELEASE);
+      }
+      if (started > 0) {
+        reflexPending = 1;
+        reflexStartMicros = micros();
       }
     }
   } else {
@@ -618,36 +2391,186 @@ void handleButton () {
   }
 }
 
+// Run scripts, showing what they drew and handing the head over from idle
+// behaviour, as a command would
+void handleScripts () {
+  if (!scripts.update()) {
+    return;
+  }
+  idle.interrupt();
+  wakeFromIdle();
+  showLeds();
+  if (reflexPending) {
+    reflexPending = 0;
+    latencyBench.record("reflex", micros() - reflexStartMicros);
+  }
+}
+
 void setup() {
   pinMode(BUTTON_READ_PIN, INPUT);
   pinMode(BUTTON_EN_PIN, OUTPUT);
   digitalWrite(BUTTON_EN_PIN, LOW);
+  pinMode(CUE_TRIGGER_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(CUE_TRIGGER_PIN), onCueTrigger, FALLING);
+
+  settings.begin("sorcer");
+  deviceId = settings.getUChar("id", 0);
+  deviceGroups = settings.getUShort("groups", 0);
 
-  FastLED.addLeds<LED_TYPE,LED_DATA_PIN,LED_COLOR_ORDER>(leds, LED_NUM)
-    .setCorrection(TypicalLEDStrip)
-    .setDither(LED_BRIGHTNESS < 255);
+  // Brightness, correction and dithering are all done by the color pipeline
+#ifdef LED_SPLIT
+  ledControllers[COLOR_SEGMENT_RIGHT_EYE] = &FastLED.addLeds<LED_TYPE,LED_RIGHT_EYE_PIN,LED_COLOR_ORDER>(ledsOut, EYE_LED_COUNT);
+  ledControllers[COLOR_SEGMENT_LEFT_EYE] = &FastLED.addLeds<LED_TYPE,LED_LEFT_EYE_PIN,LED_COLOR_ORDER>(ledsOut + EYE_LED_COUNT, EYE_LED_COUNT);
+  ledControllers[COLOR_SEGMENT_JAW] = &FastLED.addLeds<LED_TYPE,LED_JAW_PIN,LED_COLOR_ORDER>(ledsOut + JAW_LED_START, JAW_LED_COUNT);
+  for (uint8_t segment = 0; segment < COLOR_SEGMENT_COUNT; segment++) {
+    ledControllers[segment]->setCorrection(UncorrectedColor).setDither(DISABLE_DITHER);
+  }
+#else
+  FastLED.addLeds<LED_TYPE,LED_DATA_PIN,LED_COLOR_ORDER>(ledsOut, LED_NUM)
+    .setCorrection(UncorrectedColor)
+    .setDither(DISABLE_DITHER);
+#endif
+  FastLED.setBrightness(255);
 
+  // Both eyes share a calibration
+  CRGB eyeCalibration = settings.getUInt("caleye", EYE_LED_CALIBRATION);
+  colors.setSegment(COLOR_SEGMENT_RIGHT_EYE, 0, EYE_LED_COUNT, eyeCalibration);
+  colors.setSegment(COLOR_SEGMENT_LEFT_EYE, EYE_LED_COUNT, EYE_LED_COUNT, eyeCalibration);
+  colors.setSegment(COLOR_SEGMENT_JAW, JAW_LED_START, JAW_LED_COUNT, settings.getUInt("caljaw", JAW_LED_CALIBRATION));
+  colors.setGamma(settings.getUShort("gamma", COLOR_DEFAULT_GAMMA));
   // Set master brightness control
-  FastLED.setBrightness(LED_BRIGHTNESS);
+  colors.setBrightness(LED_BRIGHTNESS);
+  Eye::showHook = showLeds;
 
   reset();
 
+  presets.begin();
+
   Serial.begin(115200);
-  Serial.print("Ready! (=^-^=)\n");
+  Servo::pollHook = pollInput;
+  ScriptVM::emitHook = emitScriptValue;
+  scripts.seed();
+  // A fuzz input that crashed the device is reported once it is back up
+  if (fuzzRunningMark == FUZZ_RUNNING_MARK) {
+    fuzzRunningMark = 0;
+    fuzzLastInput[MAX_CMD_SIZE - 1] = '\0';
+    transport->print("P/FUZ>CRASH,");
+    printEscaped(fuzzLastInput);
+    transport->print("\n");
+  }
+#ifdef PWM_EXPANDER
+  Wire.begin(PWM_EXPANDER_SDA_PIN, PWM_EXPANDER_SCL_PIN, PWM_EXPANDER_I2C_HZ);
+  if (!expanderPwm.begin()) {
+    transport->print("PWM expander not found\n");
+  }
+#endif
+  transport->print("Ready! (=^-^=)\n");
+}
+
+// Records latency of a handled message under both its command type and the total
+void recordLatency (char cmd, unsigned long startMicros) {
+  unsigned long elapsed = micros() - startMicros;
+  switch (cmd) {
+    case 'A':
+      latencyBench.record("A", elapsed);
+      break;
+    case 'J':
+      latencyBench.record("J", elapsed);
+      break;
+    case 'E':
+      latencyBench.record("E", elapsed);
+      break;
+    case 'B':
+      latencyBench.record("B", elapsed);
+      break;
+    case 'R':
+      latencyBench.record("R", elapsed);
+      break;
+  }
+  latencyBench.record("all", elapsed);
 }
 
 void loop() {
-  if (Serial.available()) {
-    if (receiveMessage(receivedChars)) {
-      Serial.print("ACK: ");
-      Serial.print(receivedChars);
-      Serial.print("\n");
-      handleMessage(receivedChars);
+  // Latency of a message handled this pass runs until its servo writes go out
+  uint8_t handled = 0;
+  char handledCmd = '\0';
+  unsigned long rxStartMicros = 0;
+  handleCueTrigger();
+  handleScheduledCommands();
+  if (rxAvailable()) {
+    rxStartMicros = micros();
+    lastRxMicros = rxStartMicros;
+    wakeFromIdle();
+    uint8_t overlong;
+    if (receiveMessage(receivedChars, &overlong)) {
+      // Every line is acknowledged, addressed to this head or not, so a host
+      // counting lines in flight stays in step
+      transport->print("ACK: ");
+      transport->print(receivedChars);
+      transport->print("\n");
+      uint8_t discarded = (rxDiscardLines > 0);
+      if (discarded) {
+        rxDiscardLines--;
+      } else {
+        // Any new message lifts a previous stop
+        Servo::halted = 0;
+      }
+      // Messages of the form ~[target]:[command] are only for the heads addressed
+      char *message = ((receivedChars[0] == '~') ? matchAddress(receivedChars + 1) : receivedChars);
+      // A cancelled tagged command will never finish, so its tag is dropped
+      if (message != NULL && discarded && message[0] == '#') {
+        transport->print("DROP: ");
+        transport->print((uint16_t)strtoul(message + 1, NULL, 10));
+        transport->print("\n");
+      }
+      // Lines too long to be a command are dropped whole rather than cut.
+      // Only trace load entries may run past a command's length
+      if (message != NULL && (discarded || overlong || (strlen(message) >= MAX_CMD_SIZE && strncmp(message, "T/LD>", 5) != 0))) {
+        message = NULL;
+      }
+      if (message != NULL) {
+        // Trace commands are left out so dumping and loading don't pollute the
+        // log, and nothing is recorded over entries being replayed
+        if (trace.enabled && !traceReplaying && message[0] != 'T') {
+          trace.record(rxStartMicros, message);
+        }
+        // Likewise, preset commands are left out of recorded sequences
+        if (presetRecording && message[0] != 'M') {
+          recordPresetCommand(message);
+        }
+        handleMessage(message);
+        handled = 1;
+        handledCmd = message[0];
+      }
+      // Input may have arrived any time during the last wait, so this bounds
+      // the time from input to the first command handled after idle
+      if (power.takeWake()) {
+        latencyBench.record("wake", power.sinceWaitMicros());
+      }
     }
   }
-  leftArmServo.update();
-  rightArmServo.update();
+  actuator.update();
   jawServo.update();
+  // Servo writes from this pass go out together
+  PwmOutput::flushAll();
+  if (handled) {
+    recordLatency(handledCmd, rxStartMicros);
+  }
   handleButton();
+  handleScripts();
   eyes.update();
+  // Keep the dither moving while nothing is redrawn. The strip holds its
+  // last frame through idle
+  if (colors.needsRefresh() && !power.isIdle() && (millis() - lastShowMillis) >= COLOR_REFRESH_MS) {
+    showLeds();
+  }
+  handleTraceReplay();
+  handleTraceCapture();
+  handlePresetPlayback();
+  handleCompletions();
+  handleResetProgress();
+  handleSnapshotUpdate();
+  idle.update(isBusy());
+  transport->poll();
+  handlePower();
 }
@@ -11,27 +11,23 @@ Actuator::Actuator (ServoDS3218 *leftServo, ServoDS3218 *rightServo, ExtendDirec
   } else {
     this->leftServo->invert();
   }
+  this->waypointHead = 0;
+  this->waypointSize = 0;
+  this->activeBlendRadius = 0;
 }
 
 void Actuator::moveBoth (int leftNewPos, int rightNewPos, uint8_t blocking) {
-  int maxDelay;
-  if (blocking) {
-    maxDelay = calcMaxDelay(leftNewPos, rightNewPos);
-  }
+  // Direct moves take over from any streamed path
+  clearWaypoints();
   leftServo->setPos(leftNewPos);
   rightServo->setPos(rightNewPos);
-  // Double blocking check due to need to calc delay before setting pos, but
-  // only if blocking
   if (blocking) {
-    // Both servos should always be kept at the same speed. If full speed,
-    // block via delay. Otherwise, update async
-    if (leftServo->getSpeed() == 100) {
-      delay(maxDelay);
-    } else {
-      while (leftServo->requiresUpdate() || rightServo->requiresUpdate()) {
-        leftServo->update();
-        rightServo->update();
-      }
+    // Wait on both servos together. Full-speed moves are already written and
+    // only need time to pass, lower-speed moves are updated async
+    while (isMoving() && !Servo::halted) {
+      Servo::poll();
+      leftServo->update();
+      rightServo->update();
     }
   }
 }
@@ -41,10 +37,9 @@ void Actuator::setSpeed (uint8_t newSpeed) {
   rightServo->setSpeed(newSpeed);
 }
 
-void Actuator::reset () {
+void Actuator::reset (uint8_t blocking) {
   setSpeed(100);
-  // Call is always blocking to ensure reset before other actions
-  extendHalf(1);
+  extendHalf(blocking);
 }
 
 void Actuator::retract (uint8_t blocking) {
@@ -75,6 +70,13 @@ void Actuator::tiltLeft (int amount, uint8_t blocking) {
   moveBoth(500 - halfAmount, 500 + halfAmount, blocking);
 }
 
+void Actuator::pose (int lift, int tilt, uint8_t blocking) {
+  int halfTilt = tilt / 2;
+  int leftPos = constrain(500 + lift + halfTilt, 0, 950);
+  int rightPos = constrain(500 + lift - halfTilt, 0, 950);
+  moveBoth(leftPos, rightPos, blocking);
+}
+
 void Actuator::bounce (uint8_t blocking) {
   int initialLeftPos = leftServo->getPos();
   int initialRightPos = rightServo->getPos();
@@ -95,8 +97,66 @@ void Actuator::shake (int count) {
   extendHalf(0);
 }
 
-int Actuator::calcMaxDelay (int leftNewPos, int rightNewPos) {
-  int leftDelay = leftServo->calcDelay(leftNewPos);
-  int rightDelay = rightServo->calcDelay(rightNewPos);
-  return max(leftDelay, rightDelay);
+uint8_t Actuator::isMoving () {
+  return leftServo->isMoving() || rightServo->isMoving() || (waypointSize > 0);
+}
+
+void Actuator::stop () {
+  clearWaypoints();
+  leftServo->stop();
+  rightServo->stop();
+}
+
+uint8_t Actuator::queueWaypoint (int leftPos, int rightPos, uint16_t durationMillis, uint16_t blendRadius) {
+  if (waypointSize >= ACTUATOR_WAYPOINT_QUEUE_SIZE) {
+    return 0;
+  }
+  ActuatorWaypoint *waypoint = &waypoints[(waypointHead + waypointSize) % ACTUATOR_WAYPOINT_QUEUE_SIZE];
+  waypoint->leftPos = constrain(leftPos, 0, 1000);
+  waypoint->rightPos = constrain(rightPos, 0, 1000);
+  waypoint->durationMillis = durationMillis;
+  waypoint->blendRadius = blendRadius;
+  waypointSize++;
+  return 1;
+}
+
+void Actuator::clearWaypoints () {
+  waypointSize = 0;
+  activeBlendRadius = 0;
+}
+
+uint8_t Actuator::waypointCount () {
+  return waypointSize;
+}
+
+void Actuator::update () {
+  // Look ahead: the next segment starts while still inside the blend radius
+  // of the current one, so the servos never come to rest between them
+  if (waypointSize > 0 && inBlendRange()) {
+    startNextWaypoint();
+  }
+  leftServo->update();
+  rightServo->update();
+}
+
+uint8_t Actuator::inBlendRange () {
+  int leftDist = abs(leftServo->getTarget() - leftServo->getPos());
+  int rightDist = abs(rightServo->getTarget() - rightServo->getPos());
+  return (leftDist <= activeBlendRadius) && (rightDist <= activeBlendRadius);
+}
+
+void Actuator::startNextWaypoint () {
+  ActuatorWaypoint *waypoint = &waypoints[waypointHead];
+  // Carry over time left on the segment being cut short, so arrival times
+  // stay on the host's schedule. Full-speed moves are already written, so
+  // the path can continue from them straight away
+  int carryMillis = 0;
+  if (leftServo->requiresUpdate() || rightServo->requiresUpdate()) {
+    carryMillis = max(leftServo->remainingMillis(), rightServo->remainingMillis());
+  }
+  leftServo->setPosTimed(waypoint->leftPos, waypoint->durationMillis + carryMillis);
+  rightServo->setPosTimed(waypoint->rightPos, waypoint->durationMillis + carryMillis);
+  activeBlendRadius = waypoint->blendRadius;
+  waypointHead = (waypointHead + 1) % ACTUATOR_WAYPOINT_QUEUE_SIZE;
+  waypointSize--;
 }
@@ -5,11 +5,23 @@
 #include "Arduino.h"
 #include "ServoDS3218.h"
 
+// Max number of waypoints buffered per actuator
+#define ACTUATOR_WAYPOINT_QUEUE_SIZE 16
+
 typedef enum {
   CLOCKWISE,
   COUNTER_CLOCKWISE
 } ExtendDirection;
 
+typedef struct {
+  int leftPos;
+  int rightPos;
+  // Time to travel from the previous waypoint
+  uint16_t durationMillis;
+  // Distance from this waypoint at which the next one is started
+  uint16_t blendRadius;
+} ActuatorWaypoint;
+
 // Defines movement control commands for a 2-axis linear actuator gimbal
 // moving an animatronic head
 class Actuator {
@@ -23,8 +35,8 @@ class Actuator {
     void moveBoth (int leftNewPos, int rightNewPos, uint8_t blocking = 0);
     // Set speed for both servos
     void setSpeed (uint8_t newSpeed);
-    // Move arms to initial state (middle)
-    void reset ();
+    // Move arms to initial state (middle) at full speed
+    void reset (uint8_t blocking = 1);
     // Fully retract arms
     void retract (uint8_t blocking = 0);
     // Fully extend arms (does not extend to unloading position)
@@ -37,13 +49,37 @@ class Actuator {
     void tiltRight (int amount = 1000, uint8_t blocking = 0);
     // Tilt gimbal to the left, where amount defines total tilt on range [0, 1000]
     void tiltLeft (int amount = 1000, uint8_t blocking = 0);
+    // Move to a pose offset from the middle, where lift raises both arms and
+    // tilt > 0 tilts right, both on range [-1000, 1000]
+    void pose (int lift, int tilt, uint8_t blocking = 0);
     // Bounce the gimbal up and down
     void bounce (uint8_t blocking = 0);
     // Shake the gimbal slightly back and forth
     void shake (int count = 1);
+    // Indicates either servo is still travelling or waypoints are queued
+    uint8_t isMoving ();
+    // Freeze both servos where they are and drop queued waypoints
+    void stop ();
+    // Queue a waypoint to move through after those already queued. Returns 0 if full
+    uint8_t queueWaypoint (int leftPos, int rightPos, uint16_t durationMillis, uint16_t blendRadius = 0);
+    // Drop all queued waypoints, leaving the current move running
+    void clearWaypoints ();
+    // Number of waypoints not yet started
+    uint8_t waypointCount ();
+    // Update servo positions and start waypoints as they come due
+    void update ();
   protected:
-    // Calculate max delay. Used for blocking calls with both servos moving
-    int calcMaxDelay (int leftNewPos, int rightNewPos);
+    // Ring buffer of waypoints not yet started
+    ActuatorWaypoint waypoints[ACTUATOR_WAYPOINT_QUEUE_SIZE];
+    uint8_t waypointHead;
+    uint8_t waypointSize;
+    // Blend radius of the waypoint currently being travelled to
+    uint16_t activeBlendRadius;
+
+    // Indicates both servos are within the active blend radius of their targets
+    uint8_t inBlendRange ();
+    // Start travelling to the next queued waypoint
+    void startNextWaypoint ();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "Clock.h"
+
+uint8_t Clock::virtualEnabled = 0;
+unsigned long Clock::virtualMicros = 0;
+unsigned long Clock::virtualMillis = 0;
+unsigned long Clock::offsetMicros = 0;
+unsigned long Clock::offsetMillis = 0;
+
+unsigned long Clock::nowMicros () {
+  return virtualEnabled ? virtualMicros : micros() + offsetMicros;
+}
+
+unsigned long Clock::nowMillis () {
+  return virtualEnabled ? virtualMillis : millis() + offsetMillis;
+}
+
+void Clock::setVirtual (uint8_t enabled) {
+  if (enabled && !virtualEnabled) {
+    virtualMicros = nowMicros();
+    virtualMillis = nowMillis();
+  } else if (!enabled && virtualEnabled) {
+    // Both wrap the same way, so the offsets hold across a wrap
+    offsetMicros = virtualMicros - micros();
+    offsetMillis = virtualMillis - millis();
+  }
+  virtualEnabled = enabled;
+}
+
+uint8_t Clock::isVirtual () {
+  return virtualEnabled;
+}
+
+void Clock::step () {
+  if (virtualEnabled) {
+    virtualMicros += CLOCK_STEP_MICROS;
+    virtualMillis += CLOCK_STEP_MICROS / 1000;
+  }
+}
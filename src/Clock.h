@@ -0,0 +1,34 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include "Arduino.h"
+
+// Time a virtual clock moves on each step
+#define CLOCK_STEP_MICROS 1000
+
+// Time seen by everything that moves or animates the head. It follows the
+// hardware clock, unless switched to a virtual clock that only moves when
+// stepped, so a trace replay gives the same outputs however long each pass
+// of the loop takes. Time carries on from where the virtual clock left off
+// when switched back, so it never jumps or runs backward
+class Clock {
+  public:
+    static unsigned long nowMicros ();
+    static unsigned long nowMillis ();
+    // Switch between the virtual and hardware clocks
+    static void setVirtual (uint8_t enabled);
+    static uint8_t isVirtual ();
+    // Move the virtual clock on by `CLOCK_STEP_MICROS`. Does nothing on the
+    // hardware clock
+    static void step ();
+  protected:
+    static uint8_t virtualEnabled;
+    static unsigned long virtualMicros;
+    static unsigned long virtualMillis;
+    // Added to the hardware clock, after a virtual clock has run
+    static unsigned long offsetMicros;
+    static unsigned long offsetMillis;
+};
+
+#endif
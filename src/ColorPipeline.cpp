@@ -0,0 +1,135 @@
+#include <math.h>
+#include "ColorPipeline.h"
+
+// Dither offsets in 1/256ths, in bit-reversed order so any run of frames
+// spreads its rounding evenly
+static const uint8_t ditherOffsets[COLOR_DITHER_PHASES] = {16, 144, 80, 208, 48, 176, 112, 240};
+
+ColorPipeline::ColorPipeline (CRGB *input, CRGB *output, uint16_t count) {
+  this->input = input;
+  this->output = output;
+  this->count = count;
+  this->segmentCount = 0;
+  this->brightness = 255;
+  this->gamma = COLOR_DEFAULT_GAMMA;
+  this->dither = 0;
+  this->fractional = 0;
+  this->invalidMask = 0xff;
+  this->frame = 0;
+}
+
+void ColorPipeline::setSegment (uint8_t segment, uint16_t start, uint16_t count, CRGB calibration) {
+  if (segment >= COLOR_MAX_SEGMENTS) {
+    return;
+  }
+  segmentStarts[segment] = start;
+  segmentCounts[segment] = count;
+  calibrations[segment] = calibration;
+  segmentCount = max(segmentCount, (uint8_t)(segment + 1));
+  buildTables(segment);
+}
+
+void ColorPipeline::setCalibration (uint8_t segment, CRGB calibration) {
+  if (segment >= segmentCount) {
+    return;
+  }
+  calibrations[segment] = calibration;
+  buildTables(segment);
+}
+
+CRGB ColorPipeline::getCalibration (uint8_t segment) {
+  return (segment < segmentCount) ? calibrations[segment] : CRGB(0);
+}
+
+void ColorPipeline::setBrightness (uint8_t brightness) {
+  if (brightness != this->brightness) {
+    this->brightness = brightness;
+    buildAllTables();
+  }
+}
+
+uint8_t ColorPipeline::getBrightness () {
+  return brightness;
+}
+
+void ColorPipeline::setGamma (uint16_t gamma) {
+  gamma = constrain(gamma, COLOR_MIN_GAMMA, COLOR_MAX_GAMMA);
+  if (gamma != this->gamma) {
+    this->gamma = gamma;
+    buildAllTables();
+  }
+}
+
+uint16_t ColorPipeline::getGamma () {
+  return gamma;
+}
+
+void ColorPipeline::setDither (uint8_t enabled) {
+  dither = enabled;
+}
+
+uint8_t ColorPipeline::getDither () {
+  return dither;
+}
+
+uint8_t ColorPipeline::needsRefresh () {
+  return dither && fractional;
+}
+
+uint8_t ColorPipeline::apply () {
+  uint8_t changedMask = invalidMask;
+  uint16_t fractionMask = 0;
+  invalidMask = 0;
+  uint8_t phase = frame;
+  frame = (frame + 1) % COLOR_DITHER_PHASES;
+  for (uint8_t segment = 0; segment < segmentCount; segment++) {
+    const uint16_t *red = tables[segment][0];
+    const uint16_t *green = tables[segment][1];
+    const uint16_t *blue = tables[segment][2];
+    uint16_t end = min((uint16_t)(segmentStarts[segment] + segmentCounts[segment]), count);
+    // The output still holds the last frame, so changes show up as differences
+    uint8_t changed = 0;
+    for (uint16_t i = segmentStarts[segment]; i < end; i++) {
+      // Neighboring LEDs are a few phases apart, so they don't flicker in
+      // step. Without dithering, every frame rounds to nearest
+      uint8_t offset = (dither ? ditherOffsets[(phase + 3 * i) % COLOR_DITHER_PHASES] : 128);
+      uint16_t r = red[input[i].r];
+      uint16_t g = green[input[i].g];
+      uint16_t b = blue[input[i].b];
+      fractionMask |= (r | g | b);
+      CRGB next;
+      next.r = (r + offset) >> 8;
+      next.g = (g + offset) >> 8;
+      next.b = (b + offset) >> 8;
+      changed |= (next != output[i]);
+      output[i] = next;
+    }
+    changedMask |= (changed << segment);
+  }
+  // Frames only need to keep coming while something shown is between levels.
+  // Black, full scale and exact levels look the same in every phase
+  fractional = ((fractionMask & 0xff) != 0);
+  return changedMask;
+}
+
+void ColorPipeline::invalidate () {
+  invalidMask = 0xff;
+}
+
+void ColorPipeline::buildTables (uint8_t segment) {
+  float exponent = gamma / 100.0f;
+  for (uint8_t channel = 0; channel < 3; channel++) {
+    // Full scale is 255.0, just under 256 so the dither offset never carries past 255
+    float scale = 255.0f * 256.0f * (brightness / 255.0f) * (calibrations[segment].raw[channel] / 255.0f);
+    for (int level = 0; level < 256; level++) {
+      uint16_t value = (uint16_t)(scale * powf(level / 255.0f, exponent) + 0.5f);
+      tables[segment][channel][level] = value;
+    }
+  }
+}
+
+void ColorPipeline::buildAllTables () {
+  for (uint8_t segment = 0; segment < segmentCount; segment++) {
+    buildTables(segment);
+  }
+}
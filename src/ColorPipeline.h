@@ -0,0 +1,75 @@
+#ifndef COLOR_PIPELINE_H
+#define COLOR_PIPELINE_H
+
+#include <stdint.h>
+#include <FastLED.h>
+#include "Arduino.h"
+
+// Strip segments, each with its own calibration and change tracking
+#define COLOR_MAX_SEGMENTS 4
+// Frames in the temporal dither cycle. Each output level is split into this
+// many steps, shown in turn
+#define COLOR_DITHER_PHASES 8
+// Gamma in hundredths. 100 is linear, which is how colors have always looked
+#define COLOR_DEFAULT_GAMMA 100
+#define COLOR_MIN_GAMMA 50
+#define COLOR_MAX_GAMMA 300
+
+// Output stage between the drawn colors and the strip. Brightness, gamma and
+// each segment's white balance are baked into one table per channel, in 8.8
+// fixed point, so applying them costs one lookup per channel. The fraction
+// left over can be kept by temporal dithering, which is off by default: each
+// frame rounds it differently, so low brightness averages out to the levels
+// in between. Tables are only rebuilt when a setting changes. Each frame
+// reports which segments' output changed, so unchanged ones needn't be sent
+class ColorPipeline {
+  public:
+    ColorPipeline (CRGB *input, CRGB *output, uint16_t count);
+    // Give LEDs [start, start + count) their own calibration, as a color
+    // correction like `TypicalLEDStrip`
+    void setSegment (uint8_t segment, uint16_t start, uint16_t count, CRGB calibration);
+    void setCalibration (uint8_t segment, CRGB calibration);
+    CRGB getCalibration (uint8_t segment);
+    // Brightness on range [0, 255]
+    void setBrightness (uint8_t brightness);
+    uint8_t getBrightness ();
+    // Gamma in hundredths, on range [COLOR_MIN_GAMMA, COLOR_MAX_GAMMA]
+    void setGamma (uint16_t gamma);
+    uint16_t getGamma ();
+    void setDither (uint8_t enabled);
+    uint8_t getDither ();
+    // Indicates the last frame had a fraction to dither, so frames should
+    // keep coming even when nothing is redrawn
+    uint8_t needsRefresh ();
+    // Write the next frame of the output from the input. Returns a mask with
+    // bit n set if segment n's output changed
+    uint8_t apply ();
+    // Report every segment as changed on the next frame, to resend them all
+    void invalidate ();
+  protected:
+    CRGB *input;
+    CRGB *output;
+    uint16_t count;
+
+    uint8_t segmentCount;
+    uint16_t segmentStarts[COLOR_MAX_SEGMENTS];
+    uint16_t segmentCounts[COLOR_MAX_SEGMENTS];
+    CRGB calibrations[COLOR_MAX_SEGMENTS];
+    // Output level for each input level, per segment and channel, in 8.8
+    uint16_t tables[COLOR_MAX_SEGMENTS][3][256];
+
+    uint8_t brightness;
+    uint16_t gamma;
+    uint8_t dither;
+    // Set if any LED in the last frame fell between two output levels
+    uint8_t fractional;
+    // Segments reported changed on the next frame regardless
+    uint8_t invalidMask;
+    uint8_t frame;
+
+    // Rebuild one segment's tables
+    void buildTables (uint8_t segment);
+    void buildAllTables ();
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "CommandFuzzer.h"
+
+// Seed scrambling constants, from the golden ratio
+#define FUZZ_SEED_MIX 0x9e3779b9
+#define FUZZ_SEED_MULT 2654435761u
+
+typedef enum {
+  FUZZ_TRUNCATE,
+  FUZZ_REPLACE,
+  FUZZ_INSERT,
+  FUZZ_NUMBER,
+  FUZZ_REPEAT,
+  FUZZ_SPLICE,
+  FUZZ_PAD,
+  FUZZ_MUTATION_COUNT
+} FuzzMutation;
+
+// Characters the protocol gives meaning to, then ones it never expects
+static const char fuzzAlphabet[] = "/>,:#@^~!*-BLRTUDYNP0123456789abcdefx \t\x7f\xff";
+// Numbers at the edges of the types handlers scan them into
+static const char * const fuzzNumbers[] = {
+  "-1", "0", "255", "256", "65535", "65536", "-2147483648", "2147483647",
+  "4294967295", "99999999999999", "-", "+", "0x", "1e9"
+};
+#define FUZZ_NUMBER_COUNT (sizeof(fuzzNumbers) / sizeof(fuzzNumbers[0]))
+
+CommandFuzzer::CommandFuzzer (const char * const *corpus, uint16_t corpusSize) {
+  this->corpus = corpus;
+  this->corpusSize = corpusSize;
+  this->randomState = 1;
+}
+
+void CommandFuzzer::seed (uint32_t seed) {
+  if (seed == 0) {
+    seed = micros();
+  }
+  randomState = (seed ^ FUZZ_SEED_MIX) * FUZZ_SEED_MULT;
+  randomState = (randomState != 0) ? randomState : 1;
+}
+
+void CommandFuzzer::next (char *buffer, uint8_t size) {
+  strncpy(buffer, corpus[pick(corpusSize)], size - 1);
+  buffer[size - 1] = '\0';
+  uint8_t length = strlen(buffer);
+  // Some inputs go through unchanged, as a baseline for each command
+  uint8_t mutations = pick(FUZZ_MAX_MUTATIONS + 1);
+  for (uint8_t i = 0; i < mutations; i++) {
+    uint8_t at = pick(length + 1);
+    switch (pick(FUZZ_MUTATION_COUNT)) {
+      case FUZZ_TRUNCATE:
+        length = at;
+        buffer[length] = '\0';
+        break;
+      case FUZZ_REPLACE:
+      case FUZZ_INSERT: {
+        char c = fuzzAlphabet[pick(sizeof(fuzzAlphabet) - 1)];
+        uint8_t removed = ((at < length) && (pick(2) == 0)) ? 1 : 0;
+        length = splice(buffer, size, length, at, removed, &c, 1);
+        break;
+      }
+      case FUZZ_NUMBER: {
+        // Swap out the whole number at a digit, or drop one in anywhere
+        uint8_t end = at;
+        while (at > 0 && isdigit(buffer[at - 1])) {
+          at--;
+        }
+        while (end < length && isdigit(buffer[end])) {
+          end++;
+        }
+        const char *number = fuzzNumbers[pick(FUZZ_NUMBER_COUNT)];
+        length = splice(buffer, size, length, at, end - at, number, strlen(number));
+        break;
+      }
+      case FUZZ_REPEAT: {
+        // Repeat a field, which adds arguments and separators past the
+        // number a handler expects
+        char field[64];
+        uint8_t count = min(pick(length - at + 1), (uint16_t)sizeof(field));
+        memcpy(field, buffer + at, count);
+        length = splice(buffer, size, length, at + count, 0, field, count);
+        break;
+      }
+      case FUZZ_SPLICE: {
+        const char *other = corpus[pick(corpusSize)];
+        uint8_t from = pick(strlen(other) + 1);
+        length = splice(buffer, size, length, at, length - at, other + from, strlen(other + from));
+        break;
+      }
+      case FUZZ_PAD: {
+        char c = fuzzAlphabet[pick(sizeof(fuzzAlphabet) - 1)];
+        while (length < size - 1) {
+          buffer[length++] = c;
+        }
+        buffer[length] = '\0';
+        break;
+      }
+    }
+  }
+}
+
+uint32_t CommandFuzzer::nextRandom () {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+uint16_t CommandFuzzer::pick (uint16_t range) {
+  return (range > 0) ? nextRandom() % range : 0;
+}
+
+uint8_t CommandFuzzer::splice (char *buffer, uint8_t size, uint8_t length, uint8_t at, uint8_t removed,
+    const char *text, uint8_t textLength) {
+  // Text past the end of the buffer is cut, then whatever followed the
+  // replaced characters, as much as still fits
+  textLength = min(textLength, (uint8_t)(size - 1 - at));
+  uint8_t tail = min((uint8_t)(length - at - removed), (uint8_t)(size - 1 - at - textLength));
+  memmove(buffer + at + textLength, buffer + at + removed, tail);
+  memcpy(buffer + at, text, textLength);
+  length = at + textLength + tail;
+  buffer[length] = '\0';
+  return length;
+}
@@ -0,0 +1,38 @@
+#ifndef COMMAND_FUZZER_H
+#define COMMAND_FUZZER_H
+
+#include <stdint.h>
+#include "Arduino.h"
+
+// Most mutations applied to one corpus entry
+#define FUZZ_MAX_MUTATIONS 4
+
+// Generates malformed commands for exercising the parser and handlers. Each
+// input starts from a well formed command in the corpus, so it gets past the
+// first checks and into the handlers, then has up to `FUZZ_MAX_MUTATIONS`
+// protocol-aware mutations applied: truncation, stray separators and prefix
+// characters, numbers at the edges of their types, repeated and spliced
+// fields, and padding to the longest message. Inputs come from a seeded PRNG,
+// so a seed repeats the same run
+class CommandFuzzer {
+  public:
+    CommandFuzzer (const char * const *corpus, uint16_t corpusSize);
+    // Start a sequence of inputs. A seed of 0 picks one
+    void seed (uint32_t seed = 0);
+    // Write the next input to `buffer`, terminated, in at most `size` bytes
+    void next (char *buffer, uint8_t size);
+  protected:
+    const char * const *corpus;
+    uint16_t corpusSize;
+    uint32_t randomState;
+
+    // Next number from the PRNG (xorshift32)
+    uint32_t nextRandom ();
+    // Random integer on range [0, range)
+    uint16_t pick (uint16_t range);
+    // Replace `length` characters at `at` with `text`, keeping the input
+    // within `size` bytes. Returns the new length
+    uint8_t splice (char *buffer, uint8_t size, uint8_t length, uint8_t at, uint8_t removed, const char *text, uint8_t textLength);
+};
+
+#endif
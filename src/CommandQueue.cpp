@@ -0,0 +1,55 @@
+#include "CommandQueue.h"
+
+CommandQueue::CommandQueue () {
+  this->entryCount = 0;
+}
+
+uint8_t CommandQueue::push (uint32_t timeMicros, const char *command) {
+  if (entryCount >= COMMAND_QUEUE_SIZE) {
+    return 0;
+  }
+  // Shift later entries back to keep the queue sorted. Equal times keep
+  // arrival order
+  int index = entryCount;
+  while (index > 0 && (int32_t)(entries[index - 1].timeMicros - timeMicros) > 0) {
+    entries[index] = entries[index - 1];
+    index--;
+  }
+  entries[index].timeMicros = timeMicros;
+  strncpy(entries[index].command, command, COMMAND_QUEUE_CMD_SIZE - 1);
+  entries[index].command[COMMAND_QUEUE_CMD_SIZE - 1] = '\0';
+  entryCount++;
+  return 1;
+}
+
+uint8_t CommandQueue::size () {
+  return entryCount;
+}
+
+uint8_t CommandQueue::isDue (uint32_t nowMicros) {
+  return (entryCount > 0) && (timeUntilNext(nowMicros) <= 0);
+}
+
+int32_t CommandQueue::timeUntilNext (uint32_t nowMicros) {
+  if (entryCount == 0) {
+    return INT32_MAX;
+  }
+  return (int32_t)(entries[0].timeMicros - nowMicros);
+}
+
+uint8_t CommandQueue::pop (char *command, uint8_t commandSize) {
+  if (entryCount == 0) {
+    return 0;
+  }
+  strncpy(command, entries[0].command, commandSize - 1);
+  command[commandSize - 1] = '\0';
+  entryCount--;
+  for (int i = 0; i < entryCount; i++) {
+    entries[i] = entries[i + 1];
+  }
+  return 1;
+}
+
+void CommandQueue::clear () {
+  entryCount = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <stdint.h>
+#include "Arduino.h"
+
+// Max number of commands waiting at once
+#define COMMAND_QUEUE_SIZE 16
+// Max stored command length, including terminator
+#define COMMAND_QUEUE_CMD_SIZE 40
+
+typedef struct {
+  uint32_t timeMicros;
+  char command[COMMAND_QUEUE_CMD_SIZE];
+} QueuedCommand;
+
+// Holds commands to be executed at a given device time, ordered by time.
+// Times are compared as signed differences, so ordering holds across
+// `micros()` wraparound as long as entries are < ~35 minutes apart
+class CommandQueue {
+  public:
+    CommandQueue ();
+    // Insert a command to execute at `timeMicros`. Returns 0 if full
+    uint8_t push (uint32_t timeMicros, const char *command);
+    // Number of queued commands
+    uint8_t size ();
+    // Indicates the earliest command is due at `nowMicros`
+    uint8_t isDue (uint32_t nowMicros);
+    // Microseconds until the earliest command is due (negative if late,
+    // INT32_MAX if empty)
+    int32_t timeUntilNext (uint32_t nowMicros);
+    // Remove the earliest command, copying it out
+    uint8_t pop (char *command, uint8_t commandSize);
+    // Drop all queued commands
+    void clear ();
+  protected:
+    QueuedCommand entries[COMMAND_QUEUE_SIZE];
+    uint8_t entryCount;
+};
+
+#endif
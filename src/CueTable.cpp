@@ -0,0 +1,43 @@
+#include "CueTable.h"
+
+CueTable::CueTable () {
+  clearAll();
+}
+
+uint8_t CueTable::arm (uint8_t slot, const char *command) {
+  if (slot >= CUE_SLOTS) {
+    return 0;
+  }
+  size_t size = strlen(command) + 1;
+  if (lengths[slot] + size > CUE_SIZE) {
+    return 0;
+  }
+  memcpy(commands[slot] + lengths[slot], command, size);
+  lengths[slot] += size;
+  return 1;
+}
+
+uint8_t CueTable::isArmed (uint8_t slot) {
+  return (slot < CUE_SLOTS) && (lengths[slot] > 0);
+}
+
+const char *CueTable::next (uint8_t slot, uint16_t *cursor) {
+  if (slot >= CUE_SLOTS || *cursor >= lengths[slot]) {
+    return NULL;
+  }
+  const char *command = commands[slot] + *cursor;
+  *cursor += strlen(command) + 1;
+  return command;
+}
+
+void CueTable::clear (uint8_t slot) {
+  if (slot < CUE_SLOTS) {
+    lengths[slot] = 0;
+  }
+}
+
+void CueTable::clearAll () {
+  for (uint8_t slot = 0; slot < CUE_SLOTS; slot++) {
+    lengths[slot] = 0;
+  }
+}
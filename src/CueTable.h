@@ -0,0 +1,33 @@
+#ifndef CUE_TABLE_H
+#define CUE_TABLE_H
+
+#include <stdint.h>
+#include "Arduino.h"
+
+// Number of cues armed at once
+#define CUE_SLOTS 8
+// Bytes of commands per cue, including each terminator
+#define CUE_SIZE 128
+
+// Commands loaded ahead of time to run together on a later trigger. Each
+// cue holds any number of commands, back to back, up to `CUE_SIZE` bytes
+class CueTable {
+  public:
+    CueTable ();
+    // Append a command to a cue. Returns 0 if the slot doesn't exist or is full
+    uint8_t arm (uint8_t slot, const char *command);
+    // Indicates a cue holds any commands
+    uint8_t isArmed (uint8_t slot);
+    // Command at `cursor` in a cue, or NULL once past the last. Start the
+    // cursor at 0; it is advanced to the following command
+    const char *next (uint8_t slot, uint16_t *cursor);
+    // Empty a cue
+    void clear (uint8_t slot);
+    // Empty every cue
+    void clearAll ();
+  protected:
+    char commands[CUE_SLOTS][CUE_SIZE];
+    uint16_t lengths[CUE_SLOTS];
+};
+
+#endif
@@ -1,107 +1,34 @@
 #include <stdint.h>
 #include "esp32-hal.h"
 #include "Eye.h"
-
-const uint8_t Eye::eyeClosedIdxs[EYE_CLOSED_IDXS_SIZE] = {
-  3 + EYE_OUTER_RING_START,
-  2 + EYE_INNER_RING_START,
-  0 + EYE_DOT_START,
-  6 + EYE_INNER_RING_START,
-  9 + EYE_OUTER_RING_START
-};
-
-const uint8_t Eye::eyeSquintExtIdxs[EYE_SQUINT_EXT_IDXS_SIZE] = {
-  1 + EYE_INNER_RING_START,
-  0 + EYE_INNER_RING_START,
-  7 + EYE_INNER_RING_START
-};
-
-const uint8_t Eye::eyeBlinkStep0Idxs[EYE_BLINK_STEP0_IDXS_SIZE] = {
-  0 + EYE_INNER_RING_START,
-  4 + EYE_INNER_RING_START
-};
-
-const uint8_t Eye::eyeBlinkStep1Idxs[EYE_BLINK_STEP1_IDXS_SIZE] = {
-  1 + EYE_INNER_RING_START,
-  3 + EYE_INNER_RING_START,
-  5 + EYE_INNER_RING_START,
-  7 + EYE_INNER_RING_START
-};
-
-const uint8_t Eye::eyeDeadIdxs[EYE_DEAD_IDXS_SIZE] = {
-  1 + EYE_OUTER_RING_START,
-  2 + EYE_OUTER_RING_START,
-  4 + EYE_OUTER_RING_START,
-  5 + EYE_OUTER_RING_START,
-  7 + EYE_OUTER_RING_START,
-  8 + EYE_OUTER_RING_START,
-  10 + EYE_OUTER_RING_START,
-  11 + EYE_OUTER_RING_START,
-  1 + EYE_INNER_RING_START,
-  3 + EYE_INNER_RING_START,
-  5 + EYE_INNER_RING_START,
-  7 + EYE_INNER_RING_START,
-  0 + EYE_DOT_START
-};
-
-const uint8_t Eye::eyeLookLeftIdxs[EYE_LOOK_REG_IDXS_SIZE] = {
-  2 + EYE_OUTER_RING_START,
-  3 + EYE_OUTER_RING_START,
-  4 + EYE_OUTER_RING_START,
-  1 + EYE_INNER_RING_START,
-  2 + EYE_INNER_RING_START,
-  3 + EYE_INNER_RING_START
-};
-
-const uint8_t Eye::eyeLookRightIdxs[EYE_LOOK_REG_IDXS_SIZE] = {
-  8 + EYE_OUTER_RING_START,
-  9 + EYE_OUTER_RING_START,
-  10 + EYE_OUTER_RING_START,
-  5 + EYE_INNER_RING_START,
-  6 + EYE_INNER_RING_START,
-  7 + EYE_INNER_RING_START
-};
-
-const uint8_t Eye::eyeLookUpIdxs[EYE_LOOK_REG_IDXS_SIZE] = {
-  5 + EYE_OUTER_RING_START,
-  6 + EYE_OUTER_RING_START,
-  7 + EYE_OUTER_RING_START,
-  3 + EYE_INNER_RING_START,
-  4 + EYE_INNER_RING_START,
-  5 + EYE_INNER_RING_START
-};
-
-const uint8_t Eye::eyeLookDownIdxs[EYE_LOOK_REG_IDXS_SIZE] = {
-  0 + EYE_OUTER_RING_START,
-  1 + EYE_OUTER_RING_START,
-  11 + EYE_OUTER_RING_START,
-  0 + EYE_INNER_RING_START,
-  1 + EYE_INNER_RING_START,
-  7 + EYE_INNER_RING_START
-};
-
-const uint8_t Eye::eyeLookLeftLrgIdxs[EYE_LOOK_LRG_IDXS_SIZE] = {
-  1 + EYE_OUTER_RING_START,
-  5 + EYE_OUTER_RING_START
-};
-
-const uint8_t Eye::eyeLookRightLrgIdxs[EYE_LOOK_LRG_IDXS_SIZE] = {
-  7 + EYE_OUTER_RING_START,
-  11 + EYE_OUTER_RING_START
-};
-
-const uint8_t Eye::eyeLookUpLrgIdxs[EYE_LOOK_LRG_IDXS_SIZE] = {
-  4 + EYE_OUTER_RING_START,
-  8 + EYE_OUTER_RING_START
-};
-
-const uint8_t Eye::eyeLookDownLrgIdxs[EYE_LOOK_LRG_IDXS_SIZE] = {
-  2 + EYE_OUTER_RING_START,
-  10 + EYE_OUTER_RING_START
-};
+#include "Clock.h"
+
+// Drawing masks are initialized in the class; these are the storage for them
+constexpr uint64_t Eye::eyeClosedMask;
+constexpr uint64_t Eye::eyeClosedRegMask;
+constexpr uint64_t Eye::eyeSquintExtMask;
+constexpr uint64_t Eye::eyeBlinkStep0Mask;
+constexpr uint64_t Eye::eyeBlinkStep1Mask;
+constexpr uint64_t Eye::eyeDeadMask;
+constexpr uint64_t Eye::eyeLookLeftMask;
+constexpr uint64_t Eye::eyeLookRightMask;
+constexpr uint64_t Eye::eyeLookUpMask;
+constexpr uint64_t Eye::eyeLookDownMask;
+constexpr uint64_t Eye::eyeLookLeftLrgMask;
+constexpr uint64_t Eye::eyeLookRightLrgMask;
+constexpr uint64_t Eye::eyeLookUpLrgMask;
+constexpr uint64_t Eye::eyeLookDownLrgMask;
+
+void (*Eye::showHook)() = NULL;
+uint8_t Eye::frameCacheEnabled = 1;
+CRGB Eye::rainbowTable[EYE_RAINBOW_CACHED ? 256 : 1][EYE_INNER_RING_COUNT + EYE_OUTER_RING_COUNT];
+uint8_t Eye::rainbowBaked = 0;
 
 Eye::Eye (CRGB *leds, int start, CRGB defaultColor) {
   this->leds = leds;
+  this->frameCount = 0;
+  this->frameIndex = 0;
+  this->rainbowCached = 0;
   this->start = start;
   this->end = start + EYE_LED_COUNT - 1;
   this->defaultColor = defaultColor;
@@ -118,6 +45,15 @@ void Eye::reset () {
 
 void Eye::clearAnimation () {
   animationState.type = ANIMATION_NONE;
+  frameCount = 0;
+}
+
+uint8_t Eye::isAnimating () {
+  return animationState.type != ANIMATION_NONE;
+}
+
+AnimationState Eye::getAnimationState () {
+  return animationState;
 }
 
 void Eye::clear (uint8_t _clearAnimation) {
@@ -149,6 +85,14 @@ void Eye::writeRing (RingArea ring, CRGB newColor) {
   }
 }
 
+void Eye::writeMask (uint64_t mask, CRGB newColor) {
+  // Visit set bits only, lowest first
+  while (mask) {
+    leds[start + __builtin_ctzll(mask)] = newColor;
+    mask &= mask - 1;
+  }
+}
+
 // Static drawings
 // ============================
 void Eye::open (uint8_t _clearAnimation) {
@@ -175,19 +119,13 @@ void Eye::close (uint8_t _clearAnimation) {
   }
   writeRing(RING_OUTER, 0);
   writeRing(RING_INNER, 0);
-  int startPos = ((pupilSize == PUPIL_REG) ? EYE_CLOSED_REG_PUPIL_START_IDX : 0);
-  int drawSize = ((pupilSize == PUPIL_REG) ? EYE_CLOSED_REG_PUPIL_SIZE : EYE_CLOSED_IDXS_SIZE);
-  for (int i = startPos; i < drawSize + startPos; i++) {
-    leds[Eye::eyeClosedIdxs[i] + start] = currentColor;
-  }
+  writeMask(((pupilSize == PUPIL_REG) ? Eye::eyeClosedRegMask : Eye::eyeClosedMask), currentColor);
 }
 
 void Eye::squint (uint8_t _clearAnimation) {
   // First close eye, then draw extra bits
   close(_clearAnimation);
-  for (int i = 0; i < 3; i++) {
-    leds[Eye::eyeSquintExtIdxs[i] + start] = currentColor;
-  }
+  writeMask(Eye::eyeSquintExtMask, currentColor);
 }
 
 void Eye::dilate (uint8_t _clearAnimation) {
@@ -208,65 +146,143 @@ void Eye::setInfill (uint8_t hasInfill) {
 
 void Eye::dead (uint8_t _clearAnimation) {
   clear(_clearAnimation);
-  for (int i = 0; i < EYE_DEAD_IDXS_SIZE; i++) {
-    leds[Eye::eyeDeadIdxs[i] + start] = CRGB(0xff0000);
-  }
+  writeMask(Eye::eyeDeadMask, CRGB(0xff0000));
 }
 
 void Eye::lookLeft (uint8_t _clearAnimation) {
   clear(_clearAnimation);
-  for (int i = 0; i < EYE_LOOK_REG_IDXS_SIZE; i++) {
-    leds[Eye::eyeLookLeftIdxs[i] + start] = currentColor;
-  }
+  writeMask(Eye::eyeLookLeftMask, currentColor);
   if (pupilSize == PUPIL_LARGE) {
-    for (int i = 0; i < EYE_LOOK_LRG_IDXS_SIZE; i++) {
-      leds[Eye::eyeLookLeftLrgIdxs[i] + start] = currentColor;
-    }
+    writeMask(Eye::eyeLookLeftLrgMask, currentColor);
   }
 }
 
 void Eye::lookRight (uint8_t _clearAnimation) {
   clear(_clearAnimation);
-  for (int i = 0; i < EYE_LOOK_REG_IDXS_SIZE; i++) {
-    leds[Eye::eyeLookRightIdxs[i] + start] = currentColor;
-  }
+  writeMask(Eye::eyeLookRightMask, currentColor);
   if (pupilSize == PUPIL_LARGE) {
-    for (int i = 0; i < EYE_LOOK_LRG_IDXS_SIZE; i++) {
-      leds[Eye::eyeLookRightLrgIdxs[i] + start] = currentColor;
-    }
+    writeMask(Eye::eyeLookRightLrgMask, currentColor);
   }
 }
 
 void Eye::lookUp (uint8_t _clearAnimation) {
   clear(_clearAnimation);
-  for (int i = 0; i < EYE_LOOK_REG_IDXS_SIZE; i++) {
-    leds[Eye::eyeLookUpIdxs[i] + start] = currentColor;
-  }
+  writeMask(Eye::eyeLookUpMask, currentColor);
   if (pupilSize == PUPIL_LARGE) {
-    for (int i = 0; i < EYE_LOOK_LRG_IDXS_SIZE; i++) {
-      leds[Eye::eyeLookUpLrgIdxs[i] + start] = currentColor;
-    }
+    writeMask(Eye::eyeLookUpLrgMask, currentColor);
   }
 }
 
 void Eye::lookDown (uint8_t _clearAnimation) {
   clear(_clearAnimation);
-  for (int i = 0; i < EYE_LOOK_REG_IDXS_SIZE; i++) {
-    leds[Eye::eyeLookDownIdxs[i] + start] = currentColor;
-  }
+  writeMask(Eye::eyeLookDownMask, currentColor);
   if (pupilSize == PUPIL_LARGE) {
-    for (int i = 0; i < EYE_LOOK_LRG_IDXS_SIZE; i++) {
-      leds[Eye::eyeLookDownLrgIdxs[i] + start] = currentColor;
+    writeMask(Eye::eyeLookDownLrgMask, currentColor);
+  }
+}
+
+void Eye::gaze (int x, int y, uint8_t _clearAnimation) {
+  clear(_clearAnimation);
+  x = constrain(x, -EYE_GAZE_RANGE, EYE_GAZE_RANGE);
+  y = constrain(y, -EYE_GAZE_RANGE, EYE_GAZE_RANGE);
+  if (pupilSize == PUPIL_REG) {
+    drawDisc(x, y, EYE_GAZE_PUPIL_REG_RADIUS, currentColor);
+    if (pupilInfill == PUPIL_NO_INFILL) {
+      drawDisc(x, y, EYE_GAZE_HOLLOW_REG_RADIUS, 0);
+    }
+  } else {
+    drawDisc(x, y, EYE_GAZE_PUPIL_LRG_RADIUS, currentColor);
+    if (pupilInfill == PUPIL_NO_INFILL) {
+      drawDisc(x, y, EYE_GAZE_HOLLOW_LRG_RADIUS, 0);
+    }
+  }
+}
+
+// Vector primitives
+// ============================
+void Eye::drawArc (RingArea ring, uint8_t fromAngle, uint8_t toAngle, CRGB color) {
+  int first, count;
+  switch (ring) {
+    case RING_DOT:
+      leds[start + EYE_DOT_START] = color;
+      return;
+    case RING_INNER:
+      first = EYE_INNER_RING_START;
+      count = EYE_INNER_RING_COUNT;
+      break;
+    default:
+      first = EYE_OUTER_RING_START;
+      count = EYE_OUTER_RING_COUNT;
+      break;
+  }
+  for (int i = first; i < first + count; i++) {
+    if (inAngleRange(i, fromAngle, toAngle)) {
+      leds[start + i] = color;
     }
   }
 }
 
+void Eye::drawWedge (uint8_t fromAngle, uint8_t toAngle, uint8_t minRadius, uint8_t maxRadius, CRGB color) {
+  for (int i = 0; i < EYE_LED_COUNT; i++) {
+    uint8_t radius = EyeGeometry::polar[i].radius;
+    if (radius >= minRadius && radius <= maxRadius && inAngleRange(i, fromAngle, toAngle)) {
+      leds[start + i] = color;
+    }
+  }
+}
+
+void Eye::drawLine (uint8_t angle, CRGB color) {
+  // Opposite ends of the line are half a turn apart
+  uint8_t oppositeAngle = angle + 128;
+  for (int i = 0; i < EYE_LED_COUNT; i++) {
+    if (nearAngle(i, angle) || nearAngle(i, oppositeAngle)) {
+      leds[start + i] = color;
+    }
+  }
+}
+
+void Eye::drawDisc (int x, int y, int radius, CRGB color) {
+  for (int i = 0; i < EYE_LED_COUNT; i++) {
+    uint8_t intensity = discIntensity(EyeGeometry::pos[i][0] - x, EyeGeometry::pos[i][1] - y, radius);
+    if (intensity > 0) {
+      leds[start + i] = blend(leds[start + i], color, intensity);
+    }
+  }
+}
+
+uint8_t Eye::inAngleRange (int idx, uint8_t fromAngle, uint8_t toAngle) {
+  if (EyeGeometry::polar[idx].radius == EYE_DOT_RADIUS) {
+    return 1;
+  }
+  // Unsigned wraparound measures both offsets counter-clockwise from `fromAngle`
+  return (uint8_t)(EyeGeometry::polar[idx].angle - fromAngle) <= (uint8_t)(toAngle - fromAngle);
+}
+
+uint8_t Eye::nearAngle (int idx, uint8_t angle) {
+  return eyeLedNear(idx, angle);
+}
+
+uint8_t Eye::discIntensity (int dx, int dy, int radius) {
+  // Fade linearly in squared distance across the edge, which avoids a sqrt
+  // and is close enough to linear over the narrow edge width
+  long inner = max(radius - EYE_GAZE_EDGE_WIDTH / 2, 0);
+  long outer = radius + EYE_GAZE_EDGE_WIDTH / 2;
+  long innerSq = inner * inner;
+  long outerSq = outer * outer;
+  long distSq = (long)dx * dx + (long)dy * dy;
+  if (distSq <= innerSq) {
+    return 255;
+  }
+  if (distSq >= outerSq) {
+    return 0;
+  }
+  return (uint8_t)((255 * (outerSq - distSq)) / (outerSq - innerSq));
+}
+
 void Eye::blinkStep0 (BlinkState blinkState) {
   if (pupilSize == PUPIL_REG) {
     CRGB newColor = ((blinkState == BLINK_CLOSING) ? 0 : currentColor);
-    for (int i = 0; i < EYE_BLINK_STEP0_IDXS_SIZE; i++) {
-      leds[Eye::eyeBlinkStep0Idxs[i] + start] = newColor;
-    }
+    writeMask(Eye::eyeBlinkStep0Mask, newColor);
   } else {
     if (blinkState == BLINK_CLOSING) {
       close();
@@ -279,9 +295,7 @@ void Eye::blinkStep0 (BlinkState blinkState) {
 void Eye::blinkStep1 (BlinkState blinkState) {
   if (pupilSize == PUPIL_REG) {
     CRGB newColor = ((blinkState == BLINK_CLOSING) ? 0 : currentColor);
-    for (int i = 0; i < EYE_BLINK_STEP1_IDXS_SIZE; i++) {
-      leds[Eye::eyeBlinkStep1Idxs[i] + start] = newColor;
-    }
+    writeMask(Eye::eyeBlinkStep1Mask, newColor);
     if (blinkState == BLINK_CLOSING) {
       // dot should always display when closed
       writeRing(RING_DOT, currentColor);
@@ -303,6 +317,7 @@ void Eye::blink (uint16_t stepDelayMillis) {
   animationState.type = ANIMATION_BLINKING;
   animationState.u.blink.step = 0;
   animationState.frameDelayMillis = stepDelayMillis;
+  bakeFrames();
 }
 
 void Eye::rainbow (uint16_t stepDelayMillis) {
@@ -312,6 +327,11 @@ void Eye::rainbow (uint16_t stepDelayMillis) {
   animationState.u.rainbow.dotHue = (uint8_t)random(256);
   animationState.u.rainbow.outerClockwise = (uint8_t)random(2);
   animationState.frameDelayMillis = stepDelayMillis;
+  frameCount = 0;
+  rainbowCached = (frameCacheEnabled && EYE_RAINBOW_CACHED);
+  if (rainbowCached) {
+    bakeRainbow();
+  }
 }
 
 void Eye::spiral (uint16_t stepDelayMillis, uint8_t up, uint8_t clearBehind) {
@@ -320,6 +340,7 @@ void Eye::spiral (uint16_t stepDelayMillis, uint8_t up, uint8_t clearBehind) {
   animationState.u.spiral.position = 0;
   animationState.u.spiral.up = up;
   animationState.frameDelayMillis = stepDelayMillis;
+  bakeFrames();
 }
 
 // Color setting
@@ -435,25 +456,93 @@ void Eye::handleSpiralUpdate (uint8_t clearBehind) {
   animationState.u.spiral.position += delta;
 }
 
+void Eye::stepAnimation () {
+  if (frameCount > 0) {
+    memcpy(leds + start, frameCache[frameIndex], sizeof(frameCache[0]));
+    animationState = frameStates[frameIndex];
+    frameIndex++;
+    if (frameIndex == frameCount) {
+      clearAnimation();
+    }
+    return;
+  }
+  switch (animationState.type) {
+    case ANIMATION_BLINKING:
+      handleBlinkUpdate();
+      break;
+    case ANIMATION_RAINBOW:
+      if (rainbowCached) {
+        // Same steps as handleRainbowUpdate, with the fills looked up
+        memcpy(leds + start, rainbowTable[animationState.u.rainbow.innerHue], EYE_INNER_RING_COUNT * sizeof(CRGB));
+        memcpy(leds + start + EYE_OUTER_RING_START, rainbowTable[animationState.u.rainbow.outerHue] + EYE_INNER_RING_COUNT,
+          EYE_OUTER_RING_COUNT * sizeof(CRGB));
+        int8_t delta = (animationState.u.rainbow.outerClockwise ? 1 : -1);
+        animationState.u.rainbow.outerHue -= delta;
+        animationState.u.rainbow.innerHue += delta;
+        animationState.u.rainbow.dotHue -= delta;
+      } else {
+        handleRainbowUpdate();
+      }
+      break;
+    case ANIMATION_SPIRAL_DOT:
+      handleSpiralUpdate(1);
+      break;
+    case ANIMATION_SPIRAL_LINE:
+      handleSpiralUpdate(0);
+      break;
+    default:
+      break;
+  }
+}
+
+uint8_t Eye::isBaked () {
+  return (frameCount > 0) || (animationState.type == ANIMATION_RAINBOW && rainbowCached);
+}
+
+void Eye::bakeFrames () {
+  frameCount = 0;
+  frameIndex = 0;
+  if (!frameCacheEnabled) {
+    return;
+  }
+  CRGB saved[EYE_LED_COUNT];
+  memcpy(saved, leds + start, sizeof(saved));
+  AnimationState savedState = animationState;
+  int count = 0;
+  // Live frames draw over whatever the last left, so each is rendered in place
+  while (animationState.type != ANIMATION_NONE && count < EYE_FRAME_CACHE_FRAMES) {
+    stepAnimation();
+    memcpy(frameCache[count], leds + start, sizeof(frameCache[0]));
+    frameStates[count] = animationState;
+    count++;
+  }
+  uint8_t fits = (animationState.type == ANIMATION_NONE);
+  memcpy(leds + start, saved, sizeof(saved));
+  animationState = savedState;
+  frameCount = fits ? count : 0;
+}
+
+void Eye::bakeRainbow () {
+  if (rainbowBaked) {
+    return;
+  }
+  for (int hue = 0; hue < 256; hue++) {
+    fill_rainbow(rainbowTable[hue], EYE_INNER_RING_COUNT, hue, 255 / EYE_INNER_RING_COUNT);
+    fill_rainbow(rainbowTable[hue] + EYE_INNER_RING_COUNT, EYE_OUTER_RING_COUNT, hue, 255 / EYE_OUTER_RING_COUNT);
+  }
+  rainbowBaked = 1;
+}
+
 void Eye::update () {
   if (animationState.type != ANIMATION_NONE) {
-    if ((millis() - lastTimeMillis) > animationState.frameDelayMillis) {
-      switch (animationState.type) {
-        case ANIMATION_BLINKING:
-          handleBlinkUpdate();
-          break;
-        case ANIMATION_RAINBOW:
-          handleRainbowUpdate();
-          break;
-        case ANIMATION_SPIRAL_DOT:
-          handleSpiralUpdate(1);
-          break;
-        case ANIMATION_SPIRAL_LINE:
-          handleSpiralUpdate(0);
-          break;
+    if ((Clock::nowMillis() - lastTimeMillis) > animationState.frameDelayMillis) {
+      stepAnimation();
+      if (showHook != NULL) {
+        showHook();
+      } else {
+        FastLED.show();
       }
-      FastLED.show();
-      lastTimeMillis = millis();
+      lastTimeMillis = Clock::nowMillis();
     }
   }
 }
\ No newline at end of file
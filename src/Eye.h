@@ -5,31 +5,34 @@
 #include <FastLED.h>
 #include "Arduino.h"
 
-// There are 3 "rings": outer, inner, center dot.
-// Data moves from inner dot to outer ring
-#define EYE_OUTER_RING_COUNT 12
-#define EYE_INNER_RING_COUNT 8
-#define EYE_OUTER_RING_START (1 + EYE_INNER_RING_COUNT)
-#define EYE_INNER_RING_START 1
-#define EYE_DOT_START 0
-#define EYE_LED_COUNT (1 + EYE_INNER_RING_COUNT + EYE_OUTER_RING_COUNT)
+#include "EyeTopology.h"
 
 // Default step delays for animations
 #define EYE_BLINK_STEP_DELAY_MS 75
 #define EYE_RAINBOW_STEP_DELAY_MS 100
 #define EYE_SPIRAL_STEP_DELAY_MS 50
 
-// Static drawing array sizes
-#define EYE_CLOSED_IDXS_SIZE 5
-#define EYE_CLOSED_REG_PUPIL_SIZE 3
-#define EYE_CLOSED_REG_PUPIL_START_IDX 1
-
-#define EYE_SQUINT_EXT_IDXS_SIZE 3
-#define EYE_BLINK_STEP0_IDXS_SIZE 2
-#define EYE_BLINK_STEP1_IDXS_SIZE 4
-#define EYE_DEAD_IDXS_SIZE 13
-#define EYE_LOOK_REG_IDXS_SIZE 6
-#define EYE_LOOK_LRG_IDXS_SIZE 2
+// Gaze geometry, in units where the outer ring has radius 100. A gaze of
+// (+/-EYE_GAZE_RANGE, 0) puts the pupil center on the outer ring
+#define EYE_GAZE_RANGE 100
+// Pupil radius for each pupil size
+#define EYE_GAZE_PUPIL_REG_RADIUS 55
+#define EYE_GAZE_PUPIL_LRG_RADIUS 105
+// Radius of the unlit center for pupils without infill
+#define EYE_GAZE_HOLLOW_REG_RADIUS 25
+#define EYE_GAZE_HOLLOW_LRG_RADIUS 75
+// Width of the anti-aliased pupil edge
+#define EYE_GAZE_EDGE_WIDTH 40
+
+// RAM per eye for baked frames of finite animations. Animations with more
+// frames than fit are rendered live
+#define EYE_FRAME_CACHE_BYTES 2048
+#define EYE_FRAME_CACHE_FRAMES ((int)(EYE_FRAME_CACHE_BYTES / (EYE_LED_COUNT * sizeof(CRGB))))
+// RAM for the rainbow table shared by both eyes, holding each ring's colors
+// at every hue. Layouts whose table doesn't fit render rainbows live
+#define EYE_RAINBOW_CACHE_BYTES 16384
+#define EYE_RAINBOW_TABLE_BYTES (256 * (EYE_INNER_RING_COUNT + EYE_OUTER_RING_COUNT) * sizeof(CRGB))
+#define EYE_RAINBOW_CACHED (EYE_RAINBOW_TABLE_BYTES <= EYE_RAINBOW_CACHE_BYTES)
 
 
 typedef enum {
@@ -42,12 +45,6 @@ typedef enum {
   PUPIL_INFILL
 } PupilInfill;
 
-typedef enum {
-  RING_DOT,
-  RING_INNER,
-  RING_OUTER
-} RingArea;
-
 typedef enum {
   BLINK_CLOSING,
   BLINK_OPENING
@@ -99,39 +96,56 @@ class Eye {
     PupilSize pupilSize;
     PupilInfill pupilInfill;
 
-    static const uint8_t eyeClosedIdxs[EYE_CLOSED_IDXS_SIZE];
+    // Called to show animation frames, in place of `FastLED.show` if set
+    static void (*showHook)();
+    // Set to bake animations into RAM as they start, so each frame is a copy.
+    // Animations already running carry on as they started
+    static uint8_t frameCacheEnabled;
 
-    static const uint8_t eyeSquintExtIdxs[EYE_SQUINT_EXT_IDXS_SIZE];
+    // Static drawings, generated for the head topology at compile time
+    static constexpr uint64_t eyeClosedMask = eyeLineMask(EYE_ANGLE_LEFT);
 
-    static const uint8_t eyeBlinkStep0Idxs[EYE_BLINK_STEP0_IDXS_SIZE];
+    // Closed line for regular pupil size, which doesn't reach the outer ring
+    static constexpr uint64_t eyeClosedRegMask = eyeLineMask(EYE_ANGLE_LEFT) & ~eyeRingMask(RING_OUTER);
 
-    static const uint8_t eyeBlinkStep1Idxs[EYE_BLINK_STEP1_IDXS_SIZE];
+    static constexpr uint64_t eyeSquintExtMask = eyeArcMask(RING_INNER, EYE_ANGLE_DOWN, EYE_LOOK_INNER_HALF_WIDTH);
 
-    static const uint8_t eyeDeadIdxs[EYE_DEAD_IDXS_SIZE];
+    static constexpr uint64_t eyeBlinkStep0Mask = eyeNearMask(RING_INNER, EYE_ANGLE_DOWN)
+      | eyeNearMask(RING_INNER, EYE_ANGLE_UP);
+
+    // Rest of the inner ring, apart from the closed line
+    static constexpr uint64_t eyeBlinkStep1Mask = eyeRingMask(RING_INNER) & ~eyeBlinkStep0Mask
+      & ~eyeNearMask(RING_INNER, EYE_ANGLE_LEFT) & ~eyeNearMask(RING_INNER, EYE_ANGLE_RIGHT);
+
+    static constexpr uint64_t eyeDeadMask = eyeCrossMask();
 
     // Look directions for regular pupil size
-    static const uint8_t eyeLookLeftIdxs[EYE_LOOK_REG_IDXS_SIZE];
+    static constexpr uint64_t eyeLookLeftMask = eyeLookMask(EYE_ANGLE_LEFT);
 
-    static const uint8_t eyeLookRightIdxs[EYE_LOOK_REG_IDXS_SIZE];
+    static constexpr uint64_t eyeLookRightMask = eyeLookMask(EYE_ANGLE_RIGHT);
 
-    static const uint8_t eyeLookUpIdxs[EYE_LOOK_REG_IDXS_SIZE];
+    static constexpr uint64_t eyeLookUpMask = eyeLookMask(EYE_ANGLE_UP);
 
-    static const uint8_t eyeLookDownIdxs[EYE_LOOK_REG_IDXS_SIZE];
+    static constexpr uint64_t eyeLookDownMask = eyeLookMask(EYE_ANGLE_DOWN);
 
     // Extras for look directions for large pupil size
-    static const uint8_t eyeLookLeftLrgIdxs[EYE_LOOK_LRG_IDXS_SIZE];
-    
-    static const uint8_t eyeLookRightLrgIdxs[EYE_LOOK_LRG_IDXS_SIZE];
-    
-    static const uint8_t eyeLookUpLrgIdxs[EYE_LOOK_LRG_IDXS_SIZE];
-    
-    static const uint8_t eyeLookDownLrgIdxs[EYE_LOOK_LRG_IDXS_SIZE];
+    static constexpr uint64_t eyeLookLeftLrgMask = eyeLookLrgMask(EYE_ANGLE_LEFT);
+
+    static constexpr uint64_t eyeLookRightLrgMask = eyeLookLrgMask(EYE_ANGLE_RIGHT);
+
+    static constexpr uint64_t eyeLookUpLrgMask = eyeLookLrgMask(EYE_ANGLE_UP);
+
+    static constexpr uint64_t eyeLookDownLrgMask = eyeLookLrgMask(EYE_ANGLE_DOWN);
 
     Eye (CRGB *leds, int start, CRGB defaultColor);
     // Reset to default size and color
     void reset ();
     // Cancel any current animation
     void clearAnimation ();
+    // Indicates an animation is running
+    uint8_t isAnimating ();
+    // Get the state of any current animation
+    AnimationState getAnimationState ();
 
     // Static drawings
     // ============================
@@ -141,6 +155,8 @@ class Eye {
     void fill (uint8_t _clearAnimation = 0);
     // Write ring
     void writeRing (RingArea ring, CRGB newColor);
+    // Write every LED set in a drawing mask
+    void writeMask (uint64_t mask, CRGB newColor);
     // Open the eye (default pupil size)
     void open (uint8_t _clearAnimation = 0);
     // Close the eye (horizontal line)
@@ -163,6 +179,20 @@ class Eye {
     void lookUp (uint8_t _clearAnimation = 0);
     // Look down
     void lookDown (uint8_t _clearAnimation = 0);
+    // Draw the pupil centered at any (x, y) on range [-EYE_GAZE_RANGE, EYE_GAZE_RANGE],
+    // spreading intensity between neighboring LEDs
+    void gaze (int x, int y, uint8_t _clearAnimation = 0);
+    // Vector primitives
+    // ============================
+    // Draw the part of a ring between two angles, going counter-clockwise from `fromAngle`
+    void drawArc (RingArea ring, uint8_t fromAngle, uint8_t toAngle, CRGB color);
+    // Draw all LEDs between two angles with radius in [minRadius, maxRadius]
+    void drawWedge (uint8_t fromAngle, uint8_t toAngle, uint8_t minRadius, uint8_t maxRadius, CRGB color);
+    // Draw a line through the center at any angle, picking the nearest LED(s) on each ring
+    void drawLine (uint8_t angle, CRGB color);
+    // Draw a solid disc of any radius centered at (x, y), anti-aliased at the edge
+    void drawDisc (int x, int y, int radius, CRGB color);
+
     // Step 0 for blink animation
     void blinkStep0 (BlinkState blinkState);
     // Step 1 for blink animation
@@ -183,6 +213,11 @@ class Eye {
     void handleRainbowUpdate ();
     // Handle spiral animation updates
     void handleSpiralUpdate (uint8_t clearBehind);
+    // Draw the next frame of the current animation, copied from the cache if
+    // baked, otherwise rendered live
+    void stepAnimation ();
+    // Indicates the current animation plays from the cache
+    uint8_t isBaked ();
     // Run animation updates
     void update ();
 
@@ -197,8 +232,33 @@ class Eye {
     // Set color to custom value
     void setColor (CRGB newColor);
   private:
+    // Intensity of an anti-aliased disc of `radius` at offset (dx, dy) from its center
+    static uint8_t discIntensity (int dx, int dy, int radius);
+    // Indicates LED `idx` lies between two angles
+    static uint8_t inAngleRange (int idx, uint8_t fromAngle, uint8_t toAngle);
+    // Indicates LED `idx` is the nearest on its ring to `angle`
+    static uint8_t nearAngle (int idx, uint8_t angle);
+
+    // Render every frame of the current finite animation into the cache up
+    // front, leaving the LEDs and state as they were. Leaves it unbaked if the
+    // frames don't fit
+    void bakeFrames ();
+    // Fill the rainbow table, once
+    static void bakeRainbow ();
+
     // State of any current animation
     AnimationState animationState;
+    // Baked frames of the current finite animation, with the animation state
+    // after each. `frameCount` is 0 when not baked
+    CRGB frameCache[EYE_FRAME_CACHE_FRAMES][EYE_LED_COUNT];
+    AnimationState frameStates[EYE_FRAME_CACHE_FRAMES];
+    uint8_t frameCount;
+    uint8_t frameIndex;
+    // Set when the current rainbow plays from the table
+    uint8_t rainbowCached;
+    // Colors of the inner then outer ring, for each starting hue
+    static CRGB rainbowTable[EYE_RAINBOW_CACHED ? 256 : 1][EYE_INNER_RING_COUNT + EYE_OUTER_RING_COUNT];
+    static uint8_t rainbowBaked;
     // Last time updates occurred
     unsigned long lastTimeMillis;
 };
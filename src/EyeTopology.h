@@ -0,0 +1,239 @@
+#ifndef EYE_TOPOLOGY_H
+#define EYE_TOPOLOGY_H
+
+#include <stdint.h>
+
+// Head layouts. Select one at build time by defining HEAD_VARIANT
+#define HEAD_VARIANT_STANDARD 0
+#define HEAD_VARIANT_LARGE 1
+
+#ifndef HEAD_VARIANT
+#define HEAD_VARIANT HEAD_VARIANT_STANDARD
+#endif
+
+// Each eye is a center dot inside an inner and an outer ring. LED data runs
+// from the dot to the inner ring to the outer ring, and each ring starts at
+// the bottom of the eye going counter-clockwise toward the `lookLeft` side.
+// Radii are in units where the outer ring has radius 100
+struct HeadTopologyStandard {
+  enum {
+    innerRingCount = 8,
+    outerRingCount = 12,
+    innerRingRadius = 50,
+    jawLedCount = 12
+  };
+};
+
+struct HeadTopologyLarge {
+  enum {
+    innerRingCount = 16,
+    outerRingCount = 24,
+    innerRingRadius = 60,
+    jawLedCount = 20
+  };
+};
+
+#if HEAD_VARIANT == HEAD_VARIANT_LARGE
+typedef HeadTopologyLarge HeadTopology;
+#else
+typedef HeadTopologyStandard HeadTopology;
+#endif
+
+#define EYE_OUTER_RING_COUNT ((int)HeadTopology::outerRingCount)
+#define EYE_INNER_RING_COUNT ((int)HeadTopology::innerRingCount)
+#define EYE_OUTER_RING_START (1 + EYE_INNER_RING_COUNT)
+#define EYE_INNER_RING_START 1
+#define EYE_DOT_START 0
+#define EYE_LED_COUNT (1 + EYE_INNER_RING_COUNT + EYE_OUTER_RING_COUNT)
+
+// Angles are in 1/256ths of a turn, starting at the bottom of the eye and
+// increasing counter-clockwise toward the `lookLeft` side
+#define EYE_ANGLE_DOWN 0
+#define EYE_ANGLE_LEFT 64
+#define EYE_ANGLE_UP 128
+#define EYE_ANGLE_RIGHT 192
+// Ring radii, matching the units of `EyeGeometry::pos`
+#define EYE_DOT_RADIUS 0
+#define EYE_INNER_RING_RADIUS ((int)HeadTopology::innerRingRadius)
+#define EYE_OUTER_RING_RADIUS 100
+
+// Drawing masks hold one bit per LED
+static_assert(EYE_LED_COUNT <= 64, "Eye topology has more LEDs than fit in a drawing mask");
+
+typedef enum {
+  RING_DOT,
+  RING_INNER,
+  RING_OUTER
+} RingArea;
+
+typedef struct {
+  uint8_t angle;
+  uint8_t radius;
+} EyeLedPolar;
+
+// Compile-time geometry
+// ============================
+// Everything below is evaluated by the compiler for the selected topology,
+// so lookups at runtime are plain table reads and mask constants
+
+// sin() * 100 for the first quarter turn, in 1/256 turn steps
+constexpr int8_t eyeQuarterSine[65] = {
+  0, 2, 5, 7, 10, 12, 15, 17, 20, 22, 24, 27, 29, 31, 34, 36,
+  38, 41, 43, 45, 47, 49, 51, 53, 56, 58, 60, 62, 63, 65, 67, 69,
+  71, 72, 74, 76, 77, 79, 80, 82, 83, 84, 86, 87, 88, 89, 90, 91,
+  92, 93, 94, 95, 96, 96, 97, 98, 98, 99, 99, 99, 100, 100, 100, 100,
+  100
+};
+
+constexpr int eyeSine (uint8_t angle) {
+  return (angle < 64) ? eyeQuarterSine[angle]
+    : (angle < 128) ? eyeQuarterSine[128 - angle]
+    : (angle < 192) ? -eyeQuarterSine[angle - 128]
+    : -eyeQuarterSine[256 - angle];
+}
+
+constexpr int eyeCosine (uint8_t angle) {
+  return eyeSine((uint8_t)(angle + 64));
+}
+
+constexpr RingArea eyeLedRing (int idx) {
+  return (idx < EYE_INNER_RING_START) ? RING_DOT
+    : (idx < EYE_OUTER_RING_START) ? RING_INNER
+    : RING_OUTER;
+}
+
+constexpr int eyeRingCount (RingArea ring) {
+  return (ring == RING_DOT) ? 1 : (ring == RING_INNER) ? EYE_INNER_RING_COUNT : EYE_OUTER_RING_COUNT;
+}
+
+constexpr int eyeRingStart (RingArea ring) {
+  return (ring == RING_DOT) ? EYE_DOT_START : (ring == RING_INNER) ? EYE_INNER_RING_START : EYE_OUTER_RING_START;
+}
+
+constexpr uint8_t eyeRingRadius (RingArea ring) {
+  return (ring == RING_DOT) ? EYE_DOT_RADIUS : (ring == RING_INNER) ? EYE_INNER_RING_RADIUS : EYE_OUTER_RING_RADIUS;
+}
+
+// Angle of an LED, evenly spaced around its ring and rounded to nearest
+constexpr uint8_t eyeLedAngle (int idx) {
+  return (uint8_t)(((idx - eyeRingStart(eyeLedRing(idx))) * 512 + eyeRingCount(eyeLedRing(idx)))
+    / (2 * eyeRingCount(eyeLedRing(idx))));
+}
+
+constexpr uint8_t eyeLedRadius (int idx) {
+  return eyeRingRadius(eyeLedRing(idx));
+}
+
+// x increases to the right (the `lookRight` side), y increases upward
+constexpr int8_t eyeLedX (int idx) {
+  return (int8_t)(-(eyeSine(eyeLedAngle(idx)) * eyeLedRadius(idx)) / 100);
+}
+
+constexpr int8_t eyeLedY (int idx) {
+  return (int8_t)(-(eyeCosine(eyeLedAngle(idx)) * eyeLedRadius(idx)) / 100);
+}
+
+// Absolute difference between two angles, going the short way round
+constexpr int eyeAngleDelta (uint8_t a, uint8_t b) {
+  return (((a - b) & 0xff) > 128) ? (256 - ((a - b) & 0xff)) : ((a - b) & 0xff);
+}
+
+// Indicates LED `idx` is the nearest on its ring to `angle`, i.e. within half
+// the LED spacing. Exactly halfway between two LEDs counts for both. The dot
+// counts as nearest to every angle
+constexpr bool eyeLedNear (int idx, uint8_t angle) {
+  return (eyeLedRing(idx) == RING_DOT)
+    || ((eyeAngleDelta(eyeLedAngle(idx), angle) * eyeRingCount(eyeLedRing(idx)) * 2) <= 256);
+}
+
+// Drawing masks, with bit `idx` set for each LED drawn
+// ============================
+constexpr uint64_t eyeRingMask (RingArea ring, int idx = 0) {
+  return (idx >= EYE_LED_COUNT) ? 0
+    : (((uint64_t)(eyeLedRing(idx) == ring) << idx) | eyeRingMask(ring, idx + 1));
+}
+
+// LEDs on `ring` within `halfWidth` of `center`
+constexpr uint64_t eyeArcMask (RingArea ring, uint8_t center, uint8_t halfWidth, int idx = 0) {
+  return (idx >= EYE_LED_COUNT) ? 0
+    : (((uint64_t)((eyeLedRing(idx) == ring) && (eyeAngleDelta(eyeLedAngle(idx), center) <= halfWidth)) << idx)
+      | eyeArcMask(ring, center, halfWidth, idx + 1));
+}
+
+// LEDs on `ring` nearest to `angle`
+constexpr uint64_t eyeNearMask (RingArea ring, uint8_t angle, int idx = 0) {
+  return (idx >= EYE_LED_COUNT) ? 0
+    : (((uint64_t)((eyeLedRing(idx) == ring) && eyeLedNear(idx, angle)) << idx)
+      | eyeNearMask(ring, angle, idx + 1));
+}
+
+// Line through the center at `angle`
+constexpr uint64_t eyeLineMask (uint8_t angle) {
+  return eyeRingMask(RING_DOT)
+    | eyeNearMask(RING_INNER, angle) | eyeNearMask(RING_INNER, (uint8_t)(angle + 128))
+    | eyeNearMask(RING_OUTER, angle) | eyeNearMask(RING_OUTER, (uint8_t)(angle + 128));
+}
+
+// Half widths of look direction arcs, covering 3 LEDs per ring on the standard head
+#define EYE_LOOK_OUTER_HALF_WIDTH 24
+#define EYE_LOOK_INNER_HALF_WIDTH 35
+#define EYE_LOOK_LRG_HALF_WIDTH 45
+
+// Half width of each outer ring arm of the dead symbol, covering 2 LEDs on the standard head
+#define EYE_DEAD_OUTER_HALF_WIDTH 16
+
+// Regular pupil looking toward `angle`
+constexpr uint64_t eyeLookMask (uint8_t angle) {
+  return eyeArcMask(RING_OUTER, angle, EYE_LOOK_OUTER_HALF_WIDTH)
+    | eyeArcMask(RING_INNER, angle, EYE_LOOK_INNER_HALF_WIDTH);
+}
+
+// Extra LEDs for a large pupil looking toward `angle`
+constexpr uint64_t eyeLookLrgMask (uint8_t angle) {
+  return eyeArcMask(RING_OUTER, angle, EYE_LOOK_LRG_HALF_WIDTH)
+    & ~eyeArcMask(RING_OUTER, angle, EYE_LOOK_OUTER_HALF_WIDTH);
+}
+
+// Cross through the diagonals, thickened on the outer ring
+constexpr uint64_t eyeCrossMask () {
+  return eyeLineMask(EYE_ANGLE_DOWN + 32) | eyeLineMask(EYE_ANGLE_LEFT + 32)
+    | eyeArcMask(RING_OUTER, EYE_ANGLE_DOWN + 32, EYE_DEAD_OUTER_HALF_WIDTH)
+    | eyeArcMask(RING_OUTER, EYE_ANGLE_LEFT + 32, EYE_DEAD_OUTER_HALF_WIDTH)
+    | eyeArcMask(RING_OUTER, EYE_ANGLE_UP + 32, EYE_DEAD_OUTER_HALF_WIDTH)
+    | eyeArcMask(RING_OUTER, EYE_ANGLE_RIGHT + 32, EYE_DEAD_OUTER_HALF_WIDTH);
+}
+
+// Per-LED tables
+// ============================
+template<int... Idxs> struct EyeLedSeq {};
+
+template<int N, int... Idxs> struct EyeMakeLedSeq : EyeMakeLedSeq<N - 1, N - 1, Idxs...> {};
+
+template<int... Idxs> struct EyeMakeLedSeq<0, Idxs...> {
+  typedef EyeLedSeq<Idxs...> type;
+};
+
+template<class Seq> struct EyeGeometryTables;
+
+template<int... Idxs> struct EyeGeometryTables<EyeLedSeq<Idxs...> > {
+  // Angle and radius of each LED. The dot has angle 0 but is treated as
+  // lying at every angle
+  static const EyeLedPolar polar[sizeof...(Idxs)];
+  // Position (x, y) of each LED
+  static const int8_t pos[sizeof...(Idxs)][2];
+};
+
+template<int... Idxs>
+const EyeLedPolar EyeGeometryTables<EyeLedSeq<Idxs...> >::polar[sizeof...(Idxs)] = {
+  { eyeLedAngle(Idxs), eyeLedRadius(Idxs) }...
+};
+
+template<int... Idxs>
+const int8_t EyeGeometryTables<EyeLedSeq<Idxs...> >::pos[sizeof...(Idxs)][2] = {
+  { eyeLedX(Idxs), eyeLedY(Idxs) }...
+};
+
+// Tables for the selected topology
+typedef EyeGeometryTables<EyeMakeLedSeq<EYE_LED_COUNT>::type> EyeGeometry;
+
+#endif
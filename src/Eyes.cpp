@@ -17,6 +17,10 @@ void Eyes::clearAnimation () {
   rightEye->clearAnimation();
 }
 
+uint8_t Eyes::isAnimating () {
+  return leftEye->isAnimating() || rightEye->isAnimating();
+}
+
 void Eyes::blink (uint16_t stepDelayMillis) {
   leftEye->blink(stepDelayMillis);
   rightEye->blink(stepDelayMillis);
@@ -82,6 +86,11 @@ void Eyes::lookDown (uint8_t _clearAnimation) {
   rightEye->lookDown(_clearAnimation);
 }
 
+void Eyes::gaze (int x, int y, uint8_t _clearAnimation) {
+  leftEye->gaze(x, y, _clearAnimation);
+  rightEye->gaze(x, y, _clearAnimation);
+}
+
 void Eyes::angry () {
   leftEye->angry();
   rightEye->angry();
@@ -24,6 +24,8 @@ class Eyes {
     void reset ();
     // Clear any animation on both eyes
     void clearAnimation ();
+    // Indicates either eye is running an animation
+    uint8_t isAnimating ();
     // Blink both eyes
     void blink (uint16_t stepDelayMillis = EYE_BLINK_STEP_DELAY_MS);
     // Open both eyes
@@ -50,6 +52,8 @@ class Eyes {
     void lookUp (uint8_t _clearAnimation = 0);
     // Both look down
     void lookDown (uint8_t _clearAnimation = 0);
+    // Both gaze at (x, y)
+    void gaze (int x, int y, uint8_t _clearAnimation = 0);
     // Set color to red
     void angry ();
     // Set color to green
@@ -0,0 +1,15 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+
+// Register writes to I2C devices. Drivers go through this rather than `Wire`,
+// so they can run on the host against a mock device
+class I2cBus {
+  public:
+    // Write `length` bytes to registers from `reg` on, in one transaction.
+    // Returns 0 if the device didn't acknowledge
+    virtual uint8_t writeRegisters (uint8_t address, uint8_t reg, const uint8_t *data, uint8_t length) = 0;
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include <math.h>
+#include "IdleBehavior.h"
+#include "Clock.h"
+
+// Seed scrambling constants, from the golden ratio
+#define IDLE_SEED_MIX 0x9e3779b9
+#define IDLE_SEED_MULT 2654435761u
+
+IdleBehavior::IdleBehavior (Eyes *eyes, Actuator *actuator) {
+  this->eyes = eyes;
+  this->actuator = actuator;
+  this->blinkInterval = {2000, 4500};
+  this->saccadeInterval = {300, 1500};
+  this->saccadeRange = 30;
+  this->swayPeriodMillis = 4000;
+  this->swayLift = 30;
+  this->swayTilt = 20;
+  this->resumeMillis = IDLE_RESUME_DEFAULT_MS;
+  this->enabled = 0;
+  this->running = 0;
+  this->randomState = 1;
+  this->lastInterruptMillis = 0;
+}
+
+void IdleBehavior::start (uint32_t seed) {
+  if (seed == 0) {
+    seed = micros();
+  }
+  // Spread small seeds across all bits, as xorshift starts out poorly from
+  // them. It also never leaves 0, so that can't be the state
+  randomState = (seed ^ IDLE_SEED_MIX) * IDLE_SEED_MULT;
+  randomState = (randomState != 0) ? randomState : 1;
+  enabled = 1;
+  running = 0;
+  lastInterruptMillis = Clock::nowMillis() - resumeMillis;
+}
+
+void IdleBehavior::stop () {
+  interrupt();
+  enabled = 0;
+}
+
+uint8_t IdleBehavior::isEnabled () {
+  return enabled;
+}
+
+void IdleBehavior::interrupt () {
+  lastInterruptMillis = Clock::nowMillis();
+  if (running) {
+    // The sway segment under way is short, and any actuator command replaces it
+    actuator->clearWaypoints();
+    running = 0;
+  }
+}
+
+void IdleBehavior::update (uint8_t busy) {
+  if (!enabled) {
+    return;
+  }
+  if (!running) {
+    if (busy || (Clock::nowMillis() - lastInterruptMillis) < resumeMillis) {
+      return;
+    }
+    resume();
+  }
+  unsigned long now = Clock::nowMillis();
+  // Events wait out any blink in progress
+  if (!eyes->isAnimating()) {
+    if ((long)(now - nextBlinkMillis) >= 0) {
+      eyes->blink();
+      nextBlinkMillis = now + drawInterval(blinkInterval);
+    } else if ((long)(now - nextSaccadeMillis) >= 0) {
+      saccade();
+      nextSaccadeMillis = now + drawInterval(saccadeInterval);
+    }
+  }
+  // Keep one waypoint queued behind the one being travelled
+  if (swayPeriodMillis > 0 && actuator->waypointCount() < 2) {
+    queueSway();
+  }
+}
+
+uint32_t IdleBehavior::nextRandom () {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+int IdleBehavior::randomOffset (int range) {
+  return (int)(nextRandom() % (2 * range + 1)) - range;
+}
+
+uint32_t IdleBehavior::drawInterval (IdleInterval interval) {
+  if (interval.meanMillis <= interval.minMillis) {
+    return interval.minMillis;
+  }
+  // Uniform on (0, 1], never 0 so the log stays finite
+  float uniform = ((nextRandom() >> 8) + 1) / 16777216.0f;
+  float spread = interval.meanMillis - interval.minMillis;
+  float extra = -spread * logf(uniform);
+  return interval.minMillis + (uint32_t)min(extra, spread * IDLE_INTERVAL_MAX_MEANS);
+}
+
+void IdleBehavior::resume () {
+  unsigned long now = Clock::nowMillis();
+  running = 1;
+  nextBlinkMillis = now + drawInterval(blinkInterval);
+  nextSaccadeMillis = now + drawInterval(saccadeInterval);
+  swayBaseLeft = actuator->leftServo->getTarget();
+  swayBaseRight = actuator->rightServo->getTarget();
+  swayStep = 0;
+  swayTiltFrom = 0;
+  swayTiltTo = 0;
+}
+
+void IdleBehavior::saccade () {
+  // Half the glances return to center, the rest go off in a look direction
+  switch (nextRandom() % 8) {
+    case 0:
+      eyes->gaze(-saccadeRange, 0);
+      break;
+    case 1:
+      eyes->gaze(saccadeRange, 0);
+      break;
+    case 2:
+      eyes->gaze(0, saccadeRange);
+      break;
+    case 3:
+      eyes->gaze(0, -saccadeRange);
+      break;
+    default:
+      eyes->gaze(0, 0);
+      break;
+  }
+}
+
+void IdleBehavior::queueSway () {
+  if (swayStep == 0) {
+    // Each breath drifts toward a new tilt
+    swayTiltFrom = swayTiltTo;
+    swayTiltTo = randomOffset(swayTilt);
+  }
+  swayStep++;
+  // Lift rises and falls once per breath, from rest at the base pose
+  float phase = (float)TWO_PI * swayStep / IDLE_SWAY_STEPS;
+  int lift = (int)(swayLift * (1 - cosf(phase)) / 2);
+  int tilt = swayTiltFrom + (swayTiltTo - swayTiltFrom) * swayStep / IDLE_SWAY_STEPS;
+  actuator->queueWaypoint(swayBaseLeft + lift + tilt / 2, swayBaseRight + lift - tilt / 2,
+    swayPeriodMillis / IDLE_SWAY_STEPS, IDLE_SWAY_BLEND);
+  swayStep %= IDLE_SWAY_STEPS;
+}
@@ -0,0 +1,86 @@
+#ifndef IDLE_BEHAVIOR_H
+#define IDLE_BEHAVIOR_H
+
+#include <stdint.h>
+#include "Arduino.h"
+#include "Actuator.h"
+#include "Eyes.h"
+
+// Default quiet period after a command before idle behaviour resumes
+#define IDLE_RESUME_DEFAULT_MS 5000
+// Waypoints per breath. More gives a smoother sway at the cost of more moves
+#define IDLE_SWAY_STEPS 8
+// Blend radius of sway waypoints, so the breath never comes to rest
+#define IDLE_SWAY_BLEND 4
+// Intervals are capped at this many times their mean, so a long gap in a
+// random sequence still ends
+#define IDLE_INTERVAL_MAX_MEANS 4
+
+// Random interval between events: at least `minMillis`, then exponentially
+// distributed, so the events form a Poisson process averaging `meanMillis`
+typedef struct {
+  uint16_t minMillis;
+  uint16_t meanMillis;
+} IdleInterval;
+
+// Makes the head look alive between cues: blinks, small glances in the look
+// directions, and a slow breathing sway of the actuator around wherever it
+// was left. Events are drawn from a seeded PRNG, so a seed replays the same
+// sequence. Any command interrupts it, and it picks up again once the head
+// has been quiet for `resumeMillis`
+class IdleBehavior {
+  public:
+    IdleInterval blinkInterval;
+    IdleInterval saccadeInterval;
+    // How far glances go, where 100 is the outer ring
+    uint8_t saccadeRange;
+    // Breath length, 0 for no sway
+    uint16_t swayPeriodMillis;
+    // Peak lift and tilt of the sway, in actuator position units
+    uint16_t swayLift;
+    uint16_t swayTilt;
+    uint32_t resumeMillis;
+
+    IdleBehavior (Eyes *eyes, Actuator *actuator);
+    // Enable idle behaviour, starting straight away. A seed of 0 picks one
+    void start (uint32_t seed = 0);
+    // Disable idle behaviour
+    void stop ();
+    // Indicates idle behaviour is enabled, whether running or interrupted
+    uint8_t isEnabled ();
+    // Hand the head back to a command. Cheap enough to call on every one
+    void interrupt ();
+    // Run due events, or resume once quiet. `busy` holds off resuming
+    void update (uint8_t busy);
+  protected:
+    Eyes *eyes;
+    Actuator *actuator;
+
+    uint8_t enabled;
+    // Set while events are being generated
+    uint8_t running;
+    uint32_t randomState;
+    unsigned long lastInterruptMillis;
+    unsigned long nextBlinkMillis;
+    unsigned long nextSaccadeMillis;
+    // Actuator position the sway is centered on
+    int swayBaseLeft;
+    int swayBaseRight;
+    uint8_t swayStep;
+    int swayTiltFrom;
+    int swayTiltTo;
+
+    // Next number from the PRNG (xorshift32)
+    uint32_t nextRandom ();
+    // Random integer on range [-range, range]
+    int randomOffset (int range);
+    // Draw the time until the next event
+    uint32_t drawInterval (IdleInterval interval);
+    // Begin generating events from the current pose
+    void resume ();
+    void saccade ();
+    // Queue the next waypoint of the breath
+    void queueSway ();
+};
+
+#endif
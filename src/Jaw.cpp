@@ -30,11 +30,15 @@ void Jaw::setColor (CRGB newColor) {
   fill_solid(leds, ledCount, newColor);
 }
 
-void Jaw::reset () {
-  close(1);
+void Jaw::reset (uint8_t blocking) {
+  close(blocking);
 }
 
 void Jaw::resetColor () {
   currentColor = defaultColor;
   fill_solid(leds, ledCount, currentColor);
+}
+
+uint8_t Jaw::isMoving () {
+  return jawServo->isMoving();
 }
\ No newline at end of file
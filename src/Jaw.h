@@ -25,9 +25,11 @@ class Jaw {
     // Set color of mouth
     void setColor (CRGB newColor);
     // Reset servo and strip
-    void reset ();
+    void reset (uint8_t blocking = 1);
     // Reset strip color
     void resetColor ();
+    // Indicates the jaw servo is still travelling
+    uint8_t isMoving ();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,24 @@
+#include "esp32-hal.h"
+#include "LedcPwm.h"
+
+LedcPwm::LedcPwm () {
+  memset(pins, 0, sizeof(pins));
+}
+
+void LedcPwm::attach (uint8_t channel, uint8_t pin) {
+  pins[channel] = pin;
+  ledcSetup(channel, PWM_SERVO_HZ, PWM_DUTY_BITS);
+  ledcAttachPin(pin, channel);
+}
+
+void LedcPwm::write (uint8_t channel, uint16_t duty) {
+  ledcWrite(channel, duty);
+}
+
+void LedcPwm::release (uint8_t channel) {
+  ledcDetachPin(pins[channel]);
+}
+
+void LedcPwm::hold (uint8_t channel) {
+  ledcAttachPin(pins[channel], channel);
+}
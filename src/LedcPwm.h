@@ -0,0 +1,26 @@
+#ifndef LEDC_PWM_H
+#define LEDC_PWM_H
+
+#include <stdint.h>
+#include "Arduino.h"
+#include "PwmOutput.h"
+
+// LEDC channels on the ESP32. The S3 only has 8
+#define LEDC_PWM_CHANNELS 16
+
+// PWM from the ESP32's LEDC peripheral, one GPIO per channel. Writes go out
+// straight away, so there is nothing to flush
+class LedcPwm: public PwmOutput {
+  public:
+    LedcPwm ();
+    void attach (uint8_t channel, uint8_t pin);
+    void write (uint8_t channel, uint16_t duty);
+    // Detaches the pin, which the channel keeps its duty through
+    void release (uint8_t channel);
+    void hold (uint8_t channel);
+  protected:
+    // Pin attached to each channel, for reattaching
+    uint8_t pins[LEDC_PWM_CHANNELS];
+};
+
+#endif
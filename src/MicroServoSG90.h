@@ -7,11 +7,15 @@
 #define SG90_PULSE_WIDTH_MAX 2050
 #define SG90_INVERTED 0
 #define SG90_FULL_MOVE_DELAY_MS 200
+// Dynamics model defaults, in position units per second (and per second^2).
+// A full 1000 unit move takes about 207 ms. Tune with `ServoModel::fit`
+#define SG90_SLEW 6000
+#define SG90_ACCEL 150000
 
 class MicroServoSG90: public Servo {
   public:
-    MicroServoSG90 (uint8_t pin, uint8_t channel)
-    : Servo(SG90_PULSE_WIDTH_MIN, SG90_PULSE_WIDTH_MAX, SG90_FULL_MOVE_DELAY_MS, pin, channel, SG90_INVERTED) {}
+    MicroServoSG90 (uint8_t pin, uint8_t channel, PwmOutput *output)
+    : Servo(SG90_PULSE_WIDTH_MIN, SG90_PULSE_WIDTH_MAX, SG90_FULL_MOVE_DELAY_MS, SG90_SLEW, SG90_ACCEL, pin, channel, SG90_INVERTED, output) {}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "Pca9685Pwm.h"
+
+Pca9685Pwm::Pca9685Pwm (I2cBus *bus, uint8_t address) {
+  this->bus = bus;
+  this->address = address;
+  this->ready = 0;
+  this->releasedMask = 0;
+  this->dirtyMask = 0;
+  this->bursts = 0;
+  for (uint8_t channel = 0; channel < PCA9685_CHANNELS; channel++) {
+    offCounts[channel] = 0;
+  }
+}
+
+uint8_t Pca9685Pwm::begin () {
+  // The prescale can only be set while asleep. The outputs are all rewritten
+  // below, so there's no need to restart them after waking
+  uint8_t mode = PCA9685_MODE1_AI | PCA9685_MODE1_SLEEP;
+  uint8_t prescale = PCA9685_PRESCALE;
+  uint8_t mode2 = PCA9685_MODE2_OUTDRV;
+  if (!bus->writeRegisters(address, PCA9685_MODE1, &mode, 1)) {
+    return 0;
+  }
+  bus->writeRegisters(address, PCA9685_PRE_SCALE, &prescale, 1);
+  bus->writeRegisters(address, PCA9685_MODE2, &mode2, 1);
+  mode = PCA9685_MODE1_AI;
+  bus->writeRegisters(address, PCA9685_MODE1, &mode, 1);
+  ready = 1;
+  dirtyMask = 0xffff;
+  flush();
+  return 1;
+}
+
+void Pca9685Pwm::attach (uint8_t channel, uint8_t pin) {
+  // Channels are the expander's own outputs, so there's nothing to set up
+  (void)channel;
+  (void)pin;
+}
+
+void Pca9685Pwm::write (uint8_t channel, uint16_t duty) {
+  if (channel >= PCA9685_CHANNELS) {
+    return;
+  }
+  offCounts[channel] = duty >> (PWM_DUTY_BITS - PCA9685_DUTY_BITS);
+  dirtyMask |= (1 << channel);
+}
+
+void Pca9685Pwm::release (uint8_t channel) {
+  if (channel >= PCA9685_CHANNELS) {
+    return;
+  }
+  releasedMask |= (1 << channel);
+  dirtyMask |= (1 << channel);
+}
+
+void Pca9685Pwm::hold (uint8_t channel) {
+  if (channel >= PCA9685_CHANNELS) {
+    return;
+  }
+  releasedMask &= ~(1 << channel);
+  dirtyMask |= (1 << channel);
+}
+
+void Pca9685Pwm::flush () {
+  if (!ready || dirtyMask == 0) {
+    return;
+  }
+  // One auto-incrementing write from the first changed channel to the last.
+  // Unchanged channels in between are rewritten as they were, which costs
+  // less than a transaction of their own
+  uint8_t firstChannel = 0;
+  while (!(dirtyMask & (1 << firstChannel))) {
+    firstChannel++;
+  }
+  uint8_t lastChannel = PCA9685_CHANNELS - 1;
+  while (!(dirtyMask & (1 << lastChannel))) {
+    lastChannel--;
+  }
+  uint8_t data[4 * PCA9685_CHANNELS];
+  uint8_t length = 0;
+  for (uint8_t channel = firstChannel; channel <= lastChannel; channel++) {
+    data[length++] = 0;
+    data[length++] = 0;
+    data[length++] = offCounts[channel] & 0xff;
+    data[length++] = (offCounts[channel] >> 8) | ((releasedMask & (1 << channel)) ? PCA9685_FULL_OFF : 0);
+  }
+  bursts++;
+  // Left dirty on failure, to go again next tick
+  if (bus->writeRegisters(address, PCA9685_LED0_ON_L + 4 * firstChannel, data, length)) {
+    dirtyMask = 0;
+  }
+}
+
+uint32_t Pca9685Pwm::burstCount () {
+  return bursts;
+}
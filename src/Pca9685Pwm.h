@@ -0,0 +1,62 @@
+#ifndef PCA9685_PWM_H
+#define PCA9685_PWM_H
+
+#include <stdint.h>
+#include "I2cBus.h"
+#include "PwmOutput.h"
+
+#define PCA9685_CHANNELS 16
+// Default address, with no address pins tied high
+#define PCA9685_DEFAULT_ADDRESS 0x40
+
+#define PCA9685_MODE1 0x00
+#define PCA9685_MODE2 0x01
+// First of 4 registers per channel: ON_L, ON_H, OFF_L, OFF_H
+#define PCA9685_LED0_ON_L 0x06
+#define PCA9685_PRE_SCALE 0xfe
+
+#define PCA9685_MODE1_AI 0x20
+#define PCA9685_MODE1_SLEEP 0x10
+#define PCA9685_MODE2_OUTDRV 0x04
+// In OFF_H, holds the output low regardless of the counts
+#define PCA9685_FULL_OFF 0x10
+
+// Internal oscillator, and the prescale that divides it down to servo pulses
+#define PCA9685_OSC_HZ 25000000
+#define PCA9685_PRESCALE ((PCA9685_OSC_HZ + 2048L * PWM_SERVO_HZ) / (4096L * PWM_SERVO_HZ) - 1)
+// Counts per period
+#define PCA9685_DUTY_BITS 12
+
+// PWM from a PCA9685-style I2C expander, 16 channels per chip. Writes are held
+// back until `flush`, which sends every channel changed since in one burst,
+// so a tick costs one transaction however many servos moved. Each chip is its
+// own instance, numbering its channels from 0; channels past the last are
+// ignored
+class Pca9685Pwm: public PwmOutput {
+  public:
+    Pca9685Pwm (I2cBus *bus, uint8_t address = PCA9685_DEFAULT_ADDRESS);
+    // Set the expander up for servo pulses, then send every channel. Writes
+    // before this are held. Call once the bus is up. Returns 0 if the
+    // expander didn't answer
+    uint8_t begin ();
+    void attach (uint8_t channel, uint8_t pin);
+    void write (uint8_t channel, uint16_t duty);
+    // Holds the output low, keeping its duty
+    void release (uint8_t channel);
+    void hold (uint8_t channel);
+    void flush ();
+    // Transactions sent, for benchmarking
+    uint32_t burstCount ();
+  protected:
+    I2cBus *bus;
+    uint8_t address;
+    uint8_t ready;
+    // Off count of each channel, with every pulse starting at count 0
+    uint16_t offCounts[PCA9685_CHANNELS];
+    // One bit per channel
+    uint16_t releasedMask;
+    uint16_t dirtyMask;
+    uint32_t bursts;
+};
+
+#endif
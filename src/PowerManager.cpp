@@ -0,0 +1,72 @@
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "PowerManager.h"
+
+PowerManager::PowerManager (uint8_t wakePin) {
+  this->wakePin = wakePin;
+  this->idleMillis = POWER_IDLE_DEFAULT_MS;
+  // The actuator carries the head, so only the jaw lets go by default
+  this->flags = POWER_RELEASE_JAW;
+  this->idle = 0;
+  this->wakePending = 0;
+  this->lastActivityMillis = 0;
+  this->waitStartMicros = 0;
+}
+
+uint8_t PowerManager::activity () {
+  lastActivityMillis = millis();
+  if (!idle) {
+    return 0;
+  }
+  idle = 0;
+  wakePending = 1;
+  return 1;
+}
+
+uint8_t PowerManager::isIdle () {
+  return idle;
+}
+
+uint8_t PowerManager::update (uint8_t busy) {
+  if (busy) {
+    lastActivityMillis = millis();
+  }
+  if (idle || idleMillis == 0 || (millis() - lastActivityMillis) < idleMillis) {
+    return 0;
+  }
+  idle = 1;
+  return 1;
+}
+
+uint8_t PowerManager::sleeps () {
+  return (flags & POWER_LIGHT_SLEEP) && (flags & POWER_RELEASE_ALL) == POWER_RELEASE_ALL;
+}
+
+uint8_t PowerManager::wait (uint32_t maxMillis) {
+  waitStartMicros = micros();
+  if (!sleeps()) {
+    // Blocking the task lets the idle task halt the CPU until the next tick
+    delay(min(maxMillis, (uint32_t)POWER_DOZE_MS));
+    return 0;
+  }
+  if (maxMillis == 0) {
+    return 0;
+  }
+  esp_sleep_enable_timer_wakeup((uint64_t)min(maxMillis, (uint32_t)POWER_SLEEP_SLICE_MS) * 1000);
+  gpio_wakeup_enable((gpio_num_t)wakePin, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  // Anything still in the TX FIFO would be cut off
+  Serial.flush();
+  esp_light_sleep_start();
+  return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO;
+}
+
+uint8_t PowerManager::takeWake () {
+  uint8_t pending = wakePending;
+  wakePending = 0;
+  return pending;
+}
+
+unsigned long PowerManager::sinceWaitMicros () {
+  return micros() - waitStartMicros;
+}
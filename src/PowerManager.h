@@ -0,0 +1,58 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <stdint.h>
+#include "Arduino.h"
+
+// Default quiet period before going idle
+#define POWER_IDLE_DEFAULT_MS 60000
+// Longest doze between input checks while idle, which bounds wake latency
+#define POWER_DOZE_MS 10
+// Longest light sleep while idle. The button wakes it sooner
+#define POWER_SLEEP_SLICE_MS 1000
+
+// Idle behaviour flags
+#define POWER_RELEASE_ACTUATOR 0x01
+#define POWER_RELEASE_JAW 0x02
+#define POWER_LIGHT_SLEEP 0x04
+// Servo PWM stops in light sleep, so it is only used with both of these
+#define POWER_RELEASE_ALL (POWER_RELEASE_ACTUATOR | POWER_RELEASE_JAW)
+
+// Decides when the head has been quiet long enough to go idle, and waits
+// between input checks in the lowest power state allowed while idle. What
+// to power down on entering idle is left to the caller
+class PowerManager {
+  public:
+    // Quiet period before going idle, 0 to never go idle
+    uint32_t idleMillis;
+    // Idle behaviour flags
+    uint8_t flags;
+
+    PowerManager (uint8_t wakePin);
+    // Note activity. Returns 1 if this wakes from idle
+    uint8_t activity ();
+    // Indicates idle
+    uint8_t isIdle ();
+    // Go idle once quiet for `idleMillis`, counting time spent `busy` as
+    // activity. Returns 1 on going idle
+    uint8_t update (uint8_t busy);
+    // Indicates waits are spent in light sleep: it is allowed, and every
+    // servo is released so none loses its pulses
+    uint8_t sleeps ();
+    // Wait for up to `maxMillis`, dozing or in light sleep per `flags`.
+    // Returns 1 if woken early by the button
+    uint8_t wait (uint32_t maxMillis);
+    // Indicates a wake from idle hasn't been reported yet, clearing it
+    uint8_t takeWake ();
+    // Time since the latest wait began, which bounds how long input has been waiting
+    unsigned long sinceWaitMicros ();
+  protected:
+    // Pin which reads low while the button is pressed
+    uint8_t wakePin;
+    uint8_t idle;
+    uint8_t wakePending;
+    unsigned long lastActivityMillis;
+    unsigned long waitStartMicros;
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include <string.h>
+#include "PresetStore.h"
+
+#ifndef ARDUINO
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define PRESET_STORE_SIZE (PRESET_SLOT_COUNT * PRESET_SLOT_SIZE)
+
+PresetStore::PresetStore () {
+  this->base = NULL;
+  this->writeSlot = -1;
+#ifdef ARDUINO
+  this->partition = NULL;
+#else
+  this->fd = -1;
+#endif
+}
+
+#ifdef ARDUINO
+
+uint8_t PresetStore::begin (const char *path) {
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, PRESET_PARTITION_LABEL);
+  if (partition == NULL || partition->size < PRESET_STORE_SIZE) {
+    return 0;
+  }
+  const void *mapped;
+  if (esp_partition_mmap(partition, 0, PRESET_STORE_SIZE, SPI_FLASH_MMAP_DATA, &mapped, &mapHandle) != ESP_OK) {
+    return 0;
+  }
+  base = (const uint8_t *)mapped;
+  return 1;
+}
+
+uint8_t PresetStore::erase (uint32_t offset) {
+  // Flash writes flush any cached copy of the mapped range
+  return esp_partition_erase_range(partition, offset, PRESET_SLOT_SIZE) == ESP_OK;
+}
+
+uint8_t PresetStore::write (uint32_t offset, const void *bytes, uint16_t size) {
+  return esp_partition_write(partition, offset, bytes, size) == ESP_OK;
+}
+
+#else
+
+uint8_t PresetStore::begin (const char *path) {
+  fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return 0;
+  }
+  // A new file starts out erased, like blank flash
+  off_t size = lseek(fd, 0, SEEK_END);
+  if (size < PRESET_STORE_SIZE) {
+    if (ftruncate(fd, PRESET_STORE_SIZE) != 0) {
+      return 0;
+    }
+    for (uint32_t offset = size - (size % PRESET_SLOT_SIZE); offset < PRESET_STORE_SIZE; offset += PRESET_SLOT_SIZE) {
+      erase(offset);
+    }
+  }
+  void *mapped = mmap(NULL, PRESET_STORE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    return 0;
+  }
+  base = (const uint8_t *)mapped;
+  return 1;
+}
+
+uint8_t PresetStore::erase (uint32_t offset) {
+  uint8_t blank[PRESET_SLOT_SIZE];
+  memset(blank, 0xff, sizeof(blank));
+  return pwrite(fd, blank, sizeof(blank), offset) == (ssize_t)sizeof(blank);
+}
+
+uint8_t PresetStore::write (uint32_t offset, const void *bytes, uint16_t size) {
+  // Like flash, writing can only clear bits
+  uint8_t merged[PRESET_SLOT_SIZE];
+  if (size > sizeof(merged) || pread(fd, merged, size, offset) != size) {
+    return 0;
+  }
+  for (uint16_t i = 0; i < size; i++) {
+    merged[i] &= ((const uint8_t *)bytes)[i];
+  }
+  return pwrite(fd, merged, size, offset) == size;
+}
+
+#endif
+
+int PresetStore::find (const char *name) {
+  // A longer name could only match a stored one by being cut
+  if (strlen(name) >= PRESET_NAME_SIZE) {
+    return -1;
+  }
+  for (int slot = 0; slot < PRESET_SLOT_COUNT; slot++) {
+    const PresetHeader *presetHeader = header(slot);
+    if (presetHeader != NULL && strncmp(presetHeader->name, name, PRESET_NAME_SIZE) == 0) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
+const PresetHeader *PresetStore::header (int slot) {
+  if (base == NULL || slot < 0 || slot >= PRESET_SLOT_COUNT) {
+    return NULL;
+  }
+  const PresetHeader *presetHeader = (const PresetHeader *)(base + slot * PRESET_SLOT_SIZE);
+  return (presetHeader->magic == PRESET_MAGIC) ? presetHeader : NULL;
+}
+
+const uint8_t *PresetStore::data (int slot) {
+  return base + slot * PRESET_SLOT_SIZE + sizeof(PresetHeader);
+}
+
+int PresetStore::create (const char *name, PresetType type) {
+  discardPending();
+  if (base == NULL || strlen(name) >= PRESET_NAME_SIZE) {
+    return -1;
+  }
+  for (int slot = 0; slot < PRESET_SLOT_COUNT; slot++) {
+    if (header(slot) == NULL) {
+      if (!erase(slot * PRESET_SLOT_SIZE)) {
+        return -1;
+      }
+      writeSlot = slot;
+      memset(&writeHeader, 0, sizeof(writeHeader));
+      writeHeader.magic = PRESET_MAGIC;
+      writeHeader.type = type;
+      strncpy(writeHeader.name, name, PRESET_NAME_SIZE - 1);
+      return slot;
+    }
+  }
+  return -1;
+}
+
+uint8_t PresetStore::append (const void *bytes, uint16_t size) {
+  if (writeSlot < 0 || writeHeader.length + size > PRESET_DATA_SIZE) {
+    return 0;
+  }
+  if (!write(writeSlot * PRESET_SLOT_SIZE + sizeof(PresetHeader) + writeHeader.length, bytes, size)) {
+    return 0;
+  }
+  writeHeader.length += size;
+  return 1;
+}
+
+uint16_t PresetStore::pending () {
+  return (writeSlot < 0) ? 0 : writeHeader.length;
+}
+
+uint8_t PresetStore::commit () {
+  if (writeSlot < 0) {
+    return 0;
+  }
+  // Replace any older preset of the same name once the new one is complete
+  int oldSlot = find(writeHeader.name);
+  uint8_t written = write(writeSlot * PRESET_SLOT_SIZE, &writeHeader, sizeof(writeHeader));
+  if (written && oldSlot >= 0) {
+    remove(oldSlot);
+  }
+  writeSlot = -1;
+  return written;
+}
+
+void PresetStore::discardPending () {
+  // Header was never written, so the slot still reads as free
+  writeSlot = -1;
+}
+
+uint8_t PresetStore::remove (int slot) {
+  if (header(slot) == NULL) {
+    return 0;
+  }
+  uint32_t cleared = 0;
+  return write(slot * PRESET_SLOT_SIZE, &cleared, sizeof(cleared));
+}
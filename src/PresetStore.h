@@ -0,0 +1,89 @@
+#ifndef PRESET_STORE_H
+#define PRESET_STORE_H
+
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include "esp_partition.h"
+#endif
+
+// Number of presets stored at once
+#define PRESET_SLOT_COUNT 32
+// Each preset takes one flash sector, so it can be erased on its own
+#define PRESET_SLOT_SIZE 4096
+// Max name length, including terminator
+#define PRESET_NAME_SIZE 12
+// Marks a slot holding a complete preset. Rewritten as 0 to delete it
+#define PRESET_MAGIC 0x54455250
+// Flash partition holding the store on the device. The default partition
+// schemes reserve this for SPIFFS, which is unused here
+#define PRESET_PARTITION_LABEL "spiffs"
+// File holding the store on the host
+#define PRESET_HOST_PATH "presets.bin"
+
+typedef enum {
+  PRESET_EXPRESSION = 1,
+  PRESET_SEQUENCE = 2
+} PresetType;
+
+// Start of each slot, written last so a preset only appears once complete
+typedef struct {
+  uint32_t magic;
+  uint8_t type;
+  uint8_t reserved;
+  // Bytes of data following the header
+  uint16_t length;
+  char name[PRESET_NAME_SIZE];
+} PresetHeader;
+
+#define PRESET_DATA_SIZE (PRESET_SLOT_SIZE - (int)sizeof(PresetHeader))
+
+// Named presets stored in flash, one per sector. Flash is memory-mapped, so
+// presets are read in place without copying them to RAM. On the host, a
+// plain file stands in for the partition
+class PresetStore {
+  public:
+    PresetStore ();
+    // Map the store. `path` is only used on the host. Returns 0 on failure
+    uint8_t begin (const char *path = PRESET_HOST_PATH);
+    // Slot of the named preset, or -1 if not found. Names are up to
+    // PRESET_NAME_SIZE - 1 characters
+    int find (const char *name);
+    // Header of the preset in a slot, or NULL if empty
+    const PresetHeader *header (int slot);
+    // Data of the preset in a slot, pointing into mapped flash
+    const uint8_t *data (int slot);
+    // Start writing a preset into a free slot. It replaces any preset of the
+    // same name on `commit`. Returns the slot, or -1 if none are free or
+    // the name is too long
+    int create (const char *name, PresetType type);
+    // Append to the preset being written. Returns 0 if it doesn't fit
+    uint8_t append (const void *bytes, uint16_t size);
+    // Bytes appended so far
+    uint16_t pending ();
+    // Finish the preset being written, making it visible
+    uint8_t commit ();
+    // Abandon the preset being written
+    void discardPending ();
+    // Delete the preset in a slot
+    uint8_t remove (int slot);
+  protected:
+    // Start of the mapped store, or NULL before `begin`
+    const uint8_t *base;
+    // Preset being written, or -1
+    int writeSlot;
+    PresetHeader writeHeader;
+#ifdef ARDUINO
+    const esp_partition_t *partition;
+    spi_flash_mmap_handle_t mapHandle;
+#else
+    int fd;
+#endif
+
+    // Set a sector to all 1 bits
+    uint8_t erase (uint32_t offset);
+    // Write bytes, which can only clear bits, as on flash
+    uint8_t write (uint32_t offset, const void *bytes, uint16_t size);
+};
+
+#endif
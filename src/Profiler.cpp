@@ -0,0 +1,97 @@
+#include "Profiler.h"
+
+Profiler::Profiler (const char *name, const char *unit) {
+  this->name = name;
+  this->unit = unit;
+  this->probeCount = 0;
+  this->dropped = 0;
+}
+
+int Profiler::probe (const char *probeName) {
+  for (int i = 0; i < probeCount; i++) {
+    if (strcmp(probes[i].name, probeName) == 0) {
+      return i;
+    }
+  }
+  if (probeCount >= PROFILER_MAX_PROBES) {
+    return -1;
+  }
+  ProfilerProbe *newProbe = &probes[probeCount];
+  newProbe->name = probeName;
+  newProbe->count = 0;
+  newProbe->min = UINT32_MAX;
+  newProbe->max = 0;
+  newProbe->total = 0;
+  return probeCount++;
+}
+
+void Profiler::record (int probeIdx, uint32_t value) {
+  if (probeIdx < 0 || probeIdx >= probeCount) {
+    dropped++;
+    return;
+  }
+  ProfilerProbe *p = &probes[probeIdx];
+  p->count++;
+  p->total += value;
+  if (value < p->min) {
+    p->min = value;
+  }
+  if (value > p->max) {
+    p->max = value;
+  }
+}
+
+void Profiler::record (const char *probeName, uint32_t value) {
+  record(probe(probeName), value);
+}
+
+const ProfilerProbe *Profiler::get (int probeIdx) {
+  if (probeIdx < 0 || probeIdx >= probeCount) {
+    return NULL;
+  }
+  return &probes[probeIdx];
+}
+
+uint8_t Profiler::size () {
+  return probeCount;
+}
+
+uint32_t Profiler::getDropped () {
+  return dropped;
+}
+
+void Profiler::clear () {
+  probeCount = 0;
+  dropped = 0;
+}
+
+void Profiler::printJson (Print *out) {
+  out->print("{\"bench\":\"");
+  out->print(name);
+  out->print("\",\"unit\":\"");
+  out->print(unit);
+  out->print("\",\"results\":[");
+  for (int i = 0; i < probeCount; i++) {
+    ProfilerProbe *p = &probes[i];
+    if (i > 0) {
+      out->print(",");
+    }
+    out->print("{\"name\":\"");
+    out->print(p->name);
+    out->print("\",\"n\":");
+    out->print(p->count);
+    out->print(",\"min\":");
+    out->print((p->count > 0) ? p->min : 0);
+    out->print(",\"max\":");
+    out->print(p->max);
+    out->print(",\"avg\":");
+    out->print((p->count > 0) ? (uint32_t)(p->total / p->count) : 0);
+    out->print("}");
+  }
+  out->print("]");
+  if (dropped > 0) {
+    out->print(",\"dropped\":");
+    out->print(dropped);
+  }
+  out->print("}\n");
+}
@@ -0,0 +1,54 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include "Arduino.h"
+
+// Max number of distinct probes tracked at once. The parser benchmark needs
+// one per entry in its command list
+#define PROFILER_MAX_PROBES 64
+
+typedef struct {
+  const char *name;
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t total;
+} ProfilerProbe;
+
+// Collects min/max/average samples for named probes and reports them
+// as JSON. Probe names are not copied, so they must be string literals
+// or otherwise outlive the profiler. Samples for probes past the limit are
+// counted as dropped, and the count is reported with the results
+class Profiler {
+  public:
+    // Name of this result set, reported in the JSON output
+    const char *name;
+    // Unit of recorded values, reported in the JSON output
+    const char *unit;
+
+    Profiler (const char *name, const char *unit = "us");
+    // Find or create a probe by name. Returns -1 if no probes are left, and
+    // samples recorded against -1 are counted as dropped
+    int probe (const char *probeName);
+    // Record a sample against a probe index
+    void record (int probeIdx, uint32_t value);
+    // Record a sample against a probe name
+    void record (const char *probeName, uint32_t value);
+    // Get probe by index
+    const ProfilerProbe *get (int probeIdx);
+    // Number of probes in use
+    uint8_t size ();
+    // Number of samples that had no probe to go to
+    uint32_t getDropped ();
+    // Remove all probes
+    void clear ();
+    // Write all probes as a single line JSON object
+    void printJson (Print *out);
+  protected:
+    ProfilerProbe probes[PROFILER_MAX_PROBES];
+    uint8_t probeCount;
+    uint32_t dropped;
+};
+
+#endif
@@ -0,0 +1,17 @@
+#include <stddef.h>
+#include "PwmOutput.h"
+
+PwmOutput *PwmOutput::first = NULL;
+
+PwmOutput::PwmOutput () {
+  this->next = first;
+  first = this;
+}
+
+void PwmOutput::flush () {}
+
+void PwmOutput::flushAll () {
+  for (PwmOutput *output = first; output != NULL; output = output->next) {
+    output->flush();
+  }
+}
@@ -0,0 +1,35 @@
+#ifndef PWM_OUTPUT_H
+#define PWM_OUTPUT_H
+
+#include <stdint.h>
+
+// Servo pulse frequency
+#define PWM_SERVO_HZ 50
+// Bit resolution of duties passed to `write`, over one full period
+#define PWM_DUTY_BITS 14
+
+// Drives a set of PWM channels at `PWM_SERVO_HZ`, for servos. Backends may
+// hold writes back and send them together in `flush`, so every backend in
+// use is flushed once per update tick with `flushAll`
+class PwmOutput {
+  public:
+    PwmOutput ();
+    // Set up a channel on a GPIO pin. Backends with their own pins ignore `pin`
+    virtual void attach (uint8_t channel, uint8_t pin) = 0;
+    // Set the duty of a channel, in counts of `PWM_DUTY_BITS`
+    virtual void write (uint8_t channel, uint16_t duty) = 0;
+    // Stop pulses on a channel, keeping its duty
+    virtual void release (uint8_t channel) = 0;
+    // Resume pulses on a channel at its last duty
+    virtual void hold (uint8_t channel) = 0;
+    // Send any writes held back
+    virtual void flush ();
+    // Flush every backend
+    static void flushAll ();
+  protected:
+    // Every backend constructed, so they can all be flushed
+    static PwmOutput *first;
+    PwmOutput *next;
+};
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef SCRIPT_CODE_H
+#define SCRIPT_CODE_H
+
+#include <stdint.h>
+
+// Bytecode of on-device scripts, shared by the interpreter and the host
+// assembler. Each instruction is an opcode byte followed by a fixed number of
+// operand bytes, given by `scriptOperandCount`. 16 bit operands are little
+// endian. Addresses are byte offsets into the script
+
+// Bytes of bytecode per script, which also bounds addresses to one byte
+#define SCRIPT_SIZE 128
+// Loop counters per script
+#define SCRIPT_REGISTERS 4
+
+typedef enum {
+  // Stop the script
+  SCRIPT_OP_END = 0x00,
+  // [ms 16]: wait that long
+  SCRIPT_OP_WAIT = 0x01,
+  // [ms 16]: wait a random time up to that long
+  SCRIPT_OP_WAIT_RANDOM = 0x02,
+  // [event]: wait for the event to happen
+  SCRIPT_OP_WAIT_EVENT = 0x03,
+  // [mask]: wait until the `SCRIPT_DONE_*` outputs in the mask are still
+  SCRIPT_OP_WAIT_DONE = 0x04,
+  // [address]
+  SCRIPT_OP_JUMP = 0x05,
+  // [percent, address]: jump with that chance, otherwise carry on
+  SCRIPT_OP_CHANCE = 0x06,
+  // [register, value 16]
+  SCRIPT_OP_SET = 0x07,
+  // [register, address]: count the register down, jumping until it reaches 0
+  SCRIPT_OP_LOOP = 0x08,
+  // [value]: send V/EMT>[slot],[value] to the host
+  SCRIPT_OP_EMIT = 0x09,
+  // [shape, side]: draw a `SCRIPT_SHAPE_*`
+  SCRIPT_OP_EYE_SHAPE = 0x10,
+  // [red, green, blue, side]
+  SCRIPT_OP_EYE_COLOR = 0x11,
+  // [x, y, side], signed, where 100 is the outer ring
+  SCRIPT_OP_EYE_GAZE = 0x12,
+  // [animation, step ms, side]: start a `SCRIPT_ANIM_*`
+  SCRIPT_OP_EYE_ANIM = 0x13,
+  SCRIPT_OP_JAW_OPEN = 0x20,
+  SCRIPT_OP_JAW_CLOSE = 0x21,
+  // [red, green, blue]
+  SCRIPT_OP_JAW_COLOR = 0x22,
+  // [speed]
+  SCRIPT_OP_JAW_SPEED = 0x23,
+  // [lift 16, tilt 16], signed, as `Actuator::pose`
+  SCRIPT_OP_POSE = 0x30,
+  // [left 16, right 16]
+  SCRIPT_OP_MOVE = 0x31,
+  // [speed]
+  SCRIPT_OP_ACT_SPEED = 0x32,
+  SCRIPT_OP_COUNT
+} ScriptOp;
+
+typedef enum {
+  SCRIPT_EVENT_NONE,
+  // Button pressed, then released, after debouncing
+  SCRIPT_EVENT_PRESS,
+  SCRIPT_EVENT_RELEASE,
+  // Eye animation finished on both eyes
+  SCRIPT_EVENT_ANIMATION,
+  // Timer period of the script elapsed
+  SCRIPT_EVENT_TIMER,
+  SCRIPT_EVENT_COUNT
+} ScriptEvent;
+
+typedef enum {
+  SCRIPT_SHAPE_OPEN,
+  SCRIPT_SHAPE_CLOSE,
+  SCRIPT_SHAPE_DILATE,
+  SCRIPT_SHAPE_CONTRACT,
+  SCRIPT_SHAPE_SQUINT,
+  SCRIPT_SHAPE_DEAD,
+  SCRIPT_SHAPE_LOOK_UP,
+  SCRIPT_SHAPE_LOOK_DOWN,
+  SCRIPT_SHAPE_LOOK_LEFT,
+  SCRIPT_SHAPE_LOOK_RIGHT,
+  SCRIPT_SHAPE_COUNT
+} ScriptShape;
+
+typedef enum {
+  SCRIPT_ANIM_BLINK,
+  SCRIPT_ANIM_RAINBOW,
+  SCRIPT_ANIM_DOT_UP,
+  SCRIPT_ANIM_DOT_DOWN,
+  SCRIPT_ANIM_LINE_UP,
+  SCRIPT_ANIM_LINE_DOWN,
+  SCRIPT_ANIM_COUNT
+} ScriptAnimation;
+
+// Same order as the host `Side`
+typedef enum {
+  SCRIPT_SIDE_BOTH,
+  SCRIPT_SIDE_LEFT,
+  SCRIPT_SIDE_RIGHT,
+  SCRIPT_SIDE_COUNT
+} ScriptSide;
+
+#define SCRIPT_DONE_EYES 0x01
+#define SCRIPT_DONE_JAW 0x02
+#define SCRIPT_DONE_ACTUATOR 0x04
+
+// Operand bytes following each opcode, or -1 for opcodes that don't exist
+static inline int scriptOperandCount (uint8_t op) {
+  switch (op) {
+    case SCRIPT_OP_END:
+    case SCRIPT_OP_JAW_OPEN:
+    case SCRIPT_OP_JAW_CLOSE:
+      return 0;
+    case SCRIPT_OP_WAIT_EVENT:
+    case SCRIPT_OP_WAIT_DONE:
+    case SCRIPT_OP_JUMP:
+    case SCRIPT_OP_EMIT:
+    case SCRIPT_OP_JAW_SPEED:
+    case SCRIPT_OP_ACT_SPEED:
+      return 1;
+    case SCRIPT_OP_WAIT:
+    case SCRIPT_OP_WAIT_RANDOM:
+    case SCRIPT_OP_CHANCE:
+    case SCRIPT_OP_LOOP:
+    case SCRIPT_OP_EYE_SHAPE:
+      return 2;
+    case SCRIPT_OP_SET:
+    case SCRIPT_OP_EYE_GAZE:
+    case SCRIPT_OP_EYE_ANIM:
+    case SCRIPT_OP_JAW_COLOR:
+      return 3;
+    case SCRIPT_OP_EYE_COLOR:
+    case SCRIPT_OP_POSE:
+    case SCRIPT_OP_MOVE:
+      return 4;
+    default:
+      return -1;
+  }
+}
+
+// Check a script can run safely: every opcode exists, every operand is in
+// range, and every jump lands on an instruction. Returns -1 if it is sound,
+// otherwise the offset of the first bad instruction
+static inline int scriptVerify (const uint8_t *code, uint8_t length) {
+  uint8_t starts[SCRIPT_SIZE / 8] = {0};
+  if (length > SCRIPT_SIZE) {
+    return SCRIPT_SIZE;
+  }
+  int pc = 0;
+  while (pc < length) {
+    const uint8_t *operands = code + pc + 1;
+    int count = scriptOperandCount(code[pc]);
+    if (count < 0 || pc + 1 + count > length) {
+      return pc;
+    }
+    uint8_t valid = 1;
+    switch (code[pc]) {
+      case SCRIPT_OP_WAIT_EVENT:
+        valid = (operands[0] > SCRIPT_EVENT_NONE && operands[0] < SCRIPT_EVENT_COUNT);
+        break;
+      case SCRIPT_OP_WAIT_DONE:
+        valid = (operands[0] != 0 && operands[0] <= (SCRIPT_DONE_EYES | SCRIPT_DONE_JAW | SCRIPT_DONE_ACTUATOR));
+        break;
+      case SCRIPT_OP_CHANCE:
+        valid = (operands[0] <= 100);
+        break;
+      case SCRIPT_OP_SET:
+      case SCRIPT_OP_LOOP:
+        valid = (operands[0] < SCRIPT_REGISTERS);
+        break;
+      case SCRIPT_OP_EYE_SHAPE:
+        valid = (operands[0] < SCRIPT_SHAPE_COUNT && operands[1] < SCRIPT_SIDE_COUNT);
+        break;
+      case SCRIPT_OP_EYE_COLOR:
+        valid = (operands[3] < SCRIPT_SIDE_COUNT);
+        break;
+      case SCRIPT_OP_EYE_GAZE:
+        valid = (operands[2] < SCRIPT_SIDE_COUNT);
+        break;
+      case SCRIPT_OP_EYE_ANIM:
+        valid = (operands[0] < SCRIPT_ANIM_COUNT && operands[2] < SCRIPT_SIDE_COUNT);
+        break;
+    }
+    if (!valid) {
+      return pc;
+    }
+    starts[pc / 8] |= (1 << (pc % 8));
+    pc += 1 + count;
+  }
+  // Jumps are checked once every instruction start is known
+  for (pc = 0; pc < length; pc += 1 + scriptOperandCount(code[pc])) {
+    int target = -1;
+    if (code[pc] == SCRIPT_OP_JUMP) {
+      target = code[pc + 1];
+    } else if (code[pc] == SCRIPT_OP_CHANCE || code[pc] == SCRIPT_OP_LOOP) {
+      target = code[pc + 2];
+    }
+    if (target >= 0 && (target >= length || !(starts[target / 8] & (1 << (target % 8))))) {
+      return pc;
+    }
+  }
+  return -1;
+}
+
+#endif
@@ -0,0 +1,362 @@
+#include "ScriptVM.h"
+#include "Clock.h"
+
+// Seed scrambling constants, from the golden ratio
+#define SCRIPT_SEED_MIX 0x9e3779b9
+#define SCRIPT_SEED_MULT 2654435761u
+
+void (*ScriptVM::emitHook)(uint8_t slot, uint8_t value) = NULL;
+
+static uint16_t operand16 (const uint8_t *operands) {
+  return operands[0] | (operands[1] << 8);
+}
+
+ScriptVM::ScriptVM (Eyes *eyes, Jaw *jaw, Actuator *actuator) {
+  this->eyes = eyes;
+  this->jaw = jaw;
+  this->actuator = actuator;
+  this->randomState = 1;
+  this->wasAnimating = 0;
+  memset(scripts, 0, sizeof(scripts));
+}
+
+void ScriptVM::seed (uint32_t seed) {
+  if (seed == 0) {
+    seed = micros();
+  }
+  randomState = (seed ^ SCRIPT_SEED_MIX) * SCRIPT_SEED_MULT;
+  randomState = (randomState != 0) ? randomState : 1;
+}
+
+uint8_t ScriptVM::load (uint8_t slot, const uint8_t *code, uint8_t length) {
+  if (slot >= SCRIPT_SLOTS || scripts[slot].length + length > SCRIPT_SIZE) {
+    return 0;
+  }
+  Script *script = scripts + slot;
+  script->state = SCRIPT_STOPPED;
+  script->verified = 0;
+  memcpy(script->code + script->length, code, length);
+  script->length += length;
+  return 1;
+}
+
+void ScriptVM::clear (uint8_t slot) {
+  if (slot < SCRIPT_SLOTS) {
+    memset(scripts + slot, 0, sizeof(Script));
+  }
+}
+
+int ScriptVM::bind (uint8_t slot, ScriptEvent trigger, uint16_t periodMillis) {
+  if (slot >= SCRIPT_SLOTS) {
+    return 0;
+  }
+  Script *script = scripts + slot;
+  if (!script->verified) {
+    int error = scriptVerify(script->code, script->length);
+    if (error >= 0) {
+      return error;
+    }
+    script->verified = 1;
+  }
+  script->trigger = trigger;
+  script->periodMillis = periodMillis;
+  script->nextTimerMillis = Clock::nowMillis() + periodMillis;
+  return -1;
+}
+
+int ScriptVM::start (uint8_t slot) {
+  if (slot >= SCRIPT_SLOTS) {
+    return 0;
+  }
+  Script *script = scripts + slot;
+  if (!script->verified) {
+    int error = scriptVerify(script->code, script->length);
+    if (error >= 0) {
+      return error;
+    }
+    script->verified = 1;
+  }
+  script->pc = 0;
+  memset(script->registers, 0, sizeof(script->registers));
+  script->state = SCRIPT_RUNNING;
+  return -1;
+}
+
+void ScriptVM::stop (uint8_t slot) {
+  if (slot < SCRIPT_SLOTS) {
+    scripts[slot].state = SCRIPT_STOPPED;
+  }
+}
+
+void ScriptVM::stopAll () {
+  for (uint8_t slot = 0; slot < SCRIPT_SLOTS; slot++) {
+    stop(slot);
+  }
+}
+
+uint8_t ScriptVM::signal (ScriptEvent event) {
+  uint8_t count = 0;
+  for (uint8_t slot = 0; slot < SCRIPT_SLOTS; slot++) {
+    Script *script = scripts + slot;
+    if (script->state == SCRIPT_WAIT_EVENT && script->waitArg == event) {
+      script->state = SCRIPT_RUNNING;
+      count++;
+    } else if (script->state == SCRIPT_STOPPED && script->trigger == event && script->verified) {
+      start(slot);
+      count++;
+    }
+  }
+  return count;
+}
+
+uint8_t ScriptVM::update () {
+  unsigned long now = Clock::nowMillis();
+  uint8_t animating = eyes->isAnimating();
+  if (wasAnimating && !animating) {
+    signal(SCRIPT_EVENT_ANIMATION);
+  }
+  wasAnimating = animating;
+
+  uint8_t acted = 0;
+  for (uint8_t slot = 0; slot < SCRIPT_SLOTS; slot++) {
+    Script *script = scripts + slot;
+    if (script->trigger == SCRIPT_EVENT_TIMER && script->periodMillis > 0
+        && (long)(now - script->nextTimerMillis) >= 0) {
+      // Periods missed while the script was still running are skipped
+      script->nextTimerMillis = now + script->periodMillis;
+      if (script->state == SCRIPT_STOPPED) {
+        start(slot);
+      }
+    }
+    if (script->state == SCRIPT_WAIT_TIME && (long)(now - script->waitUntilMillis) >= 0) {
+      script->state = SCRIPT_RUNNING;
+    } else if (script->state == SCRIPT_WAIT_DONE && isDone(script->waitArg)) {
+      script->state = SCRIPT_RUNNING;
+    }
+    if (script->state == SCRIPT_RUNNING) {
+      acted |= run(slot);
+    }
+  }
+  return acted;
+}
+
+uint8_t ScriptVM::isBusy () {
+  for (uint8_t slot = 0; slot < SCRIPT_SLOTS; slot++) {
+    if (scripts[slot].state == SCRIPT_RUNNING || scripts[slot].state == SCRIPT_WAIT_DONE) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int32_t ScriptVM::millisUntilNext () {
+  unsigned long now = Clock::nowMillis();
+  int32_t next = -1;
+  for (uint8_t slot = 0; slot < SCRIPT_SLOTS; slot++) {
+    Script *script = scripts + slot;
+    int32_t until = -1;
+    if (script->state == SCRIPT_RUNNING) {
+      until = 0;
+    } else if (script->state == SCRIPT_WAIT_TIME) {
+      until = max((int32_t)(script->waitUntilMillis - now), (int32_t)0);
+    } else if (script->trigger == SCRIPT_EVENT_TIMER && script->periodMillis > 0) {
+      until = max((int32_t)(script->nextTimerMillis - now), (int32_t)0);
+    }
+    if (until >= 0 && (next < 0 || until < next)) {
+      next = until;
+    }
+  }
+  return next;
+}
+
+const Script *ScriptVM::getScript (uint8_t slot) {
+  return (slot < SCRIPT_SLOTS) ? scripts + slot : NULL;
+}
+
+uint8_t ScriptVM::run (uint8_t slot) {
+  Script *script = scripts + slot;
+  uint8_t acted = 0;
+  // Operands were range checked by `scriptVerify` before the script started
+  for (int steps = 0; steps < SCRIPT_TICK_BUDGET; steps++) {
+    if (script->pc >= script->length) {
+      script->state = SCRIPT_STOPPED;
+      return acted;
+    }
+    uint8_t op = script->code[script->pc];
+    const uint8_t *operands = script->code + script->pc + 1;
+    script->pc += 1 + scriptOperandCount(op);
+    Eye *targets[2];
+    switch (op) {
+      case SCRIPT_OP_END:
+        script->state = SCRIPT_STOPPED;
+        return acted;
+      case SCRIPT_OP_WAIT:
+        script->waitUntilMillis = Clock::nowMillis() + operand16(operands);
+        script->state = SCRIPT_WAIT_TIME;
+        return acted;
+      case SCRIPT_OP_WAIT_RANDOM:
+        script->waitUntilMillis = Clock::nowMillis() + nextRandom() % (operand16(operands) + 1);
+        script->state = SCRIPT_WAIT_TIME;
+        return acted;
+      case SCRIPT_OP_WAIT_EVENT:
+        script->waitArg = operands[0];
+        script->state = SCRIPT_WAIT_EVENT;
+        return acted;
+      case SCRIPT_OP_WAIT_DONE:
+        // Outputs this script just started are already busy, so this only
+        // goes on straight away if there was nothing to wait for
+        if (!isDone(operands[0])) {
+          script->waitArg = operands[0];
+          script->state = SCRIPT_WAIT_DONE;
+          return acted;
+        }
+        break;
+      case SCRIPT_OP_JUMP:
+        script->pc = operands[0];
+        break;
+      case SCRIPT_OP_CHANCE:
+        if (nextRandom() % 100 < operands[0]) {
+          script->pc = operands[1];
+        }
+        break;
+      case SCRIPT_OP_SET:
+        script->registers[operands[0]] = operand16(operands + 1);
+        break;
+      case SCRIPT_OP_LOOP:
+        if (script->registers[operands[0]] > 0 && --script->registers[operands[0]] > 0) {
+          script->pc = operands[1];
+        }
+        break;
+      case SCRIPT_OP_EMIT:
+        if (emitHook != NULL) {
+          emitHook(slot, operands[0]);
+        }
+        break;
+      case SCRIPT_OP_EYE_SHAPE:
+        for (uint8_t i = 0, count = eyeTargets(operands[1], targets); i < count; i++) {
+          drawShape(targets[i], operands[0]);
+        }
+        acted = 1;
+        break;
+      case SCRIPT_OP_EYE_COLOR:
+        for (uint8_t i = 0, count = eyeTargets(operands[3], targets); i < count; i++) {
+          targets[i]->setColor(CRGB(operands[0], operands[1], operands[2]));
+        }
+        acted = 1;
+        break;
+      case SCRIPT_OP_EYE_GAZE:
+        for (uint8_t i = 0, count = eyeTargets(operands[2], targets); i < count; i++) {
+          targets[i]->gaze((int8_t)operands[0], (int8_t)operands[1], 1);
+        }
+        acted = 1;
+        break;
+      case SCRIPT_OP_EYE_ANIM:
+        for (uint8_t i = 0, count = eyeTargets(operands[2], targets); i < count; i++) {
+          startAnimation(targets[i], operands[0], operands[1]);
+        }
+        acted = 1;
+        break;
+      case SCRIPT_OP_JAW_OPEN:
+        jaw->open();
+        acted = 1;
+        break;
+      case SCRIPT_OP_JAW_CLOSE:
+        jaw->close();
+        acted = 1;
+        break;
+      case SCRIPT_OP_JAW_COLOR:
+        jaw->setColor(CRGB(operands[0], operands[1], operands[2]));
+        acted = 1;
+        break;
+      case SCRIPT_OP_JAW_SPEED:
+        jaw->jawServo->setSpeed(operands[0]);
+        break;
+      case SCRIPT_OP_POSE:
+        actuator->pose((int16_t)operand16(operands), (int16_t)operand16(operands + 2));
+        acted = 1;
+        break;
+      case SCRIPT_OP_MOVE:
+        actuator->moveBoth(operand16(operands), operand16(operands + 2));
+        acted = 1;
+        break;
+      case SCRIPT_OP_ACT_SPEED:
+        actuator->setSpeed(operands[0]);
+        break;
+    }
+  }
+  return acted;
+}
+
+uint8_t ScriptVM::isDone (uint8_t mask) {
+  return !(((mask & SCRIPT_DONE_EYES) && eyes->isAnimating())
+    || ((mask & SCRIPT_DONE_JAW) && jaw->isMoving())
+    || ((mask & SCRIPT_DONE_ACTUATOR) && actuator->isMoving()));
+}
+
+uint32_t ScriptVM::nextRandom () {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+uint8_t ScriptVM::eyeTargets (uint8_t side, Eye **targets) {
+  targets[0] = ((side == SCRIPT_SIDE_RIGHT) ? eyes->rightEye : eyes->leftEye);
+  targets[1] = eyes->rightEye;
+  return (side == SCRIPT_SIDE_BOTH) ? 2 : 1;
+}
+
+void ScriptVM::drawShape (Eye *eye, uint8_t shape) {
+  switch (shape) {
+    case SCRIPT_SHAPE_OPEN:
+      eye->open(1);
+      break;
+    case SCRIPT_SHAPE_CLOSE:
+      eye->close(1);
+      break;
+    case SCRIPT_SHAPE_DILATE:
+      eye->dilate(1);
+      break;
+    case SCRIPT_SHAPE_CONTRACT:
+      eye->contract(1);
+      break;
+    case SCRIPT_SHAPE_SQUINT:
+      eye->squint(1);
+      break;
+    case SCRIPT_SHAPE_DEAD:
+      eye->dead(1);
+      break;
+    case SCRIPT_SHAPE_LOOK_UP:
+      eye->lookUp(1);
+      break;
+    case SCRIPT_SHAPE_LOOK_DOWN:
+      eye->lookDown(1);
+      break;
+    case SCRIPT_SHAPE_LOOK_LEFT:
+      eye->lookLeft(1);
+      break;
+    case SCRIPT_SHAPE_LOOK_RIGHT:
+      eye->lookRight(1);
+      break;
+  }
+}
+
+// A step delay of 0 picks the animation's default
+void ScriptVM::startAnimation (Eye *eye, uint8_t animation, uint16_t stepDelayMillis) {
+  switch (animation) {
+    case SCRIPT_ANIM_BLINK:
+      eye->blink(stepDelayMillis ? stepDelayMillis : EYE_BLINK_STEP_DELAY_MS);
+      break;
+    case SCRIPT_ANIM_RAINBOW:
+      eye->rainbow(stepDelayMillis ? stepDelayMillis : EYE_RAINBOW_STEP_DELAY_MS);
+      break;
+    case SCRIPT_ANIM_DOT_UP:
+    case SCRIPT_ANIM_DOT_DOWN:
+      eye->spiral(stepDelayMillis ? stepDelayMillis : EYES_SPIRAL_STEP_DELAY_MS, animation == SCRIPT_ANIM_DOT_UP, 1);
+      break;
+    case SCRIPT_ANIM_LINE_UP:
+    case SCRIPT_ANIM_LINE_DOWN:
+      eye->spiral(stepDelayMillis ? stepDelayMillis : EYES_SPIRAL_STEP_DELAY_MS, animation == SCRIPT_ANIM_LINE_UP, 0);
+      break;
+  }
+}
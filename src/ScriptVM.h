@@ -0,0 +1,100 @@
+#ifndef SCRIPT_VM_H
+#define SCRIPT_VM_H
+
+#include <stdint.h>
+#include "Arduino.h"
+#include "ScriptCode.h"
+#include "Eyes.h"
+#include "Jaw.h"
+#include "Actuator.h"
+
+// Scripts loaded at once, each with its own trigger and state
+#define SCRIPT_SLOTS 4
+// Instructions one script may run per tick. A script still going after that
+// carries on next tick, so a long loop can't stall the main loop
+#define SCRIPT_TICK_BUDGET 32
+
+typedef enum {
+  SCRIPT_STOPPED,
+  SCRIPT_RUNNING,
+  SCRIPT_WAIT_TIME,
+  SCRIPT_WAIT_EVENT,
+  SCRIPT_WAIT_DONE
+} ScriptState;
+
+typedef struct {
+  uint8_t code[SCRIPT_SIZE];
+  uint8_t length;
+  // Set once the code has passed `scriptVerify`
+  uint8_t verified;
+  // Event that starts the script when stopped
+  uint8_t trigger;
+  uint16_t periodMillis;
+  unsigned long nextTimerMillis;
+  ScriptState state;
+  uint8_t pc;
+  // Event or `SCRIPT_DONE_*` mask being waited on
+  uint8_t waitArg;
+  unsigned long waitUntilMillis;
+  uint16_t registers[SCRIPT_REGISTERS];
+} Script;
+
+// Runs small bytecode scripts on the device, so reactions to the button,
+// animations and timers don't wait on a round trip through the host. Scripts
+// only reach the head through the instructions in `ScriptCode.h`, are
+// verified before they run, and each runs at most `SCRIPT_TICK_BUDGET`
+// instructions per call to `update`
+class ScriptVM {
+  public:
+    // Called for each EMIT instruction, if set
+    static void (*emitHook)(uint8_t slot, uint8_t value);
+
+    ScriptVM (Eyes *eyes, Jaw *jaw, Actuator *actuator);
+    // Seed the random waits and branches. A seed of 0 picks one
+    void seed (uint32_t seed = 0);
+    // Append bytecode to a script, stopping it. Returns 0 if it doesn't fit
+    uint8_t load (uint8_t slot, const uint8_t *code, uint8_t length);
+    // Stop a script and empty it
+    void clear (uint8_t slot);
+    // Start a script on an event, or on a timer every `periodMillis`.
+    // Returns -1 if the script is sound, or the offset of the first bad
+    // instruction, in which case it isn't bound
+    int bind (uint8_t slot, ScriptEvent trigger, uint16_t periodMillis = 0);
+    // Start or restart a script. Returns as `bind`
+    int start (uint8_t slot);
+    void stop (uint8_t slot);
+    void stopAll ();
+    // Start stopped scripts bound to an event, and wake scripts waiting on
+    // it. Returns the number started or woken
+    uint8_t signal (ScriptEvent event);
+    // Run every script that is due. Returns 1 if any of them drew or moved
+    uint8_t update ();
+    // Indicates a script is running or waiting on outputs. Scripts waiting
+    // on time or events aren't busy
+    uint8_t isBusy ();
+    // Time until the next timed wait or timer ends, or -1 if there are none
+    int32_t millisUntilNext ();
+    const Script *getScript (uint8_t slot);
+  protected:
+    Eyes *eyes;
+    Jaw *jaw;
+    Actuator *actuator;
+    Script scripts[SCRIPT_SLOTS];
+    uint32_t randomState;
+    // Eye animation state at the last update, to catch it finishing
+    uint8_t wasAnimating;
+
+    // Run one script until it waits, stops or uses its budget. Returns 1 if
+    // it drew or moved
+    uint8_t run (uint8_t slot);
+    // Indicates the outputs in a `SCRIPT_DONE_*` mask are all still
+    uint8_t isDone (uint8_t mask);
+    // Next number from the PRNG (xorshift32)
+    uint32_t nextRandom ();
+    // Fill `targets` with the eyes on a `ScriptSide`, returning how many
+    uint8_t eyeTargets (uint8_t side, Eye **targets);
+    void drawShape (Eye *eye, uint8_t shape);
+    void startAnimation (Eye *eye, uint8_t animation, uint16_t stepDelayMillis);
+};
+
+#endif
@@ -1,12 +1,23 @@
 #include "esp32-hal.h"
 #include "Servo.h"
+#include "Clock.h"
 
-Servo::Servo (uint16_t minPulseWidth, uint16_t maxPulseWidth, int fullMoveDelay, uint8_t pin, uint8_t channel, uint8_t inverted) {
+void (*Servo::pollHook)() = NULL;
+uint8_t Servo::halted = 0;
+
+Servo::Servo (uint16_t minPulseWidth, uint16_t maxPulseWidth, int fullMoveDelay, int slew, int accel, uint8_t pin, uint8_t channel, uint8_t inverted, PwmOutput *output)
+: model(slew, accel) {
   this->pin = pin;
   this->channel = channel;
+  this->output = output;
   this->fullMoveDelay = fullMoveDelay;
 
   this->speed = 100; // start at max speed
+  this->pulseWidth = 0;
+  this->released = 0;
+  this->currentPos = 0;
+  this->nextPos = 0;
+  this->lastModelMicros = 0;
 
   // `fullMoveDelay` is measured in milliseconds, but here is being assigned to a microseconds
   // value. This is because:
@@ -22,73 +33,111 @@ Servo::Servo (uint16_t minPulseWidth, uint16_t maxPulseWidth, int fullMoveDelay,
     this->startPulseWidth = maxPulseWidth;
     this->endPulseWidth = minPulseWidth;
   }
+  updatePulseScale();
 
   // Set up 50Hz PWM wave for given channel
-  ledcSetup(channel, 50, SERVO_MAX_BIT_NUM);
-  // Attach to GPIO
-  ledcAttachPin(pin, channel);
+  output->attach(channel, pin);
 }
 
 void Servo::setPulseWidth (int width) {
-  ledcWrite(channel, width);
+  hold();
+  if (width == pulseWidth) {
+    return;
+  }
+  pulseWidth = width;
+  output->write(channel, width);
 }
 
 void Servo::setPos (int pos, uint8_t blocking) {
-  // No movement needed for equal position
-  if (pos == currentPos) {
+  // No movement while halted or for equal position
+  if (halted || (pos << SERVO_POS_FRAC_BITS) == currentPos) {
     return;
   }
   // For max speed, assign pulse width immediately
   if (speed == 100) {
-    // Map position to pulse width
-    int pulseWidth = map(pos, 0, 1000, startPulseWidth, endPulseWidth);
-    setPulseWidth(pulseWidth);
+    startInstantMove(pos);
     if (blocking) {
-      waitMovement(pos);
+      waitMovement();
     }
-    currentPos = pos;
-    nextPos = pos;
   } else {
     // Otherwise, begin a directed async move
-    nextPos = pos;
+    startAsyncMove(pos << SERVO_POS_FRAC_BITS, incrementDelay);
     if (blocking) {
       // If blocking, wait while updating position
       while (currentPos != nextPos) {
+        poll();
         update();
       }
     }
   }
 }
 
+void Servo::setPosTimed (int pos, int durationMillis) {
+  if (halted) {
+    return;
+  }
+  ServoPos target = pos << SERVO_POS_FRAC_BITS;
+  long distance = abs(target - currentPos);
+  if (distance == 0) {
+    nextPos = target;
+    return;
+  }
+  startAsyncMove(target, max(minIncrDelayMicros, (int)((((long)durationMillis * 1000) << SERVO_POS_FRAC_BITS) / distance)));
+}
+
 void Servo::moveStart (uint8_t blocking) {
-  setPulseWidth(startPulseWidth);
+  if (halted) {
+    return;
+  }
+  startInstantMove(0);
   if (blocking) {
-    waitMovement(0);
+    waitMovement();
   }
-  currentPos = 0;
 }
 
 void Servo::moveEnd (uint8_t blocking) {
-  setPulseWidth(endPulseWidth);
+  if (halted) {
+    return;
+  }
+  startInstantMove(1000);
   if (blocking) {
-    waitMovement(1000);
+    waitMovement();
   }
-  currentPos = 1000;
 }
 
 void Servo::invert () {
   int temp = startPulseWidth;
   startPulseWidth = endPulseWidth;
   endPulseWidth = temp;
+  updatePulseScale();
 }
 
 int Servo::calcDelay (int newPos) {
-  int delta = abs(newPos - currentPos);
-  return (fullMoveDelay * delta) / 1000;
+  updateModel();
+  return model.travelMillis(abs(newPos - getEstimatedPos()));
 }
 
 int Servo::getPos () {
-  return currentPos;
+  return (currentPos + SERVO_POS_ONE / 2) >> SERVO_POS_FRAC_BITS;
+}
+
+int Servo::getEstimatedPos () {
+  return (int)(model.getPos() + 0.5f);
+}
+
+int Servo::getTarget () {
+  return (nextPos + SERVO_POS_ONE / 2) >> SERVO_POS_FRAC_BITS;
+}
+
+int Servo::remainingMillis () {
+  if (requiresUpdate()) {
+    return (int)((((long)abs(nextPos - currentPos) * moveIncrDelay) >> SERVO_POS_FRAC_BITS) / 1000);
+  }
+  return calcDelay(getPos());
+}
+
+int Servo::getPulseWidth () {
+  return pulseWidth;
 }
 
 void Servo::setSpeed (uint8_t newSpeed) {
@@ -105,22 +154,111 @@ uint8_t Servo::requiresUpdate () {
 }
 
 void Servo::update () {
-  // If current position needs to move, check time asynchronously and move one
-  // 1/1000th in that direction if the delay is sufficient
+  // If current position needs to move, check time asynchronously and take
+  // every 1/16th step toward the target that has come due
   if (currentPos != nextPos) {
-    if ((micros() - lastTimeMicros) > incrementDelay) {
-      if (currentPos > nextPos) {
-        currentPos--;
-      } else {
-        currentPos++;
-      }
-      int pulseWidth = map(currentPos, 0, 1000, startPulseWidth, endPulseWidth);
-      setPulseWidth(pulseWidth);
-      lastTimeMicros = micros();
+    unsigned long now = Clock::nowMicros();
+    if ((now - lastTimeMicros) < (unsigned long)moveStepMicros) {
+      return;
+    }
+    // Catch up at most one whole unit per call, so a stalled loop slows the
+    // move down rather than making it jump
+    ServoPos steps = 0;
+    do {
+      steps++;
+      lastTimeMicros += moveStepMicros;
+    } while (steps < SERVO_POS_ONE && (now - lastTimeMicros) >= (unsigned long)moveStepMicros);
+    if ((now - lastTimeMicros) >= (unsigned long)moveStepMicros) {
+      lastTimeMicros = now;
     }
+    if (currentPos > nextPos) {
+      currentPos = max(currentPos - steps, nextPos);
+    } else {
+      currentPos = min(currentPos + steps, nextPos);
+    }
+    writePos(currentPos);
   }
+  updateModel();
+}
+
+uint8_t Servo::isMoving () {
+  updateModel();
+  return requiresUpdate() || !model.settled((float)currentPos / SERVO_POS_ONE);
 }
 
-void Servo::waitMovement (int newPos) {
-  delay(calcDelay(newPos));
-}
\ No newline at end of file
+void Servo::stop () {
+  // Pulse width may be ahead of the servo, so hold where it is estimated to be
+  updateModel();
+  currentPos = (ServoPos)(model.getPos() * SERVO_POS_ONE + 0.5f);
+  nextPos = currentPos;
+  writePos(currentPos);
+}
+
+void Servo::updateModel () {
+  unsigned long now = Clock::nowMicros();
+  model.step((float)currentPos / SERVO_POS_ONE, now - lastModelMicros);
+  lastModelMicros = now;
+}
+
+void Servo::release () {
+  if (!released) {
+    output->release(channel);
+    released = 1;
+  }
+}
+
+void Servo::hold () {
+  if (released) {
+    // The channel kept its duty, so this resumes the same pulses
+    output->hold(channel);
+    released = 0;
+  }
+}
+
+uint8_t Servo::isReleased () {
+  return released;
+}
+
+void Servo::poll () {
+  // Blocking moves only make progress if their writes go out, and if time
+  // moves on under a virtual clock
+  PwmOutput::flushAll();
+  Clock::step();
+  if (pollHook != NULL) {
+    pollHook();
+  }
+}
+
+void Servo::startInstantMove (int pos) {
+  // Settle the model against the old target before switching to the new one
+  updateModel();
+  currentPos = pos << SERVO_POS_FRAC_BITS;
+  nextPos = currentPos;
+  writePos(currentPos);
+}
+
+void Servo::startAsyncMove (ServoPos pos, int incrDelayMicros) {
+  // Time the first step from now, unless a move is already underway
+  if (!requiresUpdate()) {
+    lastTimeMicros = Clock::nowMicros();
+  }
+  nextPos = pos;
+  moveIncrDelay = incrDelayMicros;
+  moveStepMicros = max(incrDelayMicros >> SERVO_POS_FRAC_BITS, 1);
+}
+
+void Servo::updatePulseScale () {
+  // The only divide; per-step conversion is then a multiply and shift
+  pulseScale = ((int32_t)(endPulseWidth - startPulseWidth) * (1 << SERVO_SCALE_FRAC_BITS)) / SERVO_POS_MAX;
+}
+
+void Servo::writePos (ServoPos pos) {
+  // Round to the nearest duty count
+  setPulseWidth(startPulseWidth + ((pos * pulseScale + (1 << (SERVO_SCALE_FRAC_BITS - 1))) >> SERVO_SCALE_FRAC_BITS));
+}
+
+void Servo::waitMovement () {
+  while (isMoving() && !halted) {
+    poll();
+  }
+}
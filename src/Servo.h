@@ -3,21 +3,40 @@
 
 #include <stdint.h>
 #include "Arduino.h"
+#include "ServoModel.h"
+#include "PwmOutput.h"
 
 // Bit resolution for PWM duty cycle
-#define SERVO_MAX_BIT_NUM 14
+#define SERVO_MAX_BIT_NUM PWM_DUTY_BITS
 // Mulitplier used to calc the max delay in lower-speed move operatoin, where
 // maxDelay == (minDelay * MAX_DELAY_MULT).
 // The max delay should be < 16383, which is the max supported value for delayMicroseconds().
 // Min delay is calculated from fullMoveDelay
 #define SERVO_MAX_DELAY_MULT 5
+// Fractional bits of a fixed-point position. Async moves step in 1/16ths of a
+// position unit, which is finer than one PWM duty count on every servo here
+#define SERVO_POS_FRAC_BITS 4
+#define SERVO_POS_ONE (1 << SERVO_POS_FRAC_BITS)
+#define SERVO_POS_MAX (1000 * SERVO_POS_ONE)
+// Fractional bits of the precomputed position to pulse width scale
+#define SERVO_SCALE_FRAC_BITS 16
+
+// Fixed-point position on range [0, SERVO_POS_MAX]
+typedef int32_t ServoPos;
 
 class Servo {
   public:
+    // Called repeatedly while any servo blocks, so urgent input can be read mid-move
+    static void (*pollHook)();
+    // Set to stop all servos from accepting moves, and to break out of blocking calls
+    static uint8_t halted;
+
     // GPIO pin to bind to
     uint8_t pin;
     // PWM channel
     uint8_t channel;
+    // Backend driving the channel
+    PwmOutput *output;
 
     // Pulse width for "start" position, aka most CCW position. Represented as position 0
     int startPulseWidth;
@@ -31,21 +50,35 @@ class Servo {
     int minIncrDelayMicros;
     int maxIncrDelayMicros;
 
-    Servo (uint16_t minPulseWidth, uint16_t maxPulseWidth, int fullMoveDelay, uint8_t pin, uint8_t channel, uint8_t inverted);
-    // Set the pulse width directly
+    // Estimate of the horn's actual position, lagging the pulse width written
+    ServoModel model;
+
+    Servo (uint16_t minPulseWidth, uint16_t maxPulseWidth, int fullMoveDelay, int slew, int accel, uint8_t pin, uint8_t channel, uint8_t inverted, PwmOutput *output);
+    // Set the pulse width directly. Writes that wouldn't change the duty are skipped
     void setPulseWidth (int width);
     // Set a position between 0 and 1000
     void setPos (int pos, uint8_t blocking = 0);
+    // Move asynchronously to a position, arriving after `durationMillis` (or as
+    // soon as possible if that would exceed max speed). Ignores the set speed
+    void setPosTimed (int pos, int durationMillis);
     // Move to start position
     void moveStart (uint8_t blocking = 0);
     // Move to end position
     void moveEnd (uint8_t blocking = 0);
     // Invert start and end directions
     void invert ();
-    // Calculate movement delay
+    // Calculate movement delay from the estimated position, per the dynamics model
     int calcDelay (int newPos);
-    // Get current pos
+    // Get current pos, as last written
     int getPos ();
+    // Get the estimated actual pos
+    int getEstimatedPos ();
+    // Get target pos of current move
+    int getTarget ();
+    // Approximate time left to reach the target
+    int remainingMillis ();
+    // Get the last pulse width written
+    int getPulseWidth ();
     // Set the current speed
     void setSpeed (uint8_t newSpeed);
     // Get the current speed
@@ -54,23 +87,62 @@ class Servo {
     uint8_t requiresUpdate ();
     // Update servo position (for async lower-speed moves)
     void update ();
+    // Indicates the servo is still travelling, including full-speed moves that
+    // are written instantly but take time to complete
+    uint8_t isMoving ();
+    // Freeze at the estimated position
+    void stop ();
+    // Bring the dynamics model up to date
+    void updateModel ();
+    // Stop sending pulses, so the servo stops driving and holds no torque
+    void release ();
+    // Resume sending pulses at the last pulse width. Any write also does this
+    void hold ();
+    // Indicates pulses are stopped
+    uint8_t isReleased ();
+    // Send held-back PWM writes, step a virtual clock, then run the poll hook,
+    // if set
+    static void poll ();
   protected:
-    // Current position on range [0, 1000]
-    int currentPos;
+    // Current position, fixed-point
+    ServoPos currentPos;
+
+    // Last pulse width written to the PWM channel
+    int pulseWidth;
+    // Indicates the pin is detached from the PWM channel
+    uint8_t released;
 
     // Tracks speed to drive movement changes by on range [0,100]
     uint8_t speed;
     // Tracks single increment delay (aka 1/speed)
     int incrementDelay;
+    // Increment delay of the async move in progress
+    int moveIncrDelay;
+
+    // Tracks next desired position for async moves, fixed-point
+    ServoPos nextPos;
 
-    // Tracks next desired pulse width for async moves
-    int nextPos;
+    // Pulse width change per fixed-point position step, scaled by 2^SERVO_SCALE_FRAC_BITS
+    int32_t pulseScale;
+    // Time between fixed-point steps of the async move in progress
+    int moveStepMicros;
 
     // Tracks the last time recorded for async events
     unsigned long lastTimeMicros;
 
-    // Calculate approximate movement delay
-    void waitMovement (int newPos);
+    // Last time the dynamics model was updated
+    unsigned long lastModelMicros;
+
+    // Write a position immediately
+    void startInstantMove (int pos);
+    // Begin an async move to a fixed-point position at `incrDelayMicros` per unit
+    void startAsyncMove (ServoPos pos, int incrDelayMicros);
+    // Recalculate the pulse width scale after the end points change
+    void updatePulseScale ();
+    // Write the pulse width for a fixed-point position
+    void writePos (ServoPos pos);
+    // Wait until the servo is estimated to have arrived. Returns early if halted
+    void waitMovement ();
 };
 
 #endif
\ No newline at end of file
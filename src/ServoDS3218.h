@@ -7,11 +7,15 @@
 #define DS3218_PULSE_WIDTH_MAX 2150
 #define DS3218_INVERTED 0
 #define DS3218_FULL_MOVE_DELAY_MS 1800
+// Dynamics model defaults, in position units per second (and per second^2).
+// A full 1000 unit move takes about 1817 ms. Tune with `ServoModel::fit`
+#define DS3218_SLEW 600
+#define DS3218_ACCEL 4000
 
 class ServoDS3218: public Servo {
   public:
-    ServoDS3218 (uint8_t pin, uint8_t channel)
-    : Servo(DS3218_PULSE_WIDTH_MIN, DS3218_PULSE_WIDTH_MAX, DS3218_FULL_MOVE_DELAY_MS, pin, channel, DS3218_INVERTED) {}
+    ServoDS3218 (uint8_t pin, uint8_t channel, PwmOutput *output)
+    : Servo(DS3218_PULSE_WIDTH_MIN, DS3218_PULSE_WIDTH_MAX, DS3218_FULL_MOVE_DELAY_MS, DS3218_SLEW, DS3218_ACCEL, pin, channel, DS3218_INVERTED, output) {}
 };
 
 #endif
\ No newline at end of file
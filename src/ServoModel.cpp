@@ -0,0 +1,142 @@
+#include <math.h>
+#include "ServoModel.h"
+
+// Search ranges for fitting, in position units per second (and per second^2)
+#define SERVO_FIT_SLEW_MIN 10.0f
+#define SERVO_FIT_SLEW_MAX 100000.0f
+#define SERVO_FIT_ACCEL_MIN 10.0f
+#define SERVO_FIT_ACCEL_MAX 10000000.0f
+// Coarse grid points per parameter, before refining
+#define SERVO_FIT_GRID_SIZE 32
+// Refinement passes, each halving the step
+#define SERVO_FIT_REFINE_STEPS 24
+
+ServoModel::ServoModel (float slew, float accel) {
+  this->slew = slew;
+  this->accel = accel;
+  this->pos = 0;
+  this->velocity = 0;
+}
+
+uint32_t ServoModel::travelMillis (int distance) {
+  if (distance <= 0) {
+    return 0;
+  }
+  // Below `rampDistance` the servo never reaches full slew before braking
+  float rampDistance = (slew * slew) / accel;
+  float seconds;
+  if (distance >= rampDistance) {
+    seconds = distance / slew + slew / accel;
+  } else {
+    seconds = 2 * sqrtf(distance / accel);
+  }
+  return (uint32_t)(seconds * 1000 + 0.5f);
+}
+
+void ServoModel::reset (float pos) {
+  this->pos = pos;
+  this->velocity = 0;
+}
+
+void ServoModel::step (float target, uint32_t dtMicros) {
+  if (dtMicros > SERVO_MODEL_MAX_GAP_MICROS) {
+    dtMicros = SERVO_MODEL_MAX_GAP_MICROS;
+  }
+  while (dtMicros > 0 && (pos != target || velocity != 0)) {
+    uint32_t stepMicros = (dtMicros < SERVO_MODEL_STEP_MICROS) ? dtMicros : SERVO_MODEL_STEP_MICROS;
+    dtMicros -= stepMicros;
+    float dt = stepMicros * 1e-6f;
+    float error = target - pos;
+    // Fastest speed from which the servo can still brake to rest at the target
+    float desired = fminf(slew, sqrtf(2 * accel * fabsf(error)));
+    if (error < 0) {
+      desired = -desired;
+    }
+    float maxChange = accel * dt;
+    velocity = fmaxf(velocity - maxChange, fminf(velocity + maxChange, desired));
+    float move = velocity * dt;
+    // Arrive rather than overshoot on the last step
+    if ((error >= 0 && move >= error) || (error <= 0 && move <= error)) {
+      pos = target;
+      velocity = 0;
+    } else {
+      pos += move;
+    }
+  }
+}
+
+float ServoModel::getPos () {
+  return pos;
+}
+
+float ServoModel::getVelocity () {
+  return velocity;
+}
+
+uint8_t ServoModel::settled (float target) {
+  return fabsf(target - pos) <= SERVO_MODEL_SETTLE_UNITS;
+}
+
+float ServoModel::fitError (const ServoTiming *samples, int count, float slew, float accel) {
+  ServoModel model(slew, accel);
+  float total = 0;
+  for (int i = 0; i < count; i++) {
+    float error = (float)model.travelMillis(samples[i].distance) - samples[i].millis;
+    total += error * error;
+  }
+  return total;
+}
+
+uint8_t ServoModel::fit (const ServoTiming *samples, int count, float *slew, float *accel) {
+  // Slew and accel can only be told apart with at least two distances
+  int distinct = 0;
+  for (int i = 1; i < count && !distinct; i++) {
+    distinct = (samples[i].distance != samples[0].distance);
+  }
+  if (!distinct) {
+    return 0;
+  }
+  // Both parameters span several orders of magnitude, so search in log space:
+  // first a coarse grid, then a pattern search around the best point
+  float logSlewMin = logf(SERVO_FIT_SLEW_MIN);
+  float logAccelMin = logf(SERVO_FIT_ACCEL_MIN);
+  float slewStep = (logf(SERVO_FIT_SLEW_MAX) - logSlewMin) / (SERVO_FIT_GRID_SIZE - 1);
+  float accelStep = (logf(SERVO_FIT_ACCEL_MAX) - logAccelMin) / (SERVO_FIT_GRID_SIZE - 1);
+  float bestLogSlew = logSlewMin;
+  float bestLogAccel = logAccelMin;
+  float bestError = INFINITY;
+  for (int i = 0; i < SERVO_FIT_GRID_SIZE; i++) {
+    for (int j = 0; j < SERVO_FIT_GRID_SIZE; j++) {
+      float logSlew = logSlewMin + i * slewStep;
+      float logAccel = logAccelMin + j * accelStep;
+      float error = fitError(samples, count, expf(logSlew), expf(logAccel));
+      if (error < bestError) {
+        bestError = error;
+        bestLogSlew = logSlew;
+        bestLogAccel = logAccel;
+      }
+    }
+  }
+  for (int step = 0; step < SERVO_FIT_REFINE_STEPS; step++) {
+    uint8_t improved = 1;
+    while (improved) {
+      improved = 0;
+      for (int dir = 0; dir < 4; dir++) {
+        float logSlew = bestLogSlew + ((dir == 0) ? slewStep : (dir == 1) ? -slewStep : 0);
+        float logAccel = bestLogAccel + ((dir == 2) ? accelStep : (dir == 3) ? -accelStep : 0);
+        float error = fitError(samples, count, expf(logSlew), expf(logAccel));
+        if (error < bestError) {
+          bestError = error;
+          bestLogSlew = logSlew;
+          bestLogAccel = logAccel;
+          improved = 1;
+        }
+      }
+    }
+    slewStep /= 2;
+    accelStep /= 2;
+  }
+  *slew = expf(bestLogSlew);
+  *accel = expf(bestLogAccel);
+  return 1;
+}
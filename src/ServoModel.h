@@ -0,0 +1,56 @@
+#ifndef SERVO_MODEL_H
+#define SERVO_MODEL_H
+
+#include <stdint.h>
+
+// The estimate is integrated in steps of at most this long
+#define SERVO_MODEL_STEP_MICROS 1000
+// Longest gap integrated at once. Any move has finished well within this
+#define SERVO_MODEL_MAX_GAP_MICROS 3000000
+// Distance from the target, in position units, at which the servo counts as arrived
+#define SERVO_MODEL_SETTLE_UNITS 2
+
+// One measured move, from the pulse width being written to the horn coming to rest
+typedef struct {
+  // Distance travelled, in position units
+  uint16_t distance;
+  // Travel time
+  uint16_t millis;
+} ServoTiming;
+
+// Estimates where a servo horn actually is, given the positions written to it,
+// assuming it accelerates and brakes at a fixed rate up to a max slew rate.
+// Independent of Arduino, so calibration can also run on a host
+class ServoModel {
+  public:
+    // Max speed, in position units per second
+    float slew;
+    // Acceleration and braking, in position units per second^2
+    float accel;
+
+    ServoModel (float slew, float accel);
+    // Time to travel `distance` units from rest to rest
+    uint32_t travelMillis (int distance);
+    // Jump the estimate to `pos`, at rest
+    void reset (float pos);
+    // Advance the estimate by `dtMicros` toward `target`
+    void step (float target, uint32_t dtMicros);
+    // Get the estimated position
+    float getPos ();
+    // Get the estimated velocity, in position units per second
+    float getVelocity ();
+    // Indicates the estimate has arrived at `target`
+    uint8_t settled (float target);
+
+    // Fit slew and accel to timings measured on a real servo. Needs moves of
+    // at least two different distances. Returns 0 if the samples can't be fit
+    static uint8_t fit (const ServoTiming *samples, int count, float *slew, float *accel);
+  private:
+    float pos;
+    float velocity;
+
+    // Squared error in ms^2 of a candidate model against measured timings
+    static float fitError (const ServoTiming *samples, int count, float slew, float accel);
+};
+
+#endif
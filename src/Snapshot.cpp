@@ -0,0 +1,70 @@
+#include <string.h>
+#include "Snapshot.h"
+
+// Unchanged bytes worth sending to avoid starting a new run
+#define SNAPSHOT_DELTA_MAX_GAP 2
+
+static_assert(sizeof(AnimationStateU) <= sizeof(((EyeSnapshot *)0)->animationState), "animation state doesn't fit snapshot");
+static_assert(sizeof(StateSnapshot) <= 255, "snapshot offsets must fit in a byte");
+
+static void snapshotColor (CRGB color, uint8_t *out) {
+  out[0] = color.r;
+  out[1] = color.g;
+  out[2] = color.b;
+}
+
+void snapshotEye (Eye *eye, EyeSnapshot *snapshot) {
+  AnimationState animationState = eye->getAnimationState();
+  snapshotColor(eye->currentColor, snapshot->currentColor);
+  snapshotColor(eye->defaultColor, snapshot->defaultColor);
+  snapshot->pupilSize = eye->pupilSize;
+  snapshot->pupilInfill = eye->pupilInfill;
+  snapshot->animationType = animationState.type;
+  memset(snapshot->animationState, 0, sizeof(snapshot->animationState));
+  if (animationState.type != ANIMATION_NONE) {
+    memcpy(snapshot->animationState, &animationState.u, sizeof(animationState.u));
+  }
+  snapshot->frameDelayMillis = animationState.frameDelayMillis;
+}
+
+void snapshotJaw (Jaw *jaw, JawSnapshot *snapshot) {
+  snapshotColor(jaw->currentColor, snapshot->currentColor);
+  snapshotColor(jaw->defaultColor, snapshot->defaultColor);
+}
+
+void snapshotServo (Servo *servo, ServoSnapshot *snapshot) {
+  snapshot->pos = servo->getPos();
+  snapshot->target = servo->getTarget();
+  snapshot->estimatedPos = servo->getEstimatedPos();
+  snapshot->pulseWidth = servo->getPulseWidth();
+  snapshot->speed = servo->getSpeed();
+  snapshot->flags = (servo->isMoving() ? SNAPSHOT_SERVO_MOVING : 0)
+    | (servo->isReleased() ? SNAPSHOT_SERVO_RELEASED : 0);
+}
+
+uint16_t snapshotDelta (const StateSnapshot *previous, const StateSnapshot *current, uint8_t *delta) {
+  const uint8_t *before = (const uint8_t *)previous;
+  const uint8_t *after = (const uint8_t *)current;
+  uint16_t size = 0;
+  uint16_t i = 0;
+  while (i < sizeof(StateSnapshot)) {
+    if (before[i] == after[i]) {
+      i++;
+      continue;
+    }
+    // Extend the run until a gap too long to be worth bridging
+    uint16_t start = i;
+    uint16_t end = i + 1;
+    for (uint16_t j = end; j < sizeof(StateSnapshot) && j - end <= SNAPSHOT_DELTA_MAX_GAP; j++) {
+      if (before[j] != after[j]) {
+        end = j + 1;
+      }
+    }
+    delta[size++] = start;
+    delta[size++] = end - start;
+    memcpy(delta + size, after + start, end - start);
+    size += end - start;
+    i = end;
+  }
+  return size;
+}
@@ -0,0 +1,73 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include "Eye.h"
+#include "Jaw.h"
+#include "Servo.h"
+
+// Bumped whenever a field moves or changes meaning. Fields are only ever
+// appended within a version, so hosts can skip past any they don't know
+#define SNAPSHOT_VERSION 1
+
+// Servo flags
+#define SNAPSHOT_SERVO_MOVING 0x01
+#define SNAPSHOT_SERVO_RELEASED 0x02
+
+// All fields below are packed and little-endian, so the layout is the same
+// on the device and the host
+
+typedef struct __attribute__((packed)) {
+  uint8_t currentColor[3];
+  uint8_t defaultColor[3];
+  uint8_t pupilSize;
+  uint8_t pupilInfill;
+  uint8_t animationType;
+  // Raw `AnimationStateU` bytes, zero past the active member
+  uint8_t animationState[4];
+  uint16_t frameDelayMillis;
+} EyeSnapshot;
+
+typedef struct __attribute__((packed)) {
+  uint8_t currentColor[3];
+  uint8_t defaultColor[3];
+} JawSnapshot;
+
+typedef struct __attribute__((packed)) {
+  // Positions on range [0, 1000]
+  uint16_t pos;
+  uint16_t target;
+  uint16_t estimatedPos;
+  uint16_t pulseWidth;
+  uint8_t speed;
+  uint8_t flags;
+} ServoSnapshot;
+
+typedef struct __attribute__((packed)) {
+  uint8_t version;
+  // Size of the whole snapshot in bytes
+  uint8_t size;
+  // Left then right
+  EyeSnapshot eyes[2];
+  JawSnapshot jaw;
+  // Left arm, right arm, then jaw
+  ServoSnapshot servos[3];
+  uint8_t waypointCount;
+  uint8_t buttonState;
+  uint8_t buttonEnabled;
+} StateSnapshot;
+
+// Longest delta `snapshotDelta` can produce
+#define SNAPSHOT_DELTA_MAX_SIZE (sizeof(StateSnapshot) + 2)
+
+// Fill in the snapshot of an eye
+void snapshotEye (Eye *eye, EyeSnapshot *snapshot);
+// Fill in the snapshot of the jaw LEDs
+void snapshotJaw (Jaw *jaw, JawSnapshot *snapshot);
+// Fill in the snapshot of a servo
+void snapshotServo (Servo *servo, ServoSnapshot *snapshot);
+// Encode the bytes of `current` differing from `previous` as runs of
+// [offset][length][bytes...]. Returns the encoded size, 0 if nothing changed
+uint16_t snapshotDelta (const StateSnapshot *previous, const StateSnapshot *current, uint8_t *delta);
+
+#endif
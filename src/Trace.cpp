@@ -0,0 +1,73 @@
+#include "Trace.h"
+
+Trace::Trace () {
+  this->enabled = 1;
+  clear();
+}
+
+void Trace::record (uint32_t timeMicros, const char *command) {
+  size_t length = strlen(command);
+  if (length > 255) {
+    length = 255;
+  }
+  uint16_t entrySize = TRACE_ENTRY_HEADER_SIZE + length;
+  while ((used + entrySize) > TRACE_BUFFER_SIZE) {
+    dropOldest();
+  }
+  push(timeMicros & 0xff);
+  push((timeMicros >> 8) & 0xff);
+  push((timeMicros >> 16) & 0xff);
+  push((timeMicros >> 24) & 0xff);
+  push((uint8_t)length);
+  for (size_t i = 0; i < length; i++) {
+    push(command[i]);
+  }
+  used += entrySize;
+  entryCount++;
+}
+
+void Trace::clear () {
+  head = 0;
+  tail = 0;
+  used = 0;
+  entryCount = 0;
+}
+
+uint16_t Trace::count () {
+  return entryCount;
+}
+
+uint16_t Trace::first () {
+  return tail;
+}
+
+uint16_t Trace::read (uint16_t cursor, uint32_t *timeMicros, char *command, uint8_t commandSize) {
+  *timeMicros = (uint32_t)peek(cursor, 0)
+    | ((uint32_t)peek(cursor, 1) << 8)
+    | ((uint32_t)peek(cursor, 2) << 16)
+    | ((uint32_t)peek(cursor, 3) << 24);
+  uint8_t length = peek(cursor, 4);
+  uint8_t i;
+  // Truncate to fit the output buffer, leaving room for terminator
+  for (i = 0; i < length && i < (commandSize - 1); i++) {
+    command[i] = peek(cursor, TRACE_ENTRY_HEADER_SIZE + i);
+  }
+  command[i] = '\0';
+  return (cursor + TRACE_ENTRY_HEADER_SIZE + length) % TRACE_BUFFER_SIZE;
+}
+
+void Trace::push (uint8_t value) {
+  data[head] = value;
+  head = (head + 1) % TRACE_BUFFER_SIZE;
+}
+
+uint8_t Trace::peek (uint16_t cursor, uint16_t offset) {
+  return data[(cursor + offset) % TRACE_BUFFER_SIZE];
+}
+
+void Trace::dropOldest () {
+  uint16_t entrySize = TRACE_ENTRY_HEADER_SIZE + peek(tail, 4);
+  tail = (tail + entrySize) % TRACE_BUFFER_SIZE;
+  used -= entrySize;
+  entryCount--;
+}
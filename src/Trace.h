@@ -0,0 +1,49 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "Arduino.h"
+
+// Size in bytes of the trace ring buffer. Each entry takes 5 bytes plus
+// the command length, so a typical session holds a few hundred commands
+#define TRACE_BUFFER_SIZE 4096
+// Bytes of header stored before each command: 4 timestamp, 1 length
+#define TRACE_ENTRY_HEADER_SIZE 5
+
+// Records incoming commands with device timestamps into a ring buffer.
+// When full, the oldest entries are dropped to make room for new ones
+class Trace {
+  public:
+    // Set while incoming commands should be recorded
+    uint8_t enabled;
+
+    Trace ();
+    // Append a command with the time it was received
+    void record (uint32_t timeMicros, const char *command);
+    // Drop all entries
+    void clear ();
+    // Number of entries stored
+    uint16_t count ();
+    // Cursor of the oldest entry
+    uint16_t first ();
+    // Read entry at cursor, returning the cursor of the following entry
+    uint16_t read (uint16_t cursor, uint32_t *timeMicros, char *command, uint8_t commandSize);
+  protected:
+    uint8_t data[TRACE_BUFFER_SIZE];
+    // Write position of next entry
+    uint16_t head;
+    // Position of oldest entry
+    uint16_t tail;
+    // Bytes currently in use
+    uint16_t used;
+    uint16_t entryCount;
+
+    // Write a byte at head and advance
+    void push (uint8_t value);
+    // Read a byte at an offset from the cursor, wrapping around
+    uint8_t peek (uint16_t cursor, uint16_t offset);
+    // Drop the oldest entry
+    void dropOldest ();
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "Transport.h"
+
+Transport::Transport () {
+  this->txHead = 0;
+  this->txTail = 0;
+  this->lineQueued = 0;
+  this->droppingLine = 0;
+  this->lineCut = 0;
+  this->linkMidLine = 0;
+  this->dropped = 0;
+  this->linesDropped = 0;
+}
+
+size_t Transport::write (uint8_t value) {
+  return write(&value, 1);
+}
+
+size_t Transport::write (const uint8_t *buffer, size_t size) {
+  size_t accepted = 0;
+  for (size_t i = 0; i < size; i++) {
+    if (!droppingLine && !makeRoom()) {
+      // Take back whatever of the line the link hasn't seen, and drop the
+      // rest of it as it comes
+      lineCut = lineStarted();
+      uint16_t keep = lineCut ? txTail : (txHead - lineQueued + TRANSPORT_TX_BUFFER_SIZE) % TRANSPORT_TX_BUFFER_SIZE;
+      dropped += (txHead - keep + TRANSPORT_TX_BUFFER_SIZE) % TRANSPORT_TX_BUFFER_SIZE;
+      txHead = keep;
+      droppingLine = 1;
+      linesDropped++;
+    }
+    if (droppingLine && !(lineCut && buffer[i] == '\n')) {
+      dropped++;
+    } else {
+      txBuffer[txHead] = buffer[i];
+      txHead = (txHead + 1) % TRANSPORT_TX_BUFFER_SIZE;
+      lineQueued++;
+      accepted++;
+    }
+    if (buffer[i] == '\n') {
+      droppingLine = 0;
+      lineCut = 0;
+      lineQueued = 0;
+    }
+  }
+  poll();
+  return accepted;
+}
+
+void Transport::poll () {
+  while (txHead != txTail) {
+    int room = linkAvailableForWrite();
+    if (room <= 0) {
+      return;
+    }
+    // Send the contiguous run up to the end of the buffer, then wrap
+    size_t run = ((txHead > txTail) ? txHead : TRANSPORT_TX_BUFFER_SIZE) - txTail;
+    size_t sent = linkWrite(txBuffer + txTail, min(run, (size_t)room));
+    if (sent == 0) {
+      return;
+    }
+    linkMidLine = (txBuffer[txTail + sent - 1] != '\n');
+    txTail = (txTail + sent) % TRANSPORT_TX_BUFFER_SIZE;
+  }
+}
+
+void Transport::flush () {
+  unsigned long start = millis();
+  while (txHead != txTail) {
+    uint16_t before = txTail;
+    poll();
+    if (txTail != before) {
+      start = millis();
+    } else if ((millis() - start) >= TRANSPORT_LINE_WAIT_MS) {
+      discardQueued();
+      return;
+    }
+  }
+}
+
+void Transport::discardQueued () {
+  if (lineQueued > 0) {
+    droppingLine = 1;
+    linesDropped++;
+  }
+  while (txHead != txTail) {
+    linesDropped += (txBuffer[txTail] == '\n');
+    dropped++;
+    txTail = (txTail + 1) % TRANSPORT_TX_BUFFER_SIZE;
+  }
+  lineQueued = 0;
+  // A line the link has started on still gets a newline, from the line being
+  // written if that is dropped as it comes, so the next line stands apart
+  if (linkMidLine) {
+    if (droppingLine) {
+      lineCut = 1;
+    } else {
+      txBuffer[txHead] = '\n';
+      txHead = (txHead + 1) % TRANSPORT_TX_BUFFER_SIZE;
+    }
+  }
+}
+
+uint32_t Transport::droppedBytes () {
+  return dropped;
+}
+
+uint32_t Transport::droppedLines () {
+  return linesDropped;
+}
+
+uint8_t Transport::lineStarted () {
+  uint16_t unsent = (txHead - txTail + TRANSPORT_TX_BUFFER_SIZE) % TRANSPORT_TX_BUFFER_SIZE;
+  return unsent < lineQueued;
+}
+
+uint8_t Transport::makeRoom () {
+  if ((txHead + 1) % TRANSPORT_TX_BUFFER_SIZE != txTail) {
+    return 1;
+  }
+  poll();
+  if (!lineStarted()) {
+    return (txHead + 1) % TRANSPORT_TX_BUFFER_SIZE != txTail;
+  }
+  // Dropping the rest now would leave the link half a line, which the next
+  // line would be read as part of
+  unsigned long start = millis();
+  while ((txHead + 1) % TRANSPORT_TX_BUFFER_SIZE == txTail) {
+    if ((millis() - start) >= TRANSPORT_LINE_WAIT_MS) {
+      return 0;
+    }
+    poll();
+  }
+  return 1;
+}
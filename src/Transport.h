@@ -0,0 +1,123 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdint.h>
+#include "Arduino.h"
+
+// Outgoing bytes held while the link has no room for them
+#define TRANSPORT_TX_BUFFER_SIZE 1024
+// Longest wait for the link to take the rest of a line it has started on,
+// or to take anything at all during a flush
+#define TRANSPORT_LINE_WAIT_MS 100
+
+// Carries commands in and responses out. `read` returns -1 when nothing is
+// waiting, and writes are buffered and sent from `poll` as the link has room.
+// Output only ever goes out as whole lines: a line that doesn't fit in the
+// buffer is dropped and counted, all of it, unless the link has already
+// started on it. Then the write waits up to `TRANSPORT_LINE_WAIT_MS` for the
+// link to make room, and past that the link is taken to be gone: the rest of
+// the line is dropped, but not its newline, so the next line still starts on
+// a line of its own. Responses are written with the usual `Print` calls
+class Transport: public Print {
+  public:
+    Transport ();
+    // Number of bytes waiting to be read
+    virtual int available () = 0;
+    // Next byte received, or -1 if none are waiting
+    virtual int read () = 0;
+    // Queue bytes to send, returning the number accepted
+    using Print::write;
+    size_t write (uint8_t value);
+    size_t write (const uint8_t *buffer, size_t size);
+    // Send queued bytes, as many as the link has room for
+    void poll ();
+    // Send all queued bytes, blocking until the link has taken them. If the
+    // link takes nothing for `TRANSPORT_LINE_WAIT_MS`, it is taken to be gone
+    // and what's left is dropped and counted
+    void flush ();
+    // Bytes dropped for lack of buffer space
+    uint32_t droppedBytes ();
+    // Lines dropped, in whole or in part, for lack of buffer space
+    uint32_t droppedLines ();
+  protected:
+    // Room the link has for outgoing bytes right now
+    virtual int linkAvailableForWrite () = 0;
+    // Hand bytes to the link, returning the number taken
+    virtual size_t linkWrite (const uint8_t *buffer, size_t size) = 0;
+
+    uint8_t txBuffer[TRANSPORT_TX_BUFFER_SIZE];
+    uint16_t txHead;
+    uint16_t txTail;
+    // Bytes of the line being written that have been queued
+    uint32_t lineQueued;
+    // Set while dropping the rest of a line
+    uint8_t droppingLine;
+    // Set if the line being dropped was cut short on the link, so its end
+    // still goes out to keep the next line apart from it
+    uint8_t lineCut;
+    // Set if the last byte the link took wasn't a newline
+    uint8_t linkMidLine;
+    uint32_t dropped;
+    uint32_t linesDropped;
+
+    // Indicates the link has taken some of the line being written
+    uint8_t lineStarted ();
+    // Drop everything queued, and the rest of the line being written
+    void discardQueued ();
+    // Make room for one more byte of the current line, waiting for the link
+    // if it has started on the line. Returns 0 if the line must be dropped
+    uint8_t makeRoom ();
+};
+
+// Transport over a serial port. Templated since the port's type depends on
+// the board's USB setup, and the common base class lacks `availableForWrite`
+template<class SerialType>
+class SerialTransport: public Transport {
+  public:
+    SerialTransport (SerialType *serial) {
+      this->serial = serial;
+    }
+    int available () {
+      return serial->available();
+    }
+    int read () {
+      return serial->read();
+    }
+  protected:
+    SerialType *serial;
+
+    int linkAvailableForWrite () {
+      return serial->availableForWrite();
+    }
+    size_t linkWrite (const uint8_t *buffer, size_t size) {
+      return serial->write(buffer, size);
+    }
+};
+
+// Transport with nothing on the other end, which takes all output and
+// discards it. Used to run commands without their responses reaching the host
+class NullTransport: public Transport {
+  public:
+    // Bytes written and discarded
+    uint32_t discarded;
+
+    NullTransport () {
+      this->discarded = 0;
+    }
+    int available () {
+      return 0;
+    }
+    int read () {
+      return -1;
+    }
+  protected:
+    int linkAvailableForWrite () {
+      return TRANSPORT_TX_BUFFER_SIZE;
+    }
+    size_t linkWrite (const uint8_t *buffer, size_t size) {
+      discarded += size;
+      return size;
+    }
+};
+
+#endif
@@ -0,0 +1,15 @@
+#include "WireBus.h"
+
+WireBus::WireBus (TwoWire *wire) {
+  this->wire = wire;
+}
+
+uint8_t WireBus::writeRegisters (uint8_t address, uint8_t reg, const uint8_t *data, uint8_t length) {
+  if (length + 1 > WIRE_BUS_MAX_WRITE) {
+    return 0;
+  }
+  wire->beginTransmission(address);
+  wire->write(reg);
+  wire->write(data, length);
+  return wire->endTransmission() == 0;
+}
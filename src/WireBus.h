@@ -0,0 +1,20 @@
+#ifndef WIRE_BUS_H
+#define WIRE_BUS_H
+
+#include <stdint.h>
+#include <Wire.h>
+#include "I2cBus.h"
+
+// Most bytes `Wire` buffers for one transaction
+#define WIRE_BUS_MAX_WRITE 128
+
+// I2C over the Arduino `Wire` library. Start the bus with `begin` first
+class WireBus: public I2cBus {
+  public:
+    WireBus (TwoWire *wire);
+    uint8_t writeRegisters (uint8_t address, uint8_t reg, const uint8_t *data, uint8_t length);
+  protected:
+    TwoWire *wire;
+};
+
+#endif